@@ -16,6 +16,28 @@
 //NOTE: The printPacket function still calls Serial directly. TODO: Adjust that.
 #endif
 
+#if defined(ANTPLUS_PAIRING)
+#include "ANTPlus_Pairing.h"
+#endif /*defined(ANTPLUS_PAIRING)*/
+
+#if defined(ANTPLUS_CAPTURE)
+#include "ANTPlus_Capture.h"
+#define ANTPLUS_CAPTURE_RECORD(x)               do { if (capture != NULL) { capture->x; } } while (0)
+#else
+#define ANTPLUS_CAPTURE_RECORD(x)
+#endif
+
+#if defined(ANTPLUS_STATISTICS)
+#define ANTPLUS_STATISTICS_COUNT(x)             do { stats.x; } while (0)
+#else
+#define ANTPLUS_STATISTICS_COUNT(x)
+#endif
+
+//! A read outcome (other than MESSAGE_READ_NONE) being returned to the application
+#define ANTPLUS_READ_OUTCOME(outcome)           do { ANTPLUS_CAPTURE_RECORD( readOutcome(outcome) ); ANTPLUS_STATISTICS_COUNT( countOutcome(outcome) ); } while (0)
+
+ANTPlus * ANTPlus::rtsInstance = NULL;
+
 ANTPlus::ANTPlus(
         byte RTS_PIN,
         byte SUSPEND_PIN,
@@ -28,13 +50,53 @@ ANTPlus::ANTPlus(
     this->SLEEP_PIN = SLEEP_PIN;
     this->RESET_PIN = RESET_PIN;
     
-    hw_reset_count = 0;
+    rx_sync_discard_count = 0;
+    commandSequence = 0;
+    msgResponseExpected = MESG_INVALID_ID;
+    sent.state = ANT_COMMAND_FREE;
+    recoveryLevel = ANT_RECOVERY_NONE;
+    resetGeneration = 0;
+    networkKeys = 0;
+    clear_to_send = false;
+    rtsWaitMs = 0;
+    rtsFell = false;
+    rtsRose = false;
+#if defined(ANTPLUS_CAPTURE)
+    capture = NULL;
+#endif /*defined(ANTPLUS_CAPTURE)*/
+#if defined(ANTPLUS_PAIRING)
+    pairingCache = NULL;
+#endif /*defined(ANTPLUS_PAIRING)*/
+    for(int i = 0; i < ANT_COMMAND_QUEUE_LEN; i++)
+    {
+        commands[i].state = ANT_COMMAND_FREE;
+    }
+    for(int i = 0; i < ANT_DEVICE_NUMBER_CHANNELS; i++)
+    {
+        channels[i] = NULL;
+        channelProfiles[i] = ANT_PROFILE_NONE;
+    }
+    profileCount = 0;
+}
+
+
+ANTPlus::~ANTPlus()
+{
+#if defined(digitalPinToInterrupt)
+  if (rtsInstance == this)
+  {
+    detachInterrupt(digitalPinToInterrupt(RTS_PIN));
+    rtsInstance = NULL;
+  }
+#endif
 }
 
 
-void ANTPlus::begin(Stream &serial)
+//pump_serial_on_read -- false if the application feeds the receive ring itself (receiveByte() from an ISR or pumpSerial())
+void ANTPlus::begin(Stream &serial, boolean pump_serial_on_read)
 {
   mySerial = &serial;
+  pumpOnRead = pump_serial_on_read;
 
   pinMode(SUSPEND_PIN, OUTPUT);
   pinMode(SLEEP_PIN,   OUTPUT);
@@ -46,10 +108,16 @@ void ANTPlus::begin(Stream &serial)
   digitalWrite(SUSPEND_PIN, HIGH);
   digitalWrite(SLEEP_PIN,   LOW);
   
-  //Interrupts are set in the main program currently
-  //TODO: Look to see if they should be brought 'in lib'
-  
-  
+  //RTS high -> low is the module ready for the next message (see pollRts())
+  //Without an interrupt on RTS_PIN the sketch must call rTSHighAssertion()
+#if defined(digitalPinToInterrupt)
+  if (digitalPinToInterrupt(RTS_PIN) >= 0)
+  {
+    rtsInstance = this;
+    attachInterrupt(digitalPinToInterrupt(RTS_PIN), rtsFallingIsr, FALLING);
+  }
+#endif
+
   //This should not be strictly necessary - the device should always come up by itself....
   //But let's make sure we didn't miss the first RTS in a power-up race
   hardwareReset();
@@ -60,18 +128,91 @@ void ANTPlus::hardwareReset()
 {
   ANTPLUS_DEBUG_PRINTLN("H/w Reset");
   
+  trace.record<ANT_TRACE_HW_RESET>(0);
   sleep(false);
   digitalWrite(RESET_PIN,   LOW);
   delay(5);
   //Reset all variables before we release the ANT
-  clear_to_send = false;
-  msgResponseExpected = MESG_START_UP;
+  module_state_lost();
+  recoveryLevel = ANT_RECOVERY_HARDWARE_RESET;
+  rxState = ANT_FRAMER_SYNC;
   rxBufCnt = 0;
-  rx_packet_count = 0;
-  tx_packet_count = 0;
-  hw_reset_count++;
+  rxReplayPos = 0;
+  rxReplayEnd = 0;
+  rxRing.clear();
+  ANTPLUS_STATISTICS_COUNT( hw_resets++ );
   delay(5);
   digitalWrite(RESET_PIN,   HIGH);
+  //The wait for START_UP (see check_deadlines()) is from the release
+  sent.sent_ms = millis();
+  rtsWaitMs = sent.sent_ms;
+}
+
+//! Reset the module over the UART. No delays and nothing received is thrown away -- the first step up from resending (see recover()).
+//If the module is not clear to send (e.g. a frame has just gone) the reset goes as soon as it is. If RTS never comes the
+//wait for MESG_START_UP runs out and the reset line is used (see check_deadlines()).
+void ANTPlus::softReset()
+{
+  ANTPLUS_DEBUG_PRINTLN("Soft Reset");
+
+  pollRts();
+  boolean ready = clear_to_send;
+  trace.record<ANT_TRACE_SOFT_RESET>(0);
+  ANTPLUS_STATISTICS_COUNT( soft_resets++ );
+  module_state_lost();
+  recoveryLevel = ANT_RECOVERY_SOFT_RESET;
+  ANT_SystemReset reset;
+  if( ready )
+  {
+    transmitFrame( reset.frame );
+    return;
+  }
+  memcpy( sent.frame, reset.frame, reset.frame[1] + MESG_FRAME_SIZE );
+  sent.response_msg_id = MESG_START_UP;
+  sent.retries = 0;
+  sent.state = ANT_COMMAND_QUEUED;
+}
+
+//! The module has been reset (or reset itself) and is starting up. Everything queued or in flight is lost (callbacks get
+//ANT_COMMAND_LOST) and every added channel is set up again. Counters (statistics, per channel counts) are kept.
+void ANTPlus::module_state_lost()
+{
+  clear_to_send = false;
+  rtsFell = false;
+  rtsRose = false;
+  msgResponseExpected = MESG_START_UP;
+  sent.state = ANT_COMMAND_FREE;
+  sent.sent_ms = millis();
+  rtsWaitMs = sent.sent_ms;
+  resetGeneration++;
+  networkKeys = 0;
+
+  //Commands queued from a callback are for after the reset -- leave those
+  unsigned int lostBefore = commandSequence;
+  for(byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++)
+  {
+    ANT_Command * command = &commands[i];
+    if( (command->state != ANT_COMMAND_FREE) && ((int)(command->sequence - lostBefore) < 0) )
+    {
+      command->state = ANT_COMMAND_FREE;
+      if( command->callback != NULL )
+      {
+        command->callback( command, ANT_COMMAND_LOST, NULL, command->context );
+      }
+    }
+  }
+  //All channels on the module are gone -- set them all up again
+  for(int i = 0; i < ANT_DEVICE_NUMBER_CHANNELS; i++)
+  {
+    if(channels[i] != NULL)
+    {
+      channels[i]->state_counter = 0;
+      channels[i]->commands_pending = 0;
+      channels[i]->setup_start_ms = 0;
+      channels[i]->channel_establish = ANT_CHANNEL_ESTABLISH_PROGRESSING;
+      set_channel_state( channels[i], ANT_CHANNEL_STATE_CLOSED );
+    }
+  }
 }
 
 // Data <sync> <len> <msg id> <channel> <msg id being responded to> <msg code> <chksum>
@@ -79,188 +220,765 @@ void ANTPlus::hardwareReset()
 // <msg id> 0x40==MESG_RESPONSE_EVENT_ID denoting a channel response / event
 // <msg id> 0x4E==MESG_BROADCAST_DATA_ID denoting a broadcast (e.g. HRM or SDM)
 // <msg code> success is 0.  See page 84 of ANT MPaU for other codes
-//readTimeoutMs -- is amount of time to wait for first byte to appeaer (can be 0)
-MESSAGE_READ ANTPlus::readPacketInternal( ANT_Packet * packet, int packetSize, unsigned int readTimeoutMs)
+//readTimeoutMs -- is amount of time to keep polling for bytes (can be 0 -- only consume what is already available)
+//This never waits for the remainder of a frame. A partial frame is kept (see frameByte()) and completed on a later call.
+//Out of sync bytes are skipped in bulk. MESSAGE_READ_ERROR_MISSING_SYNC is returned (once) only if bytes were skipped and no frame was found.
+//On MESSAGE_READ_INTERNAL the frame is in rxBuf (rxBufCnt bytes)
+MESSAGE_READ ANTPlus::readPacketInternal( unsigned int readTimeoutMs )
 {
-  unsigned char byteIn;
-  unsigned char chksum = 0;
-  unsigned long timeoutExit = millis() + readTimeoutMs;
-  
-  while (timeoutExit >= millis()) //First loop will go through always
+  MESSAGE_READ ret_val;
+  unsigned long startMs = millis();
+  unsigned long discardCount = rx_sync_discard_count;
+
+  do //First loop will go through always
   {
-    //This is a busy read
-    if (mySerial->available() > 0)
+    if (pumpOnRead)
     {
-      byteIn = mySerial->read();
-      //We have a byte -- so we want to finish off this message (increase timeout)
-      timeoutExit += ANT_PACKET_READ_NEXT_BYTE_TIMEOUT_MS;
-      if ((byteIn == MESG_TX_SYNC) && (rxBufCnt == 0))
+      pumpSerial();
+    }
+    if (rxBytesPending())
+    {
+      rxLastByteMs = millis();
+      do
       {
-        rxBuf[rxBufCnt++] = byteIn;
-        chksum = byteIn;
+        ret_val = frameByte( nextRxByte() );
+        if (ret_val != MESSAGE_READ_NONE)
+        {
+          return ret_val;
+        }
       }
-      else if ((rxBufCnt == 0) && (byteIn != MESG_TX_SYNC))
+      while (rxBytesPending());
+    }
+
+    if ((rxState != ANT_FRAMER_SYNC) && ((millis() - rxLastByteMs) > ANT_PACKET_READ_NEXT_BYTE_TIMEOUT_MS))
+    {
+      //The next frame might have started inside the bytes we have
+      trace.record<ANT_TRACE_TIMEOUT_MIDMESSAGE>(rxBufCnt);
+      framerResync();
+      return MESSAGE_READ_INFO_TIMEOUT_MIDMESSAGE;
+    }
+  }
+  while ((millis() - startMs) < readTimeoutMs);
+
+  if (rx_sync_discard_count != discardCount)
+  {
+    return MESSAGE_READ_ERROR_MISSING_SYNC;
+  }
+  return MESSAGE_READ_NONE;
+}
+
+//! Next byte for the framer. Bytes left over from a failed candidate frame go first. Check rxBytesPending() first.
+unsigned char ANTPlus::nextRxByte()
+{
+  if (rxReplayPos < rxReplayEnd)
+  {
+    return rxBuf[rxReplayPos++];
+  }
+  unsigned char value = rxRing.get();
+  ANTPLUS_CAPTURE_RECORD( rxByte(value) );
+  trace.record<ANT_TRACE_RX_BYTE>(value);
+  return value;
+}
+
+//! Progress the frame parser by a single byte (sync -> length -> id -> payload -> checksum)
+//Returns MESSAGE_READ_NONE while a frame is still being assembled (or while skipping out of sync bytes)
+//Returns MESSAGE_READ_INTERNAL when rxBuf holds a complete frame with a good checksum
+MESSAGE_READ ANTPlus::frameByte( unsigned char byteIn )
+{
+  switch (rxState)
+  {
+    case ANT_FRAMER_SYNC:
+      if (byteIn != MESG_TX_SYNC)
       {
-        return MESSAGE_READ_ERROR_MISSING_SYNC;
+        rx_sync_discard_count++;
+        return MESSAGE_READ_NONE;
       }
-      else if (rxBufCnt == 1)
+      rxFrameStartUs = micros();
+      rxBufCnt = 0;
+      rxBuf[rxBufCnt++] = byteIn;
+      rxChksum = byteIn;
+      rxState = ANT_FRAMER_LENGTH;
+      break;
+
+    case ANT_FRAMER_LENGTH:
+      rxBuf[rxBufCnt++] = byteIn;
+      // sync, size, id and checksum are each 1 byte
+      if ((byteIn + MESG_FRAME_SIZE) > ANT_MAX_PACKET_LEN)
       {
-        rxBuf[rxBufCnt++] = byteIn;       // second byte will be size
-        chksum ^= byteIn;
+        //Either a frame we can't hold or the 'sync' was really data
+        trace.record<ANT_TRACE_SIZE_EXCEEDED>(byteIn);
+        framerResync();
+        return MESSAGE_READ_ERROR_PACKET_SIZE_EXCEEDED;
       }
-      else if (rxBufCnt < rxBuf[1]+3)
-      { // read rest of data taking into account sync, size, and checksum that are each 1 byte
-        rxBuf[rxBufCnt++] = byteIn;
-        chksum ^= byteIn;
+      rxChksum ^= byteIn;
+      rxState = ANT_FRAMER_ID;
+      break;
+
+    case ANT_FRAMER_ID:
+      rxBuf[rxBufCnt++] = byteIn;
+      rxChksum ^= byteIn;
+      rxState = (rxBuf[1] == 0) ? ANT_FRAMER_CHECKSUM : ANT_FRAMER_PAYLOAD;
+      break;
+
+    case ANT_FRAMER_PAYLOAD:
+      rxBuf[rxBufCnt++] = byteIn;
+      rxChksum ^= byteIn;
+      if (rxBufCnt == (rxBuf[1] + MESG_HEADER_SIZE))
+      {
+        rxState = ANT_FRAMER_CHECKSUM;
       }
-      else
+      break;
+
+    case ANT_FRAMER_CHECKSUM:
+      rxBuf[rxBufCnt++] = byteIn;
+      rxState = ANT_FRAMER_SYNC;
+      rxFrameAssemblyUs = micros() - rxFrameStartUs;
+      ANTPLUS_STATISTICS_COUNT( rx_frames++ );
+      if (byteIn != rxChksum)
       {
-        rxBuf[rxBufCnt++] = byteIn;
-        if (rxBufCnt > packetSize)
-        {
-          //Likely we are missing something....
-          //we reset our buffer count
-          rxBufCnt = 0;
-          return MESSAGE_READ_ERROR_PACKET_SIZE_EXCEEDED;
-        }
-        else
-        {
-          memcpy(packet, &rxBuf, rxBufCnt); // Should be a complete packet. copy data to packet variable, check checksum and return
-          rx_packet_count++;
-          if (chksum != ANT_PACKET_CHECKSUM(packet))
-          {
-            rxBufCnt = 0;
-            return MESSAGE_READ_ERROR_BAD_CHECKSUM;
-          }
-          else
-          {
-            //Good packet
-            rxBufCnt = 0;
-            return MESSAGE_READ_INTERNAL;
-          }
-        }
+        //The 'sync' may have been data and a real frame starts inside this one
+        trace.record<ANT_TRACE_CHECKSUM_FAIL>(rxBuf[2]);
+        framerResync();
+        return MESSAGE_READ_ERROR_BAD_CHECKSUM;
       }
-    }
+      //Good packet
+      trace.record<ANT_TRACE_FRAME_COMPLETE>(rxBuf[2]);
+      return MESSAGE_READ_INTERNAL;
   }
-  
-  if(rxBufCnt != 0)
+  return MESSAGE_READ_NONE;
+}
+
+//! Drop the current candidate frame and backtrack to the next sync byte already buffered.
+//The candidate (after its sync byte) and any bytes still waiting to be re-scanned are kept in rxBuf
+//and fed back through frameByte() ahead of new bytes from the ring. Skipped bytes are counted as discarded.
+//NOTE: rxBufCnt <= rxReplayPos always (frameByte() stores at most one byte per byte read) so this is in place.
+void ANTPlus::framerResync()
+{
+  int pending = rxBufCnt;
+  if (rxReplayPos < rxReplayEnd)
   {
-    //This may be recoverable but it is likely not worth the effort
-    //we reset our buffer count
-    rxBufCnt = 0;
-  
-    return MESSAGE_READ_INFO_TIMEOUT_MIDMESSAGE;
+    memmove(&rxBuf[pending], &rxBuf[rxReplayPos], rxReplayEnd - rxReplayPos);
+    pending += rxReplayEnd - rxReplayPos;
   }
-  return MESSAGE_READ_NONE;
+
+  int next_sync = 1;
+  while ((next_sync < pending) && (rxBuf[next_sync] != MESG_TX_SYNC))
+  {
+    next_sync++;
+  }
+  rx_sync_discard_count += next_sync;
+  trace.record<ANT_TRACE_RESYNC>((next_sync > 0xFF) ? 0xFF : next_sync);
+
+  rxReplayPos = next_sync;
+  rxReplayEnd = pending;
+  rxState = ANT_FRAMER_SYNC;
+  rxBufCnt = 0;
+}
+
+//! Move bytes from the Stream to the receive ring.
+//Stops when the ring is full -- anything else stays in the Stream's own buffer.
+void ANTPlus::pumpSerial()
+{
+  while ((rxRing.space() > 0) && (mySerial->available() > 0))
+  {
+    rxRing.put( mySerial->read() );
+  }
+}
+
+//! Fill in sync, length, id and checksum around args (argCnt bytes) in frame (at least argCnt + MESG_FRAME_SIZE bytes)
+void ANTPlus::buildFrame( byte * frame, byte msgId, byte argCnt, const byte * args )
+{
+  unsigned char chksum = MESG_TX_SYNC ^ argCnt ^ msgId;
+  frame[0] = MESG_TX_SYNC;
+  frame[1] = argCnt;
+  frame[2] = msgId;
+  for (byte cnt = 0; cnt < argCnt; cnt++)
+  {
+    frame[MESG_HEADER_SIZE + cnt] = args[cnt];
+    chksum ^= args[cnt];
+  }
+  frame[MESG_HEADER_SIZE + argCnt] = chksum;
 }
 
-//! Write out a single byte and return the updated checksum
-unsigned char ANTPlus::writeByte(unsigned char out, unsigned char chksum)
+//! Write out a complete frame (built by buildFrame()) in a single write. Caller checks clear_to_send.
+//TODO: An interrupt driven TX ring so we are not stalled for the ~1 ms/byte at 9600 baud with SoftwareSerial
+void ANTPlus::transmitFrame( const byte * frame )
 {
+  const ANT_Packet * packet = (const ANT_Packet *) frame;
+  //Before the write -- the module can take the frame and pulse RTS before the write returns
+  clear_to_send = false;
+  rtsFell = false;
+  rtsRose = false;
+  rtsWaitMs = millis();
+  if( packet->msg_id == MESG_CLOSE_CHANNEL_ID )
+  {
+    //Closed by the host -- not reopened when EVENT_CHANNEL_CLOSED comes back
+    ANT_Channel * channel = get_channel( packet->data[0] );
+    if( channel != NULL )
+    {
+      set_channel_state( channel, ANT_CHANNEL_STATE_CLOSED );
+    }
+  }
+  trace.record<ANT_TRACE_SEND_START>(packet->msg_id);
+  mySerial->write( frame, packet->length + MESG_FRAME_SIZE );
+  trace.record<ANT_TRACE_SEND_END>(packet->msg_id);
+  ANTPLUS_CAPTURE_RECORD( txFrame(frame) );
+
 #ifdef ANTPLUS_DEBUG
-  serial_print_byte_padded_hex(out);
-  Serial.print(" ");
+  //After the write so printing does not hold up the frame
+  Serial.print("TX");
+#if defined(ANTPLUS_STATISTICS)
+  Serial.print("[");
+  serial_print_int_padded_dec( stats.tx_frames, 6 );
+  Serial.print("]");
+#endif /*defined(ANTPLUS_STATISTICS)*/
+  Serial.print(" @ ");
+  serial_print_int_padded_dec( millis(), 8 );
+  Serial.print(" ms > ");
+#if defined(ANTPLUS_MSG_STR_DECODE)
+  Serial.print( get_msg_id_str(packet->msg_id) );
+  Serial.print("[0x");
+  serial_print_byte_padded_hex(packet->msg_id);
+  Serial.print("]");
+#else
+  Serial.print("0x");
+  serial_print_byte_padded_hex(packet->msg_id);
+#endif //defined(ANTPLUS_MSG_STR_DECODE)
+  Serial.print(" - 0x");
+  for (byte cnt = 0; cnt < (packet->length + MESG_FRAME_SIZE); cnt++)
+  {
+    serial_print_byte_padded_hex(frame[cnt]);
+    Serial.print(" ");
+  }
+  Serial.println();
 #endif
-  mySerial->write(out);
-  chksum ^= out;
-  return chksum;
+  ANTPLUS_STATISTICS_COUNT( tx_frames++ );
 }
 
-//TODO: DEBUG: Convert (or add function) for a packet struct for quicker/easier printing....
 //TODO: Extend the return types
 // msgId_ResponseExpected if set to another ID than MESG_INVALID_ID will not allow a subsequent send until that message is received.
 // NOTE: This request/response check still has the potentioal for holes in it but it is sufficient for now
+boolean ANTPlus::sendFrame( const byte * frame, byte msgId_ResponseExpected )
+{
+  pollRts();
+  if(clear_to_send && (msgResponseExpected == MESG_INVALID_ID))
+  {
+    if(msgId_ResponseExpected == MESG_START_UP)
+    {
+      //e.g. send( ANT_SystemReset() ) -- the module is starting again
+      module_state_lost();
+    }
+    transmitFrame(frame);
+    //We are now waiting for this message (if it was not set as INVALID)
+    //If it does not come the frame is resent (see check_deadlines())
+    msgResponseExpected = msgId_ResponseExpected;
+    sent.sent_ms = millis();
+    if((msgId_ResponseExpected != MESG_INVALID_ID) && (msgId_ResponseExpected != MESG_START_UP))
+    {
+      memcpy( sent.frame, frame, frame[1] + MESG_FRAME_SIZE );
+      sent.response_msg_id = msgId_ResponseExpected;
+      sent.retries = 0;
+      sent.state = ANT_COMMAND_IN_FLIGHT;
+    }
+    return true;
+  }
+  //ANTPLUS_DEBUG_PRINTLN("Can't send -- not clear to send or awaiting a response");
+  return false;
+}
+
+//DEPRECATED: Kept for existing sketches. See the typed send() and ANTPlus_Messages.h
 boolean ANTPlus::send(unsigned msgId, unsigned msgId_ResponseExpected, unsigned char argCnt, ...)
 {
   va_list arg;
   va_start (arg, argCnt);
-  unsigned char byteOut;
-  unsigned char chksum = 0;
-  int cnt = 0;
+  byte args[MESG_MAX_DATA_SIZE];
+  byte frame[MESG_MAX_SIZE];
   
   boolean ret_val = false;
 
-  if(clear_to_send && (msgResponseExpected == MESG_INVALID_ID))
+  if(argCnt <= MESG_MAX_DATA_SIZE)
+  {
+    for (byte cnt = 0; cnt < argCnt; cnt++)
+    {
+      args[cnt] = va_arg(arg, unsigned int);
+    }
+    buildFrame(frame, msgId, argCnt, args);
+    ret_val = sendFrame(frame, msgId_ResponseExpected);
+  }
+  va_end(arg);
+
+  return ret_val;
+}
+
+//! Queue a command to be sent as soon as the module is clear to send. See service_commands().
+//Unlike send() this does not wait for the response to the previous command -- commands are pipelined
+//and each response is matched to its command by channel and message id.
+//callback (optional) is called with the response (or with RESPONSE_NO_ERROR and no packet once sent if msgId_ResponseExpected is MESG_INVALID_ID)
+//Returns false if the queue is full.
+boolean ANTPlus::queue_command( byte msgId, byte msgId_ResponseExpected, byte argCnt, const byte * args, ANT_CommandCallback callback, void * context )
+{
+  if( argCnt > MESG_MAX_DATA_SIZE )
+  {
+    return false;
+  }
+  ANT_Command * command = alloc_command( msgId_ResponseExpected, callback, context );
+  if( command == NULL )
+  {
+    return false;
+  }
+  buildFrame( command->frame, msgId, argCnt, args );
+  return true;
+}
+
+//! Queue an already built frame (e.g. from a typed message -- see ANTPlus_Messages.h)
+boolean ANTPlus::queue_frame( const byte * frame, byte msgId_ResponseExpected, ANT_CommandCallback callback, void * context )
+{
+  ANT_Command * command = alloc_command( msgId_ResponseExpected, callback, context );
+  if( command == NULL )
+  {
+    return false;
+  }
+  memcpy( command->frame, frame, frame[1] + MESG_FRAME_SIZE );
+  return true;
+}
+
+//! Take a free queue slot (the caller fills in the frame). NULL if the queue is full.
+ANT_Command * ANTPlus::alloc_command( byte msgId_ResponseExpected, ANT_CommandCallback callback, void * context )
+{
+  for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+  {
+    ANT_Command * command = &commands[i];
+    if( command->state == ANT_COMMAND_FREE )
+    {
+      command->response_msg_id = msgId_ResponseExpected;
+      command->callback = callback;
+      command->context = context;
+      command->sequence = commandSequence++;
+      command->retries = 0;
+      command->state = ANT_COMMAND_QUEUED;
+      return command;
+    }
+  }
+  return NULL;
+}
+
+//! Number of commands queued or awaiting their response
+byte ANTPlus::commands_pending()
+{
+  byte pending = 0;
+  for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+  {
+    if( commands[i].state != ANT_COMMAND_FREE )
+    {
+      pending++;
+    }
+  }
+  return pending;
+}
+
+//! Find the oldest command in a given state (optionally only with a given message id). NULL if none.
+ANT_Command * ANTPlus::oldest_command( byte state, byte msg_id )
+{
+  ANT_Command * oldest = NULL;
+  for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
   {
-    #ifdef ANTPLUS_DEBUG
-      Serial.print("TX[");
-      serial_print_int_padded_dec( tx_packet_count, 6 );
-      Serial.print("] @ ");
-      serial_print_int_padded_dec( millis(), 8 );
-      Serial.print(" ms > ");
-    #if defined(ANTPLUS_MSG_STR_DECODE)
-      Serial.print( get_msg_id_str(msgId) );
-      Serial.print("[0x");
-      serial_print_byte_padded_hex(msgId);
-      Serial.print("]");
-    #else
-      Serial.print("0x");
-      serial_print_byte_padded_hex(msgId);
-    #endif //defined(ANTPLUS_MSG_STR_DECODE)
-      Serial.print(" - 0x");
-    #endif
-      tx_packet_count++;
-     
-      chksum = writeByte(MESG_TX_SYNC, chksum); // send sync
-      chksum = writeByte(argCnt, chksum);       // send length
-      chksum = writeByte(msgId, chksum);        // send message id
-       
-      // Send data
-      for (cnt=1; cnt <= argCnt; cnt++)
+    ANT_Command * command = &commands[i];
+    if( (command->state == state) && ((msg_id == MESG_INVALID_ID) || (ANT_COMMAND_MSG_ID(command) == msg_id)) )
+    {
+      if( (oldest == NULL) || ((int)(command->sequence - oldest->sequence) < 0) )
       {
-        byteOut = va_arg(arg, unsigned int);
-        chksum = writeByte(byteOut, chksum);
+        oldest = command;
       }
-      va_end(arg);
-       
-      writeByte(chksum,chksum);                 // send checksum 
-      
-      clear_to_send = false;
-      ret_val = true;
-      
-      //We are now waiting for this message (if it was not set as INVALID)
-      //There are other functions that take care of the checks
-      //and eventually will have timeouts... and possibly callbacks...
-      msgResponseExpected = msgId_ResponseExpected;
-#ifdef ANTPLUS_DEBUG
-      Serial.println();
-#endif
     }
-    else
+  }
+  return oldest;
+}
+
+//! Send the next queued command if the module is clear to send.
+//Called from readPacket() so it is serviced every loop. Commands with no response are resent from here too (see check_deadlines()).
+void ANTPlus::service_commands()
+{
+  pollRts();
+  check_deadlines();
+  if( !clear_to_send )
+  {
+    return;
+  }
+  service_channels();
+  if( sent.state == ANT_COMMAND_QUEUED )
+  {
+    //A send() being resent (or a softReset() that had to wait) goes ahead of the queue (send() is not allowed again until it is answered)
+    transmitFrame( sent.frame );
+    sent.sent_ms = millis();
+    sent.state = (sent.response_msg_id == MESG_START_UP) ? ANT_COMMAND_FREE : ANT_COMMAND_IN_FLIGHT;
+    return;
+  }
+  //Nothing else can go until the module has started up
+  if( msgResponseExpected == MESG_START_UP )
+  {
+    return;
+  }
+  ANT_Command * command = oldest_command( ANT_COMMAND_QUEUED, MESG_INVALID_ID );
+  if( command == NULL )
+  {
+    return;
+  }
+
+  transmitFrame( command->frame );
+  command->sent_ms = millis();
+
+  if( command->response_msg_id == MESG_INVALID_ID )
+  {
+    command->state = ANT_COMMAND_FREE;
+    if( command->callback != NULL )
     {
-      //ANTPLUS_DEBUG_PRINTLN("Can't send -- not clear to send or awaiting a response");
-      ret_val = false;
+      command->callback( command, RESPONSE_NO_ERROR, NULL, command->context );
     }
+  }
+  else
+  {
+    command->state = ANT_COMMAND_IN_FLIGHT;
+  }
+}
 
-    return ret_val;
+//! Match a received packet to the in flight command it answers (if any) and complete that command.
+//MESG_RESPONSE_EVENT_ID carries the channel and the id of the message responded to.
+//Other responses (e.g. MESG_CAPABILITIES_ID to a MESG_REQUEST_ID) are matched on the expected response id (and channel where there is one).
+boolean ANTPlus::complete_command( const ANT_Packet * packet )
+{
+  ANT_Command * match = NULL;
+  byte response_code = RESPONSE_NO_ERROR;
+
+  if( packet->msg_id == MESG_RESPONSE_EVENT_ID )
+  {
+    byte responding_to = packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_RESPONSE_MESG_ID)];
+    if( responding_to == MESG_EVENT_ID )
+    {
+      //A channel event -- not a response to anything we sent
+      return false;
+    }
+    response_code = packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_RESPONSE_CODE)];
+    //Oldest first -- the module answers in the order it was sent to (e.g. the same network key for several channels)
+    for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+    {
+      ANT_Command * command = &commands[i];
+      if( (command->state == ANT_COMMAND_IN_FLIGHT) && (ANT_COMMAND_MSG_ID(command) == responding_to) &&
+          (ANT_COMMAND_CHANNEL(command) == packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_CHANNEL_NUM)]) &&
+          ((match == NULL) || ((int)(command->sequence - match->sequence) < 0)) )
+      {
+        match = command;
+      }
+    }
+    if( match == NULL )
+    {
+      //Not all responses carry a channel (e.g. the network key response) -- oldest with that id
+      match = oldest_command( ANT_COMMAND_IN_FLIGHT, responding_to );
+    }
+  }
+  else
+  {
+    for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+    {
+      ANT_Command * command = &commands[i];
+      if( (command->state == ANT_COMMAND_IN_FLIGHT) && (command->response_msg_id == packet->msg_id) &&
+          (ANT_COMMAND_CHANNEL(command) == packet->data[0]) && ((match == NULL) || ((int)(command->sequence - match->sequence) < 0)) )
+      {
+        match = command;
+      }
+    }
+    if( match == NULL )
+    {
+      //e.g. MESG_CAPABILITIES_ID has no channel -- oldest waiting on this response
+      for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+      {
+        ANT_Command * command = &commands[i];
+        if( (command->state == ANT_COMMAND_IN_FLIGHT) && (command->response_msg_id == packet->msg_id) &&
+            ((match == NULL) || ((int)(command->sequence - match->sequence) < 0)) )
+        {
+          match = command;
+        }
+      }
+    }
+  }
+
+  if( match == NULL )
+  {
+    return false;
+  }
+
+  //The module answers in order -- a command on the same channel sent before this one and still waiting was lost (or its
+  //response was). Resend it now rather than at its deadline. An error here may only be because that one was not done
+  //(e.g. no assign before the channel id) so this is resent after it.
+  //NOTE: Frames are at least a frame time apart (each waits for RTS) so sent_ms is enough to order them.
+  boolean earlier_lost = false;
+  for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+  {
+    ANT_Command * command = &commands[i];
+    if( (command->state == ANT_COMMAND_FREE) || (command == match) || (ANT_COMMAND_CHANNEL(command) != ANT_COMMAND_CHANNEL(match)) )
+    {
+      continue;
+    }
+    if( (command->state == ANT_COMMAND_IN_FLIGHT) && ((long)(command->sent_ms - match->sent_ms) < 0) )
+    {
+      if( !retry_command( command ) )
+      {
+        //Module reset -- match has gone with the rest of the queue
+        return true;
+      }
+      earlier_lost = true;
+    }
+    else if( (command->retries > 0) && ((int)(command->sequence - match->sequence) < 0) )
+    {
+      //Already being resent
+      earlier_lost = true;
+    }
+  }
+  if( earlier_lost && (response_code != RESPONSE_NO_ERROR) )
+  {
+    //Not this command's fault -- resending the earlier one is what is bounded, so this never goes up the recovery ladder
+    if( match->retries < ANT_COMMAND_RETRIES )
+    {
+      match->retries++;
+    }
+    match->state = ANT_COMMAND_QUEUED;
+    trace.record<ANT_TRACE_RETRY>( ANT_COMMAND_MSG_ID(match) );
+    ANTPLUS_STATISTICS_COUNT( retries++ );
+    return true;
+  }
+
+  match->state = ANT_COMMAND_FREE;
+  //The module is answering -- start from the bottom of the recovery ladder again
+  recoveryLevel = ANT_RECOVERY_NONE;
+  if( (match->retries > 0) && (response_code == CHANNEL_IN_WRONG_STATE) )
+  {
+    //An earlier send got through and only its response was lost (e.g. assigning or opening a channel twice)
+    response_code = RESPONSE_NO_ERROR;
+  }
+  trace.record<ANT_TRACE_RESPONSE>(ANT_COMMAND_MSG_ID(match));
+  ANTPLUS_STATISTICS_COUNT( countResponse(match->sent_ms, millis()) );
+  if( match->callback != NULL )
+  {
+    match->callback( match, response_code, packet, match->context );
+  }
+  return true;
 }
 
 
 //! Read a packet into ANT_Packet struct
-//readTimeoutMs -- is amount of time to wait for first byte to appeaer (can be 0)
+//readTimeoutMs -- is amount of time to poll for bytes (can be 0). Returns as soon as a packet (or error) is available
 //Return an indication of error, no packet received, the expected packet was received or another packet was received.
 MESSAGE_READ ANTPlus::readPacket( ANT_Packet * packet, int packetSize, int wait_timeout = 0 )
 {
-    MESSAGE_READ ret_val = MESSAGE_READ_NONE;
+    service_commands();
+    MESSAGE_READ ret_val = readPacketInternal(wait_timeout);
+    if (ret_val == MESSAGE_READ_INTERNAL)
+    {
+        if (rxBufCnt > packetSize)
+        {
+            ANTPLUS_READ_OUTCOME( MESSAGE_READ_ERROR_PACKET_SIZE_EXCEEDED );
+            return MESSAGE_READ_ERROR_PACKET_SIZE_EXCEEDED;
+        }
+        memcpy(packet, &rxBuf, rxBufCnt); // Copy data to packet variable
+        ret_val = dispatchPacket(packet);
+    }
+    if (ret_val != MESSAGE_READ_NONE)
+    {
+        ANTPLUS_READ_OUTCOME( ret_val );
+    }
+    return ret_val;
+}
+
+//! Read a packet without copying it
+//*packet is set to the internal frame buffer on MESSAGE_READ_EXPECTED or MESSAGE_READ_OTHER.
+//It is only valid until the next read call (which reuses the buffer).
+MESSAGE_READ ANTPlus::readPacket( const ANT_Packet ** packet, int wait_timeout )
+{
+    service_commands();
+    MESSAGE_READ ret_val = readPacketInternal(wait_timeout);
+    if (ret_val == MESSAGE_READ_INTERNAL)
+    {
+        *packet = (const ANT_Packet *) rxBuf;
+        ret_val = dispatchPacket(*packet);
+    }
+    if (ret_val != MESSAGE_READ_NONE)
+    {
+        ANTPLUS_READ_OUTCOME( ret_val );
+    }
+    return ret_val;
+}
+
+//! Drain everything buffered in one call. Each good packet is handed to sink (zero-copy -- see readPacket()).
+//Cheaper than calling readPacket() in a loop when several packets arrive back to back:
+//there is one service/pump/clock read per call rather than per packet.
+//counts (optional) is zeroed and then filled with the outcome of each frame (MESSAGE_READ_ERROR_MISSING_SYNC at most once).
+unsigned int ANTPlus::readPackets( ANT_PacketSink sink, void * context, ANT_ReadCounts * counts )
+{
+  unsigned int delivered = 0;
+  unsigned long discardCount = rx_sync_discard_count;
+
+  if (counts != NULL)
+  {
+    memset(counts, 0, sizeof(*counts));
+  }
+
+  service_commands();
+  if (pumpOnRead)
+  {
+    pumpSerial();
+  }
+  if (rxBytesPending())
+  {
+    rxLastByteMs = millis();
+  }
+
+  while (rxBytesPending())
+  {
+    MESSAGE_READ ret_val = frameByte( nextRxByte() );
+    if (ret_val != MESSAGE_READ_NONE)
+    {
+      if (ret_val == MESSAGE_READ_INTERNAL)
+      {
+        const ANT_Packet * packet = (const ANT_Packet *) rxBuf;
+        ret_val = dispatchPacket(packet);
+        sink(packet, ret_val, context);
+        delivered++;
+      }
+      if (counts != NULL)
+      {
+        counts->outcome[ret_val]++;
+      }
+      ANTPLUS_READ_OUTCOME( ret_val );
+    }
+    if (pumpOnRead && !rxBytesPending())
+    {
+      //Catch anything that arrived while the sink was busy
+      pumpSerial();
+    }
+  }
+
+  if ((rxState != ANT_FRAMER_SYNC) && ((millis() - rxLastByteMs) > ANT_PACKET_READ_NEXT_BYTE_TIMEOUT_MS))
+  {
+    trace.record<ANT_TRACE_TIMEOUT_MIDMESSAGE>(rxBufCnt);
+    framerResync();
+    if (counts != NULL)
+    {
+      counts->outcome[MESSAGE_READ_INFO_TIMEOUT_MIDMESSAGE]++;
+    }
+    ANTPLUS_READ_OUTCOME( MESSAGE_READ_INFO_TIMEOUT_MIDMESSAGE );
+    //Anything left over is picked up on the next call
+  }
+
+  if (rx_sync_discard_count != discardCount)
+  {
+    if (counts != NULL)
+    {
+      counts->outcome[MESSAGE_READ_ERROR_MISSING_SYNC]++;
+    }
+    ANTPLUS_READ_OUTCOME( MESSAGE_READ_ERROR_MISSING_SYNC );
+  }
+  return delivered;
+}
+
+//! Handle a good packet. Routes channel data to its channel and clears the expected response (if that is what this is).
+MESSAGE_READ ANTPlus::dispatchPacket( const ANT_Packet * packet )
+{
+    if( (packet->msg_id == MESG_BROADCAST_DATA_ID) || (packet->msg_id == MESG_ACKNOWLEDGED_DATA_ID) || (packet->msg_id == MESG_BURST_DATA_ID) )
+    {
+        //Upper bits are the burst sequence number
+        ANT_Channel * channel = get_channel( packet->data[0] & CHANNEL_NUMBER_MASK );
+        if( channel != NULL )
+        {
+            unsigned long now = millis();
+            if( channel->broadcast_count == 0 )
+            {
+                channel->acquisition_ms = now - channel->setup_start_ms;
+            }
+            else if( channel->channel_state != ANT_CHANNEL_STATE_TRACKING )
+            {
+                //Back after a dropout (searching, or closed and reopened). Measured from the last broadcast before it.
+                unsigned long dropout_ms = now - channel->last_rx_ms;
+                channel->dropout_count++;
+                channel->last_dropout_ms = dropout_ms;
+                if( dropout_ms > channel->longest_dropout_ms )
+                {
+                    channel->longest_dropout_ms = dropout_ms;
+                }
+                ANTPLUS_STATISTICS_COUNT( countDropout(dropout_ms) );
+            }
+            channel->last_rx_ms = now;
+            channel->broadcast_count++;
+            channel->data_rx = true;
+            set_channel_state( channel, ANT_CHANNEL_STATE_TRACKING );
+            if( packet->msg_id != MESG_BURST_DATA_ID )
+            {
+                decode_page( channel, &packet->data[1] );
+            }
+        }
+        if( packet->msg_id == MESG_BROADCAST_DATA_ID )
+        {
+            ANTPLUS_STATISTICS_COUNT( countBroadcast(packet->data[0], millis()) );
+        }
+    }
+    else if( (packet->msg_id == MESG_RESPONSE_EVENT_ID) && (packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_RESPONSE_MESG_ID)] == MESG_EVENT_ID) )
+    {
+        ANTPLUS_STATISTICS_COUNT( countChannelEvent(packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_CHANNEL_NUM)], packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_RESPONSE_CODE)]) );
+        ANT_Channel * channel = get_channel( packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_CHANNEL_NUM)] );
+        if( channel != NULL )
+        {
+            channel_event( channel, packet->data[ANT_PACKET_DATA_INDEX(BUFFER_INDEX_RESPONSE_CODE)] );
+        }
+    }
+
+    else if( packet->msg_id == MESG_CHANNEL_ID_ID )
+    {
+        paired( packet );
+    }
+
+    if( complete_command( packet ) )
+    {
+        return MESSAGE_READ_EXPECTED;
+    }
+    if( packet->msg_id == msgResponseExpected )
     {
-        ret_val = readPacketInternal(packet, packetSize, wait_timeout);
-        if (ret_val == MESSAGE_READ_INTERNAL)
+        //ANTPLUS_DEBUG_PRINTLN("Received expected message!");
+        msgResponseExpected = MESG_INVALID_ID; //Not waiting on anything anymore
+        if( sent.state != ANT_COMMAND_FREE )
         {
-            if( packet->msg_id == msgResponseExpected )
-            {
-                //ANTPLUS_DEBUG_PRINTLN("Received expected message!");
-                msgResponseExpected = MESG_INVALID_ID; //Not waiting on anything anymore
-                ret_val = MESSAGE_READ_EXPECTED;
-            }
-            else
-            {
-                //ANTPLUS_DEBUG_PRINTLN("Received unexpected message!");
-                ret_val = MESSAGE_READ_OTHER;
-            }
+            sent.state = ANT_COMMAND_FREE;
+            recoveryLevel = ANT_RECOVERY_NONE;
+            ANTPLUS_STATISTICS_COUNT( countResponse(sent.sent_ms, millis()) );
         }
+        return MESSAGE_READ_EXPECTED;
     }
-    return ret_val; 
+    if( packet->msg_id == MESG_START_UP )
+    {
+        //Not asked for -- the module reset itself and nothing set up on it survived
+        ANTPLUS_DEBUG_PRINTLN("Unexpected START_UP");
+        module_state_lost();
+        msgResponseExpected = MESG_INVALID_ID;
+    }
+    //ANTPLUS_DEBUG_PRINTLN("Received unexpected message!");
+    return MESSAGE_READ_OTHER;
+}
+
+#if defined(ANTPLUS_STATISTICS)
+void ANTPlus::resetStatistics()
+{
+  stats.reset();
+  rxRing.resetStatistics();
+}
+
+void ANTPlus::printStatistics(Print & out)
+{
+  stats.print(out);
+  out.print("Ring overruns ");
+  out.print(rxRing.overruns());
+  out.print(" high water ");
+  out.print(rxRing.highWaterMark());
+  out.print(" sync discards ");
+  out.println(rx_sync_discard_count);
 }
+#endif /*defined(ANTPLUS_STATISTICS)*/
 
 
 
@@ -330,7 +1048,7 @@ void ANTPlus::serial_print_int_padded_dec(long int value, unsigned int width, bo
   {
     div_cnt++;
   }
-  if(div_cnt < width)
+  if((unsigned int) div_cnt < width)
   {
     div_cnt = width - div_cnt - 1;
   }
@@ -357,9 +1075,13 @@ void ANTPlus::serial_print_int_padded_dec(long int value, unsigned int width, bo
 //NOTE: This function calls Serial.println directly
 void ANTPlus::printPacket(const ANT_Packet * packet, boolean final_carriage_return = true)
 {
-  Serial.print("RX[");
-  serial_print_int_padded_dec( rx_packet_count, 6, false );
-  Serial.print("] @ ");
+  Serial.print("RX");
+#if defined(ANTPLUS_STATISTICS)
+  Serial.print("[");
+  serial_print_int_padded_dec( stats.rx_frames, 6, false );
+  Serial.print("]");
+#endif /*defined(ANTPLUS_STATISTICS)*/
+  Serial.print(" @ ");
   serial_print_int_padded_dec( millis(), 8, false );
   Serial.print(" ms > ");
 //  Serial.print("0x");
@@ -398,22 +1120,36 @@ void ANTPlus::printPacket(const ANT_Packet * packet, boolean final_carriage_retu
 
 //Must be called with the same channel until an error or established (i.e. don't start with a different channel in the middle -- one channel at a time)
 //TODO: Test that interleaved calls is relaxed (s.b. with moving of state_counter to struct)
-//Must not be called with the same channel after it returns ESTABLISHED as that will attempt to reopen....
+//Calling it again after it returns ESTABLISHED does nothing more. An added channel (add_channel()) that the module closes
+//(search timeout) is reopened by the library with MESG_OPEN_CHANNEL_ID only -- see ANT_Channel::channel_state.
 ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
 {
   boolean sent_ok = true; //Defaults as true as we want to progress the state counter
   
   ANT_CHANNEL_ESTABLISH ret_val = ANT_CHANNEL_ESTABLISH_PROGRESSING;
 
+  if((channel->state_counter != 0) && (channel->reset_generation != resetGeneration))
+  {
+    //The module was reset part way through (see check_deadlines()) -- start again on the next call
+    //Added channels are reset with the module -- this one may not have been added
+    channel->error_count++;
+    channel->state_counter = 0;
+    sent_ok = false;
+    ret_val = ANT_CHANNEL_ESTABLISH_ERROR;
+  }
+  else
   if(channel->state_counter == 0)
   {
     //ANTPLUS_DEBUG_PRINTLN("progress_setup_channel() - Begin");  
+    channel->setup_start_ms = millis();
+    channel->broadcast_count = 0;
+    channel->reset_generation = resetGeneration;
   }
   else
   if(channel->state_counter == 1)
   {
     //Request CAPs
-    sent_ok = send(MESG_REQUEST_ID, MESG_CAPABILITIES_ID/*Expected response*/, 2, 0/*Channel number always 0*/, MESG_CAPABILITIES_ID);
+    sent_ok = send( ANT_Request<MESG_CAPABILITIES_ID>( 0 /*Channel number always 0*/ ) );
   }
   else
   if(channel->state_counter == 2)
@@ -422,7 +1158,7 @@ ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
     //   Channel: 0
     //   Channel Type: for Receive Channel
     //   Network Number: 0 for Public Network
-    sent_ok = send(MESG_ASSIGN_CHANNEL_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 3, channel->channel_number, 0, channel->network_number); 
+    sent_ok = send( ANT_AssignChannel( channel->channel_number, CHANNEL_TYPE_SLAVE, channel->network_number ) );
   }
   else
   if(channel->state_counter == 3)
@@ -430,19 +1166,28 @@ ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
  
     // Set Channel ID
     //   Channel Number: 0
-    //   Device Number LSB: 0 for a slave to match any device
+    //   Device Number LSB: 0 for a slave to match any device (or the remembered device -- see search_device_number())
     //   Device Number MSB: 0 for a slave to match any device
     //   Device Type: bit 7 0 for pairing request bit 6..0 for device type
     //   Transmission Type: 0 to match any transmission type
-    sent_ok = send(MESG_CHANNEL_ID_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 5, channel->channel_number, 0, 0, channel->device_type, 0);
+    byte transmission_type;
+    unsigned int device_number = search_device_number( channel, &transmission_type );
+    sent_ok = send( ANT_ChannelId( channel->channel_number, device_number, channel->device_type, transmission_type ) );
   }
   else
   if(channel->state_counter == 4)
   {
-    // Set Network Key
+    // Set Network Key -- once per network (see network_key_needed())
     //   Network Number
     //   Key
-    sent_ok = send(MESG_NETWORK_KEY_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 9, channel->network_number, channel->ant_net_key[0], channel->ant_net_key[1], channel->ant_net_key[2], channel->ant_net_key[3], channel->ant_net_key[4], channel->ant_net_key[5], channel->ant_net_key[6], channel->ant_net_key[7]);
+    if( network_key_needed( channel->network_number ) )
+    {
+      sent_ok = send( ANT_NetworkKey( channel->network_number, channel->ant_net_key ) );
+      if( sent_ok )
+      {
+        network_key_sent( channel->network_number );
+      }
+    }
   }
   else
   if(channel->state_counter == 5)
@@ -450,7 +1195,7 @@ ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
     // Set Channel Search Timeout
     //   Channel
     //   Timeout: time for timeout in 2.5 sec increments
-    sent_ok = send(MESG_CHANNEL_SEARCH_TIMEOUT_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 2, channel->channel_number, channel->timeout);
+    sent_ok = send( ANT_ChannelSearchTimeout( channel->channel_number, search_timeout( channel ) ) );
   }
   else
   if(channel->state_counter == 6)
@@ -459,19 +1204,19 @@ ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
     // Set Channel RF Frequency
     //   Channel
     //   Frequency = 2400 MHz + (FREQ * 1 MHz) (See page 59 of ANT MPaU) 0x39 = 2457 MHz
-    sent_ok = send(MESG_CHANNEL_RADIO_FREQ_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 2, channel->channel_number, channel->freq);
+    sent_ok = send( ANT_ChannelRadioFreq( channel->channel_number, channel->freq ) );
   }
   else
   if(channel->state_counter == 7)
   {
     // Set Channel Period
-    sent_ok = send(MESG_CHANNEL_MESG_PERIOD_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 3, channel->channel_number, (channel->period & 0x00FF), ((channel->period & 0xFF00) >> 8));
+    sent_ok = send( ANT_ChannelPeriod( channel->channel_number, channel->period ) );
   }
   else
   if(channel->state_counter == 8)
   {
     //Open Channel
-    sent_ok = send(MESG_OPEN_CHANNEL_ID, MESG_RESPONSE_EVENT_ID/*Expected response*/, 1, channel->channel_number);
+    sent_ok = send( ANT_OpenChannel( channel->channel_number ) );
   }
   else
   if(channel->state_counter == 9)
@@ -480,6 +1225,10 @@ ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
     if(!awaitingResponseLastSent())
     {
       ret_val = ANT_CHANNEL_ESTABLISH_COMPLETE;
+      if( channel->channel_state == ANT_CHANNEL_STATE_CLOSED )
+      {
+        set_channel_state( channel, ANT_CHANNEL_STATE_SEARCHING );
+      }
       //ANTPLUS_DEBUG_PRINTLN("progress_setup_channel() - Complete");  
     }
     else
@@ -492,48 +1241,604 @@ ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channel( ANT_Channel * channel )
   if(sent_ok)
   {
     channel->state_counter++;
+    trace.record<ANT_TRACE_SETUP_STEP>( ANT_TRACE_CHANNEL_ARG(channel->channel_number, channel->state_counter) );
   }
   else
   {
     //Not always an error - as sometimes there are messages in the queue that are awaiting a response
+    //A response that never comes is resent (and then the module reset) from readPacket() -- see check_deadlines()
     //ANTPLUS_DEBUG_PRINTLN("Issue sending....");
-    {
-        if( digitalRead(RTS_PIN) == LOW)
-        {
-          static unsigned int sending_issue_counter = 0;
-          sending_issue_counter++;
-          
-          //This should clear on the next loop ( this should be after ANT asserts -- but could conceivably be before it has even responded)
-          // The ISR sets a loop flag and the ISR should be triggered within 50 usecs
-          if(sending_issue_counter >= 50)
-          {
-            //Seems like we missed an RTS assertion.....
-            ANTPLUS_DEBUG_PRINTLN( "Missed an RTS or none was executed by ANT. Restarting...." );
-            sending_issue_counter = 0;
-            hardwareReset();
-            
-            ret_val = ANT_CHANNEL_ESTABLISH_ERROR;
-          }
-        }
-    }
   }
   
+  if( channel->channel_establish != ret_val )
+  {
+    trace.record<ANT_TRACE_SETUP_ESTABLISH>( ANT_TRACE_CHANNEL_ARG(channel->channel_number, ret_val) );
+  }
   channel->channel_establish = ret_val;
   
   return ret_val;
 }
 
-//! A function that is called when an RTS interrupt is received in the main program
-void   ANTPlus::rTSHighAssertion()
+//! Add a channel to the channel manager. Broadcasts for channel->channel_number are routed to it.
+//Returns false if the channel number is out of range or already taken.
+boolean ANTPlus::add_channel( ANT_Channel * channel )
+{
+  if( (channel->channel_number < 0) || (channel->channel_number >= ANT_DEVICE_NUMBER_CHANNELS) || (channels[channel->channel_number] != NULL) )
+  {
+    return false;
+  }
+  channels[channel->channel_number] = channel;
+  match_profile( channel );
+  return true;
+}
+
+//! Register a profile. Added channels (and channels added later) of its device type are matched to it here -- the
+//ANT_Channel::device_type at the time is what counts.
+boolean ANTPlus::add_profile( const ANT_Profile * profile, const void * sink )
+{
+  byte device_type = pgm_read_byte( &profile->device_type );
+  for( byte i = 0; i < profileCount; i++ )
+  {
+    if( pgm_read_byte( &profiles[i]->device_type ) == device_type )
+    {
+      return false;
+    }
+  }
+  if( profileCount >= ANT_PROFILE_MAX )
+  {
+    return false;
+  }
+  profiles[profileCount] = profile;
+  profileSinks[profileCount] = sink;
+  profileCount++;
+  for(int i = 0; i < ANT_DEVICE_NUMBER_CHANNELS; i++)
+  {
+    if( channels[i] != NULL )
+    {
+      match_profile( channels[i] );
+    }
+  }
+  return true;
+}
+
+//! Work out the profile for a channel now so decode_page() does not search for it
+void ANTPlus::match_profile( const ANT_Channel * channel )
+{
+  channelProfiles[channel->channel_number] = ANT_PROFILE_NONE;
+  for( byte i = 0; i < profileCount; i++ )
+  {
+    byte networks = pgm_read_byte( &profiles[i]->networks );
+    if( (networks != 0) &&
+        ((channel->network_number < 0) || (channel->network_number > 7) || ((networks & (1 << channel->network_number)) == 0)) )
+    {
+      continue;
+    }
+    if( pgm_read_byte( &profiles[i]->device_type ) == (channel->device_type & 0x7F) )
+    {
+      channelProfiles[channel->channel_number] = i;
+      return;
+    }
+  }
+}
+
+//! Pass a data page for an added channel to its profile's decoder (if it has one for the page)
+void ANTPlus::decode_page( const ANT_Channel * channel, const byte * page )
+{
+  byte index = channelProfiles[channel->channel_number];
+  if( index == ANT_PROFILE_NONE )
+  {
+    return;
+  }
+  const ANT_Profile * profile = profiles[index];
+  byte page_number = page[0] & pgm_read_byte( &profile->page_mask );
+  if( page_number >= pgm_read_byte( &profile->page_count ) )
+  {
+    return;
+  }
+  const ANT_PageDecoder * pages = (const ANT_PageDecoder *) pgm_read_ptr( &profile->pages );
+  ANT_PageDecoder decoder = (ANT_PageDecoder) pgm_read_ptr( &pages[page_number] );
+  if( decoder != NULL )
+  {
+    decoder( channel, page, profileSinks[index] );
+  }
+}
+
+//! Returns the added channel for a channel number (or NULL)
+ANT_Channel * ANTPlus::get_channel( byte channel_number )
+{
+  if( channel_number >= ANT_DEVICE_NUMBER_CHANNELS )
+  {
+    return NULL;
+  }
+  return channels[channel_number];
+}
+
+//! Queue one step of the channel setup (see progress_setup_channel() for the sequence). Returns false if the queue is full.
+boolean ANTPlus::queue_setup_step( ANT_Channel * channel, int step )
+{
+  switch( step )
+  {
+    case 1:
+      //Request CAPs
+      return queue_setup_command( ANT_Request<MESG_CAPABILITIES_ID>( 0 /*Channel number always 0*/ ), channel );
+    case 2:
+      return queue_setup_command( ANT_AssignChannel( channel->channel_number, CHANNEL_TYPE_SLAVE, channel->network_number ), channel );
+    case 3:
+    {
+      byte transmission_type;
+      unsigned int device_number = search_device_number( channel, &transmission_type );
+      return queue_setup_command( ANT_ChannelId( channel->channel_number, device_number, channel->device_type, transmission_type ), channel );
+    }
+    case 4:
+      if( !network_key_needed( channel->network_number ) )
+      {
+        return true;
+      }
+      if( !queue_setup_command( ANT_NetworkKey( channel->network_number, channel->ant_net_key ), channel ) )
+      {
+        return false;
+      }
+      network_key_sent( channel->network_number );
+      return true;
+    case 5:
+      return queue_setup_command( ANT_ChannelSearchTimeout( channel->channel_number, search_timeout( channel ) ), channel );
+    case 6:
+      return queue_setup_command( ANT_ChannelRadioFreq( channel->channel_number, channel->freq ), channel );
+    case 7:
+      return queue_setup_command( ANT_ChannelPeriod( channel->channel_number, channel->period ), channel );
+    case 8:
+      return queue_setup_command( ANT_OpenChannel( channel->channel_number ), channel );
+  }
+  return false;
+}
+
+//! The network key goes to the module once per network number until its state is lost -- the first channel on a network sends
+//it (from the built in steps or a script's ANT_SCRIPT_NETWORK_KEY) and the rest (sharing the key) skip it. Marked as sent once
+//queued so the channels after it in the pipeline skip it too. A key that is answered with an error (a network number the module
+//does not have) fails the assign of every channel on that network anyway. Network numbers above 7 are always sent.
+boolean ANTPlus::network_key_needed( int network_number )
+{
+  if( (network_number < 0) || (network_number > 7) )
+  {
+    return true;
+  }
+  return (networkKeys & (1 << network_number)) == 0;
+}
+
+void ANTPlus::network_key_sent( int network_number )
+{
+  if( (network_number >= 0) && (network_number <= 7) )
+  {
+    networkKeys |= (1 << network_number);
+  }
+}
+
+//! Stream the channel's PROGMEM setup script into the command queue (as much as there is room for).
+//state_counter is the offset of the next record. Returns true once the whole script is queued.
+boolean ANTPlus::queue_setup_script( ANT_Channel * channel )
+{
+  byte args[MESG_MAX_DATA_SIZE];
+  for(;;)
+  {
+    const byte * record = channel->setup_script + channel->state_counter;
+    byte size = pgm_read_byte( record );
+    if( size == ANT_SCRIPT_END )
+    {
+      return true;
+    }
+    if( (size > MESG_MAX_DATA_SIZE) || (pgm_read_byte( record + 1 ) == MESG_SYSTEM_RESET_ID) )
+    {
+      //Broken script (a reset would lose every channel -- see softReset())
+      channel->channel_establish = ANT_CHANNEL_ESTABLISH_ERROR;
+      return false;
+    }
+    if( (pgm_read_byte( record + 1 ) == MESG_OPEN_CHANNEL_ID) && (channel->commands_pending > 0) )
+    {
+      //Open once everything before it has been answered (see progress_setup_channels())
+      return false;
+    }
+    if( (pgm_read_byte( record + 1 ) == MESG_NETWORK_KEY_ID) && !network_key_needed( pgm_read_byte( record + 2 ) ) )
+    {
+      //Already sent for this network (see network_key_needed())
+      channel->state_counter += size + 3;
+      continue;
+    }
+    ANT_Command * command = alloc_command( pgm_read_byte( record + 2 + size ), setup_command_done, channel );
+    if( command == NULL )
+    {
+      return false;
+    }
+    for( byte i = 0; i < size; i++ )
+    {
+      args[i] = pgm_read_byte( record + 2 + i );
+    }
+    buildFrame( command->frame, pgm_read_byte( record + 1 ), size, args );
+    if( pgm_read_byte( record + 1 ) == MESG_NETWORK_KEY_ID )
+    {
+      network_key_sent( args[0] );
+    }
+    channel->commands_pending++;
+    channel->state_counter += size + 3;
+    trace.record<ANT_TRACE_SETUP_STEP>( ANT_TRACE_CHANNEL_ARG(channel->channel_number, channel->state_counter) );
+  }
+}
+
+//! Completion of a command queued by queue_setup_step() or queue_setup_script()
+void ANTPlus::setup_command_done( const ANT_Command * /*command*/, byte response_code, const ANT_Packet * /*response*/, void * context )
+{
+  ANT_Channel * channel = (ANT_Channel *) context;
+  channel->commands_pending--;
+  if( response_code != RESPONSE_NO_ERROR )
+  {
+    //Left in error (and skipped by progress_setup_channels()) until the next reset
+    channel->error_count++;
+    channel->channel_establish = ANT_CHANNEL_ESTABLISH_ERROR;
+  }
+}
+
+//! Track an established channel from its channel events (MESG_EVENT_ID responses).
+//EVENT_RX_SEARCH_TIMEOUT needs nothing -- the module closes the channel and EVENT_CHANNEL_CLOSED follows.
+void ANTPlus::channel_event( ANT_Channel * channel, byte event )
+{
+  if( (event == EVENT_RX_FAIL_GO_TO_SEARCH) && (channel->channel_state == ANT_CHANNEL_STATE_TRACKING) )
+  {
+    set_channel_state( channel, ANT_CHANNEL_STATE_SEARCHING );
+  }
+  else if( (event == EVENT_CHANNEL_CLOSED) && (channel->channel_state != ANT_CHANNEL_STATE_CLOSED) )
+  {
+    //The module gave up searching. Everything else set up on the channel is still there -- service_channels() only opens it.
+    set_channel_state( channel, ANT_CHANNEL_STATE_REOPENING );
+  }
+}
+
+//! Queue MESG_OPEN_CHANNEL_ID for established channels the module has closed and, once a channel is tracking, a request for
+//the id of the device it paired with (see paired()). From service_commands() so it happens whether or not the sketch still
+//calls progress_setup_channels().
+void ANTPlus::service_channels()
+{
+  boolean setting_up = false;
+  for(int i = 0; i < ANT_DEVICE_NUMBER_CHANNELS; i++)
+  {
+    ANT_Channel * channel = channels[i];
+    if( (channel != NULL) && ((channel->channel_establish == ANT_CHANNEL_ESTABLISH_PROGRESSING) || (channel->channel_state == ANT_CHANNEL_STATE_REOPENING)) )
+    {
+      setting_up = true;
+    }
+    if( (channel != NULL) && (channel->channel_state == ANT_CHANNEL_STATE_REOPENING) &&
+        (channel->channel_establish == ANT_CHANNEL_ESTABLISH_COMPLETE) && (channel->commands_pending == 0) )
+    {
+      if( channel->pairing & ANT_PAIRING_CACHED )
+      {
+        //The remembered device was not found -- back to the channel's own id and search timeout, then open (next time,
+        //once those are answered)
+        if( (ANT_COMMAND_QUEUE_LEN - commands_pending()) < 2 )
+        {
+          return;
+        }
+        channel->pairing &= ~ANT_PAIRING_CACHED;
+        queue_setup_command( ANT_ChannelId( channel->channel_number, channel->device_number, channel->device_type, channel->transmission_type ), channel );
+        queue_setup_command( ANT_ChannelSearchTimeout( channel->channel_number, channel->timeout ), channel );
+        continue;
+      }
+      if( !queue_command( ANT_OpenChannel( channel->channel_number ), reopen_done, channel ) )
+      {
+        //Queue full -- next time
+        return;
+      }
+      channel->commands_pending++;
+    }
+  }
+
+  //Only when nothing else is queued or still to be -- not in the way of setting up the other channels. Once per open.
+  for(int i = 0; !setting_up && (i < ANT_DEVICE_NUMBER_CHANNELS) && (commands_pending() == 0); i++)
+  {
+    ANT_Channel * channel = channels[i];
+    if( (channel != NULL) && (channel->channel_state == ANT_CHANNEL_STATE_TRACKING) &&
+        ((channel->pairing & ANT_PAIRING_ID_REQUESTED) == 0) &&
+        queue_command( ANT_Request<MESG_CHANNEL_ID_ID>( channel->channel_number ) ) )
+    {
+      channel->pairing |= ANT_PAIRING_ID_REQUESTED;
+    }
+  }
+}
+
+//! Completion of the MESG_OPEN_CHANNEL_ID queued by service_channels()
+void ANTPlus::reopen_done( const ANT_Command * /*command*/, byte response_code, const ANT_Packet * /*response*/, void * context )
+{
+  ANT_Channel * channel = (ANT_Channel *) context;
+  channel->commands_pending--;
+  if( response_code == ANT_COMMAND_LOST )
+  {
+    //Module reset -- the channel is set up from the start again
+    return;
+  }
+  if( (response_code == RESPONSE_NO_ERROR) || (response_code == CHANNEL_IN_WRONG_STATE) )
+  {
+    //Open (already open if a resend got there twice). Not traced -- this is static (see set_channel_state()).
+    channel->reopen_count++;
+    if( channel->channel_state == ANT_CHANNEL_STATE_REOPENING )
+    {
+      channel->channel_state = ANT_CHANNEL_STATE_SEARCHING;
+    }
+    return;
+  }
+  //The rest of the set up did not survive after all -- set the channel up from the start
+  channel->error_count++;
+  channel->state_counter = 0;
+  channel->setup_start_ms = 0;
+  channel->channel_state = ANT_CHANNEL_STATE_CLOSED;
+  channel->channel_establish = ANT_CHANNEL_ESTABLISH_PROGRESSING;
+}
+
+void ANTPlus::set_channel_state( ANT_Channel * channel, ANT_CHANNEL_STATE state )
+{
+  if( channel->channel_state != state )
+  {
+    trace.record<ANT_TRACE_CHANNEL_STATE>( ANT_TRACE_CHANNEL_ARG(channel->channel_number, state) );
+    channel->channel_state = state;
+  }
+  if( (state == ANT_CHANNEL_STATE_CLOSED) || (state == ANT_CHANNEL_STATE_REOPENING) )
+  {
+    //A wildcard search may pair with a different device once it is opened again
+    channel->pairing &= ~ANT_PAIRING_ID_REQUESTED;
+  }
+}
+
+//! Device number (and transmission type) for the channel id in setup. The channel's own, else the device of this type
+//in the pairing cache (ANT_PAIRING_CACHED), else the wildcard (0).
+unsigned int ANTPlus::search_device_number( ANT_Channel * channel, byte * transmission_type )
+{
+  channel->pairing &= ~ANT_PAIRING_CACHED;
+  *transmission_type = channel->transmission_type;
+#if defined(ANTPLUS_PAIRING)
+  if( (channel->device_number == 0) && (pairingCache != NULL) )
+  {
+    const ANT_PairedDevice * device = pairingCache->find( channel->device_type );
+    if( device != NULL )
+    {
+      channel->pairing |= ANT_PAIRING_CACHED;
+      *transmission_type = device->transmission_type;
+      return device->device_number;
+    }
+  }
+#endif /*defined(ANTPLUS_PAIRING)*/
+  return channel->device_number;
+}
+
+//! Search timeout for setup. Shorter when looking for a remembered device so a device that is not about soon gives way
+//to the wildcard search (see service_channels()).
+byte ANTPlus::search_timeout( const ANT_Channel * channel )
+{
+#if defined(ANTPLUS_PAIRING)
+  if( (channel->pairing & ANT_PAIRING_CACHED) && (channel->timeout > ANT_PAIRING_SEARCH_TIMEOUT) )
+  {
+    return ANT_PAIRING_SEARCH_TIMEOUT;
+  }
+#endif /*defined(ANTPLUS_PAIRING)*/
+  return channel->timeout;
+}
+
+//! MESG_CHANNEL_ID_ID from the module -- the device an added channel is paired with. Remembered in the pairing cache.
+void ANTPlus::paired( const ANT_Packet * packet )
+{
+  ANT_Channel * channel = get_channel( packet->data[0] );
+  unsigned int device_number = packet->data[1] | (packet->data[2] << 8);
+  if( (channel == NULL) || (device_number == 0) )
+  {
+    //Not paired (still a wildcard)
+    return;
+  }
+  channel->paired_device_number = device_number;
+  channel->paired_transmission_type = packet->data[4];
+#if defined(ANTPLUS_PAIRING)
+  if( (channel->pairing & ANT_PAIRING_CACHED) &&
+      ((search_timeout( channel ) == channel->timeout) ||
+       queue_command( ANT_ChannelSearchTimeout( channel->channel_number, channel->timeout ) )) )
+  {
+    //Found it -- if it goes away search for it (not a wildcard) for as long as the channel's own timeout
+    channel->pairing &= ~ANT_PAIRING_CACHED;
+  }
+  if( pairingCache != NULL )
+  {
+    //Without the pairing bit
+    pairingCache->remember( packet->data[3] & 0x7F, device_number, packet->data[4] );
+  }
+#endif /*defined(ANTPLUS_PAIRING)*/
+}
+
+//! Progress setup of every added channel.
+//All the setup commands for all channels are pipelined through the command queue (see queue_command()).
+//A channel is established once all of its commands have been answered.
+//Returns ANT_CHANNEL_ESTABLISH_ERROR if any channel had an error response (that channel is not retried until a reset).
+ANT_CHANNEL_ESTABLISH ANTPlus::progress_setup_channels()
 {
-      //"Waiting for ANT to RTS (let us send again)."
-      //Need to make sure it is low again
-      while( digitalRead(RTS_PIN) != LOW )
+  ANT_CHANNEL_ESTABLISH ret_val = ANT_CHANNEL_ESTABLISH_COMPLETE;
+
+  for(int i = 0; i < ANT_DEVICE_NUMBER_CHANNELS; i++)
+  {
+    ANT_Channel * channel = channels[i];
+    if( channel == NULL )
+    {
+      continue;
+    }
+    if( channel->channel_establish == ANT_CHANNEL_ESTABLISH_ERROR )
+    {
+      ret_val = ANT_CHANNEL_ESTABLISH_ERROR;
+      continue;
+    }
+    if( channel->channel_establish == ANT_CHANNEL_ESTABLISH_COMPLETE )
+    {
+      continue;
+    }
+
+    if( channel->setup_start_ms == 0 )
+    {
+      channel->setup_start_ms = millis();
+      channel->broadcast_count = 0;
+    }
+
+    //Queue as much of the sequence as there is room for
+    boolean all_queued;
+    if( channel->setup_script != NULL )
+    {
+      all_queued = queue_setup_script( channel );
+    }
+    else
+    {
+      if( channel->state_counter == 0 )
+      {
+        channel->state_counter++;
+      }
+      //The open (the last step) waits for the rest to be answered -- a resent command must not land after it
+      while( (channel->state_counter < ANT_SETUP_COMPLETE_STATE) &&
+             ((channel->state_counter < (ANT_SETUP_COMPLETE_STATE - 1)) || (channel->commands_pending == 0)) &&
+             queue_setup_step( channel, channel->state_counter ) )
+      {
+        channel->state_counter++;
+        trace.record<ANT_TRACE_SETUP_STEP>( ANT_TRACE_CHANNEL_ARG(channel->channel_number, channel->state_counter) );
+      }
+      all_queued = (channel->state_counter == ANT_SETUP_COMPLETE_STATE);
+    }
+
+    if( all_queued && (channel->commands_pending == 0) )
+    {
+      channel->channel_establish = ANT_CHANNEL_ESTABLISH_COMPLETE;
+      trace.record<ANT_TRACE_SETUP_ESTABLISH>( ANT_TRACE_CHANNEL_ARG(channel->channel_number, ANT_CHANNEL_ESTABLISH_COMPLETE) );
+      if( channel->channel_state == ANT_CHANNEL_STATE_CLOSED )
       {
-        //TODO: Is this a bad idea in an ISR?
-        delayMicroseconds(50);
+        //Open -- unless a broadcast has already been routed to it
+        set_channel_state( channel, ANT_CHANNEL_STATE_SEARCHING );
       }
-      clear_to_send = true;
+    }
+    else if( ret_val == ANT_CHANNEL_ESTABLISH_COMPLETE )
+    {
+      ret_val = ANT_CHANNEL_ESTABLISH_PROGRESSING;
+    }
+  }
+
+  //A missed RTS or lost response is dealt with here too (see check_deadlines())
+  service_commands();
+  return ret_val;
+}
+
+//! RTS went high -> low (attached by begin()). The module has taken the last message and can take the next.
+//Only sets a flag -- the send itself happens from the main loop (Stream writes and the command queue are not interrupt safe).
+void ANTPlus::rtsFallingIsr()
+{
+  if( rtsInstance != NULL )
+  {
+    rtsInstance->rtsFell = true;
+  }
+}
+
+//! Turn an RTS edge (rtsFallingIsr() or rTSHighAssertion()) into clear_to_send. Never waits.
+//Called before anything is sent so a queued command goes on the first library call after the module is ready.
+void ANTPlus::pollRts()
+{
+  if( clear_to_send )
+  {
+    return;
+  }
+  boolean edge = rtsFell || (rtsRose && (digitalRead(RTS_PIN) == LOW));
+  if( !edge )
+  {
+    //No pulse for the last frame -- the module did not take it (it only pulses for a good frame) or the edge was missed.
+    //RTS low is still the module ready for the next one.
+    if( ((millis() - rtsWaitMs) < ANT_RTS_TIMEOUT_MS) || (digitalRead(RTS_PIN) != LOW) )
+    {
+      return;
+    }
+    ANTPLUS_STATISTICS_COUNT( rts_timeouts++ );
+  }
+  rtsFell = false;
+  rtsRose = false;
+  clear_to_send = true;
+  ANTPLUS_CAPTURE_RECORD( rts() );
+  trace.record<ANT_TRACE_RTS>(edge ? 0 : 1);
+}
+
+//! Resend commands (and the last send()) with no response in ANT_RESPONSE_TIMEOUT_MS. When the resends run out go up
+//the recovery ladder (see recover()). Also the reset line if RTS is held high or MESG_START_UP never comes (ANT_RESET_TIMEOUT_MS).
+//Deadlines use millis() differences so they are safe across the wrap.
+//Nothing is timed out while there are bytes still to read -- a slow loop() must not time out a response waiting in a buffer.
+void ANTPlus::check_deadlines()
+{
+  if( rxBytesPending() || (rxState != ANT_FRAMER_SYNC) || (pumpOnRead && (mySerial->available() > 0)) )
+  {
+    return;
+  }
+  unsigned long now = millis();
+
+  if( msgResponseExpected == MESG_START_UP )
+  {
+    if( (now - sent.sent_ms) < ANT_RESET_TIMEOUT_MS )
+    {
+      return;
+    }
+    if( clear_to_send )
+    {
+      //The module is up (RTS is low) -- only the START_UP message was lost (e.g. corrupted)
+      trace.record<ANT_TRACE_START_UP_LOST>(0);
+      ANTPLUS_STATISTICS_COUNT( lost_start_ups++ );
+      msgResponseExpected = MESG_INVALID_ID;
+      return;
+    }
+    ANTPLUS_DEBUG_PRINTLN( "No START_UP. Restarting...." );
+    hardwareReset();
+    return;
+  }
+
+  if( !clear_to_send && ((now - rtsWaitMs) >= ANT_RESET_TIMEOUT_MS) )
+  {
+    //RTS held high -- only the reset line gets past that
+    ANTPLUS_DEBUG_PRINTLN( "RTS stuck. Restarting...." );
+    hardwareReset();
+    return;
+  }
+
+  if( (sent.state == ANT_COMMAND_IN_FLIGHT) && ((now - sent.sent_ms) >= ANT_RESPONSE_TIMEOUT_MS) && !retry_command( &sent ) )
+  {
+    return;
+  }
+  for( byte i = 0; i < ANT_COMMAND_QUEUE_LEN; i++ )
+  {
+    ANT_Command * command = &commands[i];
+    if( (command->state == ANT_COMMAND_IN_FLIGHT) && ((now - command->sent_ms) >= ANT_RESPONSE_TIMEOUT_MS) && !retry_command( command ) )
+    {
+      return;
+    }
+  }
+}
+
+//! No response to command. Queue it to be sent again (ahead of newer commands) or, once it has been resent
+//ANT_COMMAND_RETRIES times, recover(). Returns false if the module was reset (and the queue emptied).
+boolean ANTPlus::retry_command( ANT_Command * command )
+{
+  if( command->retries >= ANT_COMMAND_RETRIES )
+  {
+    ANTPLUS_DEBUG_PRINTLN( "No response. Resetting...." );
+    recover();
+    return false;
+  }
+  command->retries++;
+  command->state = ANT_COMMAND_QUEUED;
+  trace.record<ANT_TRACE_RETRY>( ANT_COMMAND_MSG_ID(command) );
+  ANTPLUS_STATISTICS_COUNT( retries++ );
+  return true;
+}
+
+//! Resending did not get a response. MESG_SYSTEM_RESET_ID (a few ms and the channels are set up again) unless that has
+//already been tried since the last response -- then the reset line.
+void ANTPlus::recover()
+{
+  if( recoveryLevel == ANT_RECOVERY_NONE )
+  {
+    softReset();
+  }
+  else
+  {
+    hardwareReset();
+  }
 }
 
 
@@ -549,7 +1854,7 @@ void ANTPlus::sleep(boolean activate_sleep)
 }
 
 //!Put ANT module into suspend mode. NOTE: Not implemented
-void ANTPlus::suspend(boolean activate_suspend)
+void ANTPlus::suspend(boolean /*activate_suspend*/)
 {
     //TODO:
     assert(false);
@@ -557,7 +1862,7 @@ void ANTPlus::suspend(boolean activate_suspend)
 
 // SDM -- 6.2.2
 //Distance, time and stride count
-int ANTPlus::update_sdm_rollover( byte MessageValue, unsigned long int * Cumulative, byte * PreviousMessageValue )
+int ANTPlus::update_sdm_rollover( byte MessageValue, unsigned long int * Cumulative, int * PreviousMessageValue )
 {
   //Initialize CumulativeDistance to 0
   //Above is external to this function
@@ -16,6 +16,9 @@
 //NOTE: That hardware 'Serial' might have issues when other interrupts
 // are present (e.g. SPI) and might not receive all messages.
 // SS does not have this issue.
+// Received bytes are moved into a receive ring (see ANTPlus_RingBuffer.h) before framing.
+// Calling pumpSerial() during slow work (printing, SD writes) or feeding receiveByte()
+// from an RX ISR stops the (small) UART buffer overflowing.
 
 #ifndef ANTPLus_h
 #define ANTPLus_h
@@ -27,6 +30,10 @@
 
 //#define ANTPLUS_DEBUG //!< Prints various debug messages. Disable here or via using NDEBUG externally
 //#define ANTPLUS_MSG_STR_DECODE //<! Stringiser for various codes for easier debugging
+//#define ANTPLUS_CAPTURE //!< Allow traffic to be recorded with setCapture() (see ANTPlus_Capture.h)
+//#define ANTPLUS_STATISTICS //!< Read outcome counters, per channel broadcast histograms and command latency (see ANTPlus_Statistics.h). ~390 bytes of SRAM on AVR
+//#define ANTPLUS_TRACE //!< Timestamped trace of parser/TX/RTS/setup events in a RAM ring (see ANTPlus_Trace.h). Off, the hooks compile to nothing
+//#define ANTPLUS_PAIRING //!< Remember paired devices and search for them first with setPairingCache() (see ANTPlus_Pairing.h)
 
 #if defined(NDEBUG)
 #undef ANTPLUS_DEBUG
@@ -37,7 +44,12 @@
 #include "antdefines.h"
 #include "antmessage.h"
 
-#define ANT_PACKET_READ_NEXT_BYTE_TIMEOUT_MS  (10) //<! If we get a byte in a read -- how long do we wait for the next byte before timing out...
+#include "ANTPlus_RingBuffer.h"
+#include "ANTPlus_Messages.h"
+#include "ANTPlus_Script.h"
+#include "ANTPlus_Trace.h"
+
+#define ANT_PACKET_READ_NEXT_BYTE_TIMEOUT_MS  (10) //<! If we have part of a frame -- how long since the last byte before the partial frame is considered stale...
 
 #if defined(ANTPLUS_MINIMAL_RECEIVE_BUFFER_FOR_BROADCAST_DATA)
 #define ANT_MAX_PACKET_LEN        (16) //!< This is the size of a packet buffer that should be presented for a read function (optimised for size with only small broadcast packets (e.g. HRM) ).
@@ -45,9 +57,9 @@
 #define ANT_MAX_PACKET_LEN        (80)             //!< This is the size of a packet buffer that should be presented for a read function.
 #endif
 
-//BK - Hack to save the teeniest of SRAM space....
-//#define ANT_DEVICE_NUMBER_CHANNELS (8) //!< nRF24AP2 has an 8 channel version.
-#define ANT_DEVICE_NUMBER_CHANNELS (1) //!< nRF24AP2 has an 8 channel version. However -- it seems there are issues bringing up two channels with this code. TODO: Review and fix.
+#if !defined(ANT_DEVICE_NUMBER_CHANNELS)
+#define ANT_DEVICE_NUMBER_CHANNELS (8) //!< nRF24AP2 has an 8 channel version. Each channel slot costs a pointer of SRAM (see ANTPlus::add_channel()).
+#endif
 
 
 
@@ -66,7 +78,14 @@
 #define DATA_PAGE_SPEED_DISTANCE_1              (0x01) 
 #define DATA_PAGE_SPEED_DISTANCE_2              (0x02) 
 
+#define DATA_PAGE_GPS_PROGRAMMABLE_FIRST        (0x20) //!< Programmable pages 0x20..0x2F (geocache) -- byte 1 is the data id
+#define DATA_PAGE_GPS_PROGRAMMABLE_LAST         (0x2F)
+
+#define GPS_DATA_ID_LATITUDE                    (0x00) //!< Semicircles (2^31 = 180 degrees) in bytes 2..5, LSB first
+#define GPS_DATA_ID_LONGITUDE                   (0x01)
+
 #define PUBLIC_NETWORK     (  0)
+#define GPS_NETWORK        (  1) //!< Second network -- with its own key (e.g. ANT_GPS_NETWORK_KEY in the example)
 
 #define DEVCE_TYPE_HRM     (120)
 #define DEVCE_TYPE_CADENCE (121)
@@ -111,19 +130,39 @@ typedef struct ANT_DataPage_struct
 } ANT_DataPage;
 
 
+//! Any HRM page. Bytes 1-3 depend on the page (reserved on page 0 and on legacy straps that do not toggle).
+//Multi-byte values are LSB first. See ANTHeartRate (ANTPlus_HeartRate.h) for decoding them.
 typedef struct ANT_HRMDataPage_struct
 {
   byte data_page_number:7;
   byte page_change_toggle:1;
-//TODO: Union below
-   byte who_cares_1;
-   byte who_cares_2;
-   byte who_cares_3;
-   byte who_cares_4;
-   byte who_cares_5;
-//TODO: Union above
-   byte heart_beat_count;
-   byte computed_heart_rate;
+  union
+  {
+    byte reserved[3];
+    struct
+    {
+      byte cumulative_operating_time[3]; //!< 2 s units
+    } page_1;
+    struct
+    {
+      byte manufacturer_id;
+      byte serial_number[2];             //!< Upper 16 bits of the serial number
+    } page_2;
+    struct
+    {
+      byte hardware_version;
+      byte software_version;
+      byte model_number;
+    } page_3;
+    struct
+    {
+      byte manufacturer_specific;
+      byte previous_heart_beat_event_time[2]; //!< 1/1024 s
+    } page_4;
+  };
+  byte heart_beat_event_time[2];         //!< 1/1024 s
+  byte heart_beat_count;
+  byte computed_heart_rate;
 
 } ANT_HRMDataPage;
 
@@ -154,6 +193,23 @@ typedef struct ANT_SDMDataPage2_struct
   byte status;
 } ANT_SDMDataPage2;
 
+//! Bike speed and cadence sensor (DEVCE_TYPE_CADENCE). There is no page number -- every message is this.
+typedef struct ANT_SpeedCadenceDataPage_struct
+{
+  byte cadence_event_time[2];             //!< 1/1024 s, LSB first
+  byte cumulative_cadence_revolutions[2];
+  byte speed_event_time[2];               //!< 1/1024 s
+  byte cumulative_speed_revolutions[2];   //!< Wheel revolutions
+} ANT_SpeedCadenceDataPage;
+
+//! GPS (geocache) programmable page (DATA_PAGE_GPS_PROGRAMMABLE_FIRST..DATA_PAGE_GPS_PROGRAMMABLE_LAST)
+typedef struct ANT_GPSDataPage_struct
+{
+  byte data_page_number;
+  byte data_id;           //!< GPS_DATA_ID_*
+  byte data[6];           //!< Latitude/longitude in data[0..3], LSB first
+} ANT_GPSDataPage;
+
 //! See progress_setup_channel().
 typedef enum
 {
@@ -163,6 +219,16 @@ typedef enum
 
 }   ANT_CHANNEL_ESTABLISH;
 
+//! Where an established channel is on the module, from its channel events. See ANT_Channel::channel_state.
+typedef enum
+{
+  ANT_CHANNEL_STATE_CLOSED,    //!< Not open (not set up yet, the module was reset or closed by the host with MESG_CLOSE_CHANNEL_ID)
+  ANT_CHANNEL_STATE_REOPENING, //!< Closed by the module (EVENT_CHANNEL_CLOSED after a search timeout) -- only MESG_OPEN_CHANNEL_ID is sent again
+  ANT_CHANNEL_STATE_SEARCHING, //!< Open and searching (after the open or EVENT_RX_FAIL_GO_TO_SEARCH)
+  ANT_CHANNEL_STATE_TRACKING,  //!< Receiving broadcasts
+
+} ANT_CHANNEL_STATE;
+
 #define ANT_CHANNEL_NUMBER_INVALID (-1)
 
 //! Details required to establish an ANT+ (and ANT?) channel. See progress_setup_channel().
@@ -175,32 +241,157 @@ typedef struct ANT_Channel_struct
    int device_type;
    int freq;
    int period;
-   unsigned char ant_net_key[8];
+   unsigned char ant_net_key[8]; //!< Sent once per network_number after a reset -- channels on the same network must share the key
    
    ANT_CHANNEL_ESTABLISH channel_establish; //Read-only from external
-   boolean data_rx;                         //Broadcast data received. For now this is only updated from external. TODO: Move internally
+   boolean data_rx;                         //Broadcast data received. Set when a broadcast is routed to an added channel (see ANTPlus::add_channel())
    int state_counter; //Private for internal use only
+
+   //Per-channel counters -- these can be left out of an initialiser (zeroed)
+   byte          reset_generation;      //Private for internal use only
+   byte          commands_pending;      //Private for internal use only
+   unsigned int  error_count;           //!< Error responses and commands lost (retries used up or a reset) while this channel was being established
+   unsigned long broadcast_count;       //!< Broadcast/acknowledged/burst messages routed to this channel
+   unsigned long setup_start_ms;        //Private for internal use only
+   unsigned long acquisition_ms;        //!< Time from the start of setup to the first broadcast (0 until then)
+   byte          channel_state;         //!< ANT_CHANNEL_STATE. Read-only from external
+   unsigned long last_rx_ms;            //Private for internal use only
+   unsigned int  dropout_count;         //!< Times tracking was lost (EVENT_RX_FAIL_GO_TO_SEARCH) and then got back
+   unsigned long last_dropout_ms;       //!< Last broadcast before the loss to the first one after it, for the last dropout
+   unsigned long longest_dropout_ms;
+   unsigned int  reopen_count;          //!< Times the channel was reopened after the module closed it
+   unsigned int  paired_device_number;  //!< From MESG_CHANNEL_ID_ID, requested once the channel is tracking (0 until then)
+   byte          paired_transmission_type;
+   byte          pairing;               //Private for internal use only (ANT_PAIRING_*)
+
+   //! Optional setup script in PROGMEM (see ANTPlus_Script.h). If set it is sent instead of the built in sequence
+   //and the configuration items above (other than channel_number) are not used for setup.
+   const byte * setup_script;
+
+   //! Device to search for (the configuration items above were all in the first initialisers -- these can be left out).
+   //0 is a wildcard -- with a pairing cache (ANTPLUS_PAIRING) the device this type last paired with is searched for first.
+   unsigned int device_number;
+   byte         transmission_type;
 } ANT_Channel;
+
+#define ANT_PAIRING_CACHED       (0x01) //!< ANT_Channel::pairing -- searching for the device from the pairing cache
+#define ANT_PAIRING_ID_REQUESTED (0x02) //!< ANT_Channel::pairing -- MESG_CHANNEL_ID_ID requested since the channel was opened
+
+#include "ANTPlus_Profile.h"
  
 
 
+#if !defined(ANT_COMMAND_QUEUE_LEN)
+#define ANT_COMMAND_QUEUE_LEN (4) //!< Commands queued or awaiting a response (see ANTPlus::queue_command()). Each is ~26 bytes of SRAM on AVR.
+#endif
+
+#if !defined(ANT_RESPONSE_TIMEOUT_MS)
+#define ANT_RESPONSE_TIMEOUT_MS (100) //!< A sent command with no response after this long (and nothing left to read) is resent
+#endif
+
+#if !defined(ANT_COMMAND_RETRIES)
+#define ANT_COMMAND_RETRIES (2) //!< Resends of a command before the module is reset (MESG_SYSTEM_RESET_ID, then the reset line)
+#endif
+
+#if !defined(ANT_RTS_TIMEOUT_MS)
+#define ANT_RTS_TIMEOUT_MS (50) //!< No RTS pulse this long after a frame -- clear to send if the RTS pin reads low (the frame was lost or the edge missed)
+#endif
+
+#if !defined(ANT_RESET_TIMEOUT_MS)
+#define ANT_RESET_TIMEOUT_MS (500) //!< RTS held high this long (or no MESG_START_UP this long after a reset) -- the reset line is used
+#endif
+
+#define ANT_COMMAND_LOST (0xFF) //!< response_code for a command callback when the command was lost (retries used up or a reset)
+
+#define ANT_SETUP_COMPLETE_STATE (9) //!< state_counter once every setup command has been sent (see progress_setup_channel())
+
+//! Index into ANT_Packet::data for the BUFFER_INDEX_* (which count from the length byte) in antmessage.h
+#define ANT_PACKET_DATA_INDEX(buffer_index) ((buffer_index) - MESG_SAVED_FRAME_SIZE)
+
+typedef enum
+{
+  ANT_COMMAND_FREE,
+  ANT_COMMAND_QUEUED,
+  ANT_COMMAND_IN_FLIGHT, //!< Sent -- awaiting the response
+
+} ANT_COMMAND_STATE;
+
+//! How far a recovery has gone since the last response to a command. See ANTPlus::check_deadlines().
+typedef enum
+{
+  ANT_RECOVERY_NONE,           //!< Lost responses are resent
+  ANT_RECOVERY_SOFT_RESET,     //!< MESG_SYSTEM_RESET_ID was sent -- next is the reset line
+  ANT_RECOVERY_HARDWARE_RESET,
+
+} ANT_RECOVERY;
+
+struct ANT_Command_struct;
+//! Completion callback for a queued command.
+//response_code is RESPONSE_NO_ERROR, the code from a MESG_RESPONSE_EVENT_ID or ANT_COMMAND_LOST.
+//response is the packet that answered the command (NULL if no response was expected).
+typedef void (*ANT_CommandCallback)( const struct ANT_Command_struct * command, byte response_code, const ANT_Packet * response, void * context );
+
+//! A command in the queue. See ANTPlus::queue_command().
+typedef struct ANT_Command_struct
+{
+   byte frame[MESG_MAX_SIZE];   //!< Complete frame (laid out as an ANT_Packet) ready to write
+   byte response_msg_id;        //!< MESG_INVALID_ID if no response is expected
+   byte state;                  //!< ANT_COMMAND_STATE
+   unsigned int sequence;       //Private for internal use only (queue order)
+   ANT_CommandCallback callback;
+   void * context;
+   unsigned long sent_ms;       //Private for internal use only (response deadline and latency)
+   byte retries;                //Private for internal use only
+} ANT_Command;
+
+#define ANT_COMMAND_MSG_ID(/*ANT_Command * */ command)  ((command)->frame[MESG_HEADER_SIZE - 1])
+#define ANT_COMMAND_CHANNEL(/*ANT_Command * */ command) ((command)->frame[MESG_HEADER_SIZE]) //!< First data byte -- the channel for channel commands
+
 //! See readPacket().
 typedef enum
 {
   MESSAGE_READ_NONE, //No message available (immediately or after timeout period)
   MESSAGE_READ_ERROR_BAD_CHECKSUM,
-  MESSAGE_READ_ERROR_MISSING_SYNC,
+  MESSAGE_READ_ERROR_MISSING_SYNC,   //!< Bytes were skipped to find the next sync (reported once per read -- see syncDiscardCount())
   MESSAGE_READ_ERROR_PACKET_SIZE_EXCEEDED,
   MESSAGE_READ_INFO_TIMEOUT_MIDMESSAGE, //!< This might be recoverable on a subsequent call
   MESSAGE_READ_INTERNAL, //This is remapped to one of the next two in the internal read function
   MESSAGE_READ_OTHER,
-  MESSAGE_READ_EXPECTED
+  MESSAGE_READ_EXPECTED,
 
+  MESSAGE_READ_COUNT //!< Number of outcomes (not an outcome)
 } MESSAGE_READ;
 
+//! Called by readPackets() for each good packet (MESSAGE_READ_EXPECTED or MESSAGE_READ_OTHER).
+//packet is the internal frame buffer and is only valid during the call.
+typedef void (*ANT_PacketSink)( const ANT_Packet * packet, MESSAGE_READ outcome, void * context );
 
+//! Outcome counts from readPackets(). Indexed by MESSAGE_READ.
+typedef struct ANT_ReadCounts_struct
+{
+  unsigned int outcome[MESSAGE_READ_COUNT];
+} ANT_ReadCounts;
+
+//! State of the resumable frame parser. See readPacketInternal().
+typedef enum
+{
+  ANT_FRAMER_SYNC,     //!< Waiting for MESG_TX_SYNC
+  ANT_FRAMER_LENGTH,
+  ANT_FRAMER_ID,
+  ANT_FRAMER_PAYLOAD,
+  ANT_FRAMER_CHECKSUM,
+
+} ANT_FRAMER_STATE;
+
+#if defined(ANTPLUS_STATISTICS)
+#include "ANTPlus_Statistics.h"
+#endif /*defined(ANTPLUS_STATISTICS)*/
 
 
+
+class ANTCapture;
+class ANTPairingCache;
+
 //TODO: Look at ANT and ANT+ and work out the appropriate breakdown for a subclass/separate class
 class ANTPlus
 {
@@ -211,55 +402,198 @@ class ANTPlus
         byte SLEEP_PIN,
         byte RESET_PIN
     );
+    ~ANTPlus();
 
-    void     begin(Stream &serial);
+    void     begin(Stream &serial, boolean pump_serial_on_read = true);
     void     hardwareReset( );
+    //! Reset the module with MESG_SYSTEM_RESET_ID (sent once it is clear to send). Channels are set up again.
+    void     softReset( );
 
+    //! Send a typed message (see ANTPlus_Messages.h). Same rules as the variadic send().
+    template <class MESSAGE>
+    boolean send( const MESSAGE & message ) {return sendFrame( message.frame, MESSAGE::response_id );};
+    //DEPRECATED: Prefer the typed send() -- a wrong argCnt here is not caught
     boolean send(unsigned msgId, unsigned msgId_ResponseExpected, unsigned char argCnt, ...);
     MESSAGE_READ readPacket( ANT_Packet * packet, int packetSize, int wait_timeout );
+    //! Zero-copy read. *packet points at the internal frame buffer and is valid until the next read
+    MESSAGE_READ readPacket( const ANT_Packet ** packet, int wait_timeout = 0 );
+    //! Read every complete packet currently buffered (never waits). Returns the number of packets passed to sink.
+    unsigned int readPackets( ANT_PacketSink sink, void * context, ANT_ReadCounts * counts = NULL );
+
+    //! Move all available bytes from the Stream into the receive ring
+    void    pumpSerial();
+    //! Producer for the receive ring when called from a UART RX ISR (use begin() with pump_serial_on_read = false)
+    boolean receiveByte(byte value) {return rxRing.put(value);};
+    unsigned int rxRingOverruns()      {return rxRing.overruns();};
+    byte         rxRingHighWaterMark() {return rxRing.highWaterMark();};
     
     void         printPacket(const ANT_Packet * packet, boolean final_carriage_return);
 
     void sleep( boolean activate_sleep=true );
     void suspend(boolean activate_suspend=true );
     
-    //Callback from the main code
-    void   rTSHighAssertion();
+    //! RTS was seen going high. Never waits -- the next send goes once RTS is low again.
+    //Only needed when RTS is not on an interrupt pin or the sketch attaches its own RTS interrupt (replacing the library's):
+    //call it from that ISR or from loop(). Otherwise begin() attaches a FALLING interrupt on RTS_PIN and this is not needed.
+    void   rTSHighAssertion() {rtsRose = true;};
 
     boolean awaitingResponseLastSent() {return (msgResponseExpected != MESG_INVALID_ID);};
 
+    //! Time (in micros) from the sync byte to the checksum byte of the last frame read
+    unsigned long lastFrameAssemblyMicros() {return rxFrameAssemblyUs;};
+    //! Bytes thrown away while looking for a frame (noise and failed candidate frames)
+    unsigned long syncDiscardCount() {return rx_sync_discard_count;};
+
+#if defined(ANTPLUS_CAPTURE)
+    //! Record RX bytes, TX frames, read outcomes and RTS to capture (NULL to stop). See ANTPlus_Capture.h
+    void setCapture(ANTCapture * capture) {this->capture = capture;};
+#endif /*defined(ANTPLUS_CAPTURE)*/
+#if defined(ANTPLUS_PAIRING)
+    //! Remember the devices channels pair with and search for them first (NULL to stop). Set before the channels are set up.
+    void setPairingCache(ANTPairingCache * cache) {pairingCache = cache;};
+#endif /*defined(ANTPLUS_PAIRING)*/
+
+    //! Recent parser/TX/RTS/setup events (empty unless ANTPLUS_TRACE). dump() it when something goes wrong.
+    ANT_TraceRing & traceRing() {return trace;};
+
+#if defined(ANTPLUS_STATISTICS)
+    const ANTStatistics & statistics() {return stats;};
+    //! Zero the statistics (and the receive ring's overrun count and high water mark)
+    void  resetStatistics();
+    //! statistics() and the receive ring/sync counters as text
+    void  printStatistics(Print & out);
+#endif /*defined(ANTPLUS_STATISTICS)*/
+
     //!ANT+ to setup a channel
     ANT_CHANNEL_ESTABLISH progress_setup_channel( ANT_Channel * channel );
 
+    //Channel manager -- the ANT_Channel structs are owned by the caller and must stay in scope
+    boolean               add_channel( ANT_Channel * channel );
+    ANT_Channel *         get_channel( byte channel_number );
+    //! Progress setup of all added channels. Returns ANT_CHANNEL_ESTABLISH_COMPLETE once every channel is established.
+    ANT_CHANNEL_ESTABLISH progress_setup_channels();
+
+    //! Decode the data pages of channels of profile's device type into sink (see ANTPlus_Profile.h). Both must stay in scope.
+    //Returns false if ANT_PROFILE_MAX profiles have been added or one for the device type already has.
+    boolean               add_profile( const ANT_Profile * profile, const void * sink );
+
+    //Pipelined command queue
+    template <class MESSAGE>
+    boolean queue_command( const MESSAGE & message, ANT_CommandCallback callback = NULL, void * context = NULL )
+    {
+      return queue_frame( message.frame, MESSAGE::response_id, callback, context );
+    };
+    boolean queue_command( byte msgId, byte msgId_ResponseExpected, byte argCnt, const byte * args, ANT_CommandCallback callback = NULL, void * context = NULL );
+    byte    commands_pending();
+    void    service_commands();
+
 #if defined(ANTPLUS_MSG_STR_DECODE)
     static const char * get_msg_id_str(byte msg_id);
 #endif /*defined(ANTPLUS_MSG_STR_DECODE)*/
 
-    static int update_sdm_rollover( byte MessageValue, unsigned long int * Cumulative, byte * PreviousMessageValue );
+    //! One whole-unit SDM field. *PreviousMessageValue is -1 before the first message. See ANTSpeedDistance (ANTPlus_SpeedDistance.h) for the fractions.
+    static int update_sdm_rollover( byte MessageValue, unsigned long int * Cumulative, int * PreviousMessageValue );
 
   private:
-    MESSAGE_READ      readPacketInternal( ANT_Packet * packet, int packetSize, unsigned int readTimeout);
-    unsigned char     writeByte(unsigned char out, unsigned char chksum);
+    void              pollRts();
+    void              check_deadlines();
+    boolean           retry_command( ANT_Command * command );
+    void              recover();
+    void              module_state_lost();
+    static void       rtsFallingIsr();
+    MESSAGE_READ      readPacketInternal( unsigned int readTimeout );
+    boolean           rxBytesPending() {return (rxReplayPos < rxReplayEnd) || (rxRing.available() > 0);};
+    unsigned char     nextRxByte();
+    MESSAGE_READ      frameByte( unsigned char byteIn );
+    void              framerResync();
+    MESSAGE_READ      dispatchPacket( const ANT_Packet * packet );
+    static void       buildFrame( byte * frame, byte msgId, byte argCnt, const byte * args );
+    void              transmitFrame( const byte * frame );
+    boolean           sendFrame( const byte * frame, byte msgId_ResponseExpected );
+    boolean           queue_frame( const byte * frame, byte msgId_ResponseExpected, ANT_CommandCallback callback, void * context );
+
+    ANT_Command *     alloc_command( byte msgId_ResponseExpected, ANT_CommandCallback callback, void * context );
+    ANT_Command *     oldest_command( byte state, byte msg_id );
+    boolean           complete_command( const ANT_Packet * packet );
+    boolean           queue_setup_step( ANT_Channel * channel, int step );
+    boolean           queue_setup_script( ANT_Channel * channel );
+    template <class MESSAGE>
+    boolean           queue_setup_command( const MESSAGE & message, ANT_Channel * channel )
+    {
+      if( !queue_command( message, setup_command_done, channel ) )
+      {
+        return false;
+      }
+      channel->commands_pending++;
+      return true;
+    };
+    static void       setup_command_done( const ANT_Command * command, byte response_code, const ANT_Packet * response, void * context );
+    static void       reopen_done( const ANT_Command * command, byte response_code, const ANT_Packet * response, void * context );
+    void              channel_event( ANT_Channel * channel, byte event );
+    void              service_channels();
+    void              set_channel_state( ANT_Channel * channel, ANT_CHANNEL_STATE state );
+    unsigned int      search_device_number( ANT_Channel * channel, byte * transmission_type );
+    byte              search_timeout( const ANT_Channel * channel );
+    void              paired( const ANT_Packet * packet );
+    void              match_profile( const ANT_Channel * channel );
+    void              decode_page( const ANT_Channel * channel, const byte * page );
+    boolean           network_key_needed( int network_number );
+    void              network_key_sent( int network_number );
 
     static void serial_print_byte_padded_hex(byte value);
     static void serial_print_int_padded_dec(long int value, unsigned int width, boolean final_carriage_return = false);
 
   private:
     Stream* mySerial; //!< Serial -- Software serial or Hardware serial
+    boolean pumpOnRead; //!< Pump mySerial into rxRing from readPacket(). False if the ring is fed by receiveByte()/pumpSerial() elsewhere
+    ANTRingBuffer rxRing;
+#if defined(ANTPLUS_CAPTURE)
+    ANTCapture * capture;
+#endif /*defined(ANTPLUS_CAPTURE)*/
+#if defined(ANTPLUS_PAIRING)
+    ANTPairingCache * pairingCache;
+#endif /*defined(ANTPLUS_PAIRING)*/
+
+    ANT_TraceRing trace;
+#if defined(ANTPLUS_STATISTICS)
+    ANTStatistics stats;
+#endif /*defined(ANTPLUS_STATISTICS)*/
 
-  public: //TODO: Just temp (to eventually be removed -- or added to the interface properly)
-    long rx_packet_count;
-    long tx_packet_count;
-    long hw_reset_count;
-
-  private:
     unsigned msgResponseExpected; //TODO: This should be an enum.....
+    ANT_Command sent; //!< The last send() -- resent if msgResponseExpected does not arrive. sent_ms is also the time of the last reset while msgResponseExpected is MESG_START_UP
+    byte recoveryLevel; //!< ANT_RECOVERY
+    byte resetGeneration; //!< Bumped each time the module state is lost (see progress_setup_channel())
+    byte networkKeys; //!< Bit per network number (0..7) whose key has been sent since the module state was lost
     
-    volatile boolean clear_to_send;
+    boolean clear_to_send; //!< Only changed in the main loop (see pollRts())
+    unsigned long rtsWaitMs; //!< Last frame written (or reset) -- waiting for RTS since
+    volatile boolean rtsFell; //!< Set by rtsFallingIsr() -- the module is ready for the next message
+    volatile boolean rtsRose; //!< Set by rTSHighAssertion() -- ready once RTS reads low
+    static ANTPlus * rtsInstance; //!< The instance rtsFallingIsr() is for (the last begin())
     
+    //Partial frame state is carried across readPacket() calls
+    //A complete frame stays in rxBuf until the next read (see zero-copy readPacket())
+    ANT_FRAMER_STATE rxState;
+    unsigned char rxChksum;
+    unsigned long rxLastByteMs;
+    unsigned long rxFrameStartUs;
+    unsigned long rxFrameAssemblyUs;
+    unsigned long rx_sync_discard_count;
     int rxBufCnt;
+    int rxReplayPos; //!< rxBuf[rxReplayPos..rxReplayEnd) are bytes to re-scan after a failed candidate frame (see framerResync())
+    int rxReplayEnd;
     unsigned char rxBuf[ANT_MAX_PACKET_LEN];
 
+    ANT_Channel * channels[ANT_DEVICE_NUMBER_CHANNELS]; //!< Indexed by channel_number
+
+    const ANT_Profile * profiles[ANT_PROFILE_MAX];          //!< In PROGMEM. See add_profile().
+    const void *        profileSinks[ANT_PROFILE_MAX];
+    byte                profileCount;
+    byte                channelProfiles[ANT_DEVICE_NUMBER_CHANNELS]; //!< Index into profiles per channel_number (or ANT_PROFILE_NONE)
+
+    ANT_Command  commands[ANT_COMMAND_QUEUE_LEN];
+    unsigned int commandSequence;
+
     byte RTS_PIN;
     byte SUSPEND_PIN;
     byte SLEEP_PIN;
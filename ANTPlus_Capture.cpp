@@ -0,0 +1,362 @@
+//Copyright 2013 Brody Kenrick.
+//Recording ANT traffic to a compact binary capture and replaying it through a Stream. See ANTPlus_Capture.h
+
+#include "ANTPlus_Capture.h"
+
+#define ANT_CAPTURE_RX_GAP_US (2000) //!< A gap this long between RX bytes starts a new RX record (keeps the byte timing for replay)
+
+static const byte capture_magic[4] = {'A', 'N', 'T', 'C'};
+
+ANTCapture::ANTCapture()
+{
+  out = NULL;
+  last_us = 0;
+  rx_start_us = 0;
+  bytes_written = 0;
+  rx_count = 0;
+}
+
+void ANTCapture::begin(Print & out)
+{
+  this->out = &out;
+  rx_count = 0;
+  bytes_written = 0;
+  last_us = micros();
+  for (byte i = 0; i < sizeof(capture_magic); i++)
+  {
+    writeByte(capture_magic[i]);
+  }
+  writeByte(ANT_CAPTURE_VERSION);
+}
+
+void ANTCapture::end()
+{
+  flushRx();
+}
+
+void ANTCapture::writeByte(byte value)
+{
+  out->write(value);
+  bytes_written++;
+}
+
+//! Record flags and the time since the last record
+void ANTCapture::writeHeader(byte flags, unsigned long at_us)
+{
+  unsigned long delta = at_us - last_us;
+  last_us = at_us;
+  writeByte(flags);
+  while (delta >= 0x80)
+  {
+    writeByte((delta & 0x7F) | 0x80);
+    delta >>= 7;
+  }
+  writeByte(delta);
+}
+
+void ANTCapture::flushRx()
+{
+  if (rx_count == 0)
+  {
+    return;
+  }
+  writeHeader(ANT_CAPTURE_RECORD_RX_BYTES | rx_count, rx_start_us);
+  out->write(rx_stage, rx_count);
+  bytes_written += rx_count;
+  rx_count = 0;
+}
+
+void ANTCapture::rxByte(byte value)
+{
+  if (out == NULL)
+  {
+    return;
+  }
+  unsigned long now = micros();
+  if ((rx_count > 0) && ((now - rx_start_us) > ANT_CAPTURE_RX_GAP_US))
+  {
+    flushRx();
+  }
+  if (rx_count == 0)
+  {
+    rx_start_us = now;
+  }
+  rx_stage[rx_count++] = value;
+  if (rx_count == ANT_CAPTURE_RX_CHUNK)
+  {
+    flushRx();
+  }
+}
+
+void ANTCapture::txFrame(const byte * frame)
+{
+  if (out == NULL)
+  {
+    return;
+  }
+  flushRx();
+  writeHeader(ANT_CAPTURE_RECORD_TX_FRAME, micros());
+  byte size = frame[1] + MESG_FRAME_SIZE;
+  out->write(frame, size);
+  bytes_written += size;
+}
+
+void ANTCapture::readOutcome(MESSAGE_READ outcome)
+{
+  if (out == NULL)
+  {
+    return;
+  }
+  flushRx();
+  writeHeader(ANT_CAPTURE_RECORD_READ | outcome, micros());
+}
+
+void ANTCapture::rts()
+{
+  if (out == NULL)
+  {
+    return;
+  }
+  flushRx();
+  writeHeader(ANT_CAPTURE_RECORD_RTS, micros());
+}
+
+
+ANTCaptureReplay::ANTCaptureReplay()
+{
+  capture = NULL;
+  speed = 1;
+  start_us = 0;
+  record_us = 0;
+  loaded = false;
+  at_end = true;
+  record_flags = 0;
+  record_size = 0;
+  rx_pos = 0;
+  rx_end = 0;
+  rts_callback = NULL;
+  rts_context = NULL;
+  memset(&recorded_outcomes, 0, sizeof(recorded_outcomes));
+  recorded_tx_frames = 0;
+  recorded_tx_bytes = 0;
+  recorded_tx_hash = 0;
+  tx_bytes = 0;
+  tx_hash = 0;
+}
+
+boolean ANTCaptureReplay::begin(Stream & capture, unsigned int speed)
+{
+  this->capture = &capture;
+  this->speed = speed;
+  loaded = false;
+  at_end = true;
+  rx_pos = 0;
+  rx_end = 0;
+  record_us = 0;
+  memset(&recorded_outcomes, 0, sizeof(recorded_outcomes));
+  recorded_tx_frames = 0;
+  recorded_tx_bytes = 0;
+  recorded_tx_hash = 0;
+  tx_bytes = 0;
+  tx_hash = 0;
+
+  for (byte i = 0; i < sizeof(capture_magic); i++)
+  {
+    if (captureByte() != capture_magic[i])
+    {
+      return false;
+    }
+  }
+  if (captureByte() != ANT_CAPTURE_VERSION)
+  {
+    return false;
+  }
+  at_end = false;
+  start_us = micros();
+  return true;
+}
+
+int ANTCaptureReplay::captureByte()
+{
+  if (capture->available() <= 0)
+  {
+    return -1;
+  }
+  return capture->read();
+}
+
+boolean ANTCaptureReplay::readVarint(unsigned long * value)
+{
+  *value = 0;
+  for (byte shift = 0; shift < 35; shift += 7)
+  {
+    int next = captureByte();
+    if (next < 0)
+    {
+      return false;
+    }
+    *value |= (unsigned long) (next & 0x7F) << shift;
+    if ((next & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//! Read the next record into record[]. Sets at_end (and returns false) at the end of the capture or on a broken record.
+boolean ANTCaptureReplay::loadRecord()
+{
+  unsigned long delta;
+  int flags = captureByte();
+  if ((flags < 0) || !readVarint(&delta))
+  {
+    at_end = true;
+    return false;
+  }
+  record_flags = flags;
+  record_us += delta;
+
+  switch (record_flags & ANT_CAPTURE_RECORD_TYPE_MASK)
+  {
+    case ANT_CAPTURE_RECORD_RX_BYTES:
+      record_size = record_flags & ANT_CAPTURE_RECORD_ARG_MASK;
+      break;
+    case ANT_CAPTURE_RECORD_TX_FRAME:
+    {
+      //Sync and length first -- the length gives the rest
+      int sync = captureByte();
+      int length = captureByte();
+      if ((sync < 0) || (length < 0) || ((length + MESG_FRAME_SIZE) > ANT_CAPTURE_REPLAY_BUFFER))
+      {
+        at_end = true;
+        return false;
+      }
+      record[0] = sync;
+      record[1] = length;
+      record_size = length + MESG_FRAME_SIZE;
+      for (byte i = 2; i < record_size; i++)
+      {
+        int next = captureByte();
+        if (next < 0)
+        {
+          at_end = true;
+          return false;
+        }
+        record[i] = next;
+      }
+      loaded = true;
+      return true;
+    }
+    default:
+      record_size = 0;
+      break;
+  }
+
+  for (byte i = 0; i < record_size; i++)
+  {
+    int next = captureByte();
+    if (next < 0)
+    {
+      at_end = true;
+      return false;
+    }
+    record[i] = next;
+  }
+  loaded = true;
+  return true;
+}
+
+//! Fletcher-16
+void ANTCaptureReplay::hash(unsigned int * sum, byte value)
+{
+  unsigned int sum1 = *sum & 0xFF;
+  unsigned int sum2 = *sum >> 8;
+  sum1 = (sum1 + value) % 255;
+  sum2 = (sum2 + sum1) % 255;
+  *sum = (sum2 << 8) | sum1;
+}
+
+//! Use every record that is due. Stops at an RX record until its bytes have all been read.
+void ANTCaptureReplay::advance()
+{
+  while (rx_pos >= rx_end)
+  {
+    if (!loaded && (at_end || !loadRecord()))
+    {
+      return;
+    }
+    if ((speed != 0) && ((micros() - start_us) < (record_us / speed)))
+    {
+      return;
+    }
+    loaded = false;
+
+    switch (record_flags & ANT_CAPTURE_RECORD_TYPE_MASK)
+    {
+      case ANT_CAPTURE_RECORD_RX_BYTES:
+        rx_pos = 0;
+        rx_end = record_size;
+        break;
+      case ANT_CAPTURE_RECORD_TX_FRAME:
+        recorded_tx_frames++;
+        for (byte i = 0; i < record_size; i++)
+        {
+          recorded_tx_bytes++;
+          hash(&recorded_tx_hash, record[i]);
+        }
+        break;
+      case ANT_CAPTURE_RECORD_READ:
+        if ((record_flags & ANT_CAPTURE_RECORD_ARG_MASK) < MESSAGE_READ_COUNT)
+        {
+          recorded_outcomes.outcome[record_flags & ANT_CAPTURE_RECORD_ARG_MASK]++;
+        }
+        break;
+      case ANT_CAPTURE_RECORD_RTS:
+        if (rts_callback != NULL)
+        {
+          rts_callback(rts_context);
+        }
+        break;
+    }
+  }
+}
+
+boolean ANTCaptureReplay::finished()
+{
+  advance();
+  return at_end && !loaded && (rx_pos >= rx_end);
+}
+
+int ANTCaptureReplay::available()
+{
+  advance();
+  return rx_end - rx_pos;
+}
+
+int ANTCaptureReplay::read()
+{
+  advance();
+  if (rx_pos >= rx_end)
+  {
+    return -1;
+  }
+  return record[rx_pos++];
+}
+
+int ANTCaptureReplay::peek()
+{
+  advance();
+  if (rx_pos >= rx_end)
+  {
+    return -1;
+  }
+  return record[rx_pos];
+}
+
+size_t ANTCaptureReplay::write(uint8_t value)
+{
+  tx_bytes++;
+  hash(&tx_hash, value);
+  return 1;
+}
@@ -0,0 +1,143 @@
+//Copyright 2013 Brody Kenrick.
+//Recording ANT traffic to a compact binary capture and replaying it through a Stream
+
+//Capture format (all multi-byte values little endian)
+// Header : 'A' 'N' 'T' 'C' <version>
+// Record : <flags> <time delta> <payload>
+//  flags      : record type in the top 2 bits (ANT_CAPTURE_RECORD_*), the low 6 bits depend on the type
+//  time delta : micros() since the previous record as an unsigned varint (7 bits per byte, low bits first, top bit = more)
+//  payload    :
+//   RX_BYTES  -- low 6 bits of flags is the count (1..63), then the bytes as they came from the UART (noise included)
+//   TX_FRAME  -- the frame as written (sync, length, id, data, checksum). The size is from the length byte
+//   READ      -- no payload. Low 4 bits of flags is the MESSAGE_READ returned to the application
+//   RTS       -- no payload. The library saw the module was ready for the next message (clear to send)
+//A broadcast costs ~17 bytes (14 bytes plus ~2 for the time delta, and the READ record).
+//
+//Replaying RX_BYTES at their recorded times (ANTCaptureReplay) re-runs the frame parser on exactly what the radio gave us.
+
+#ifndef ANTPlus_Capture_h
+#define ANTPlus_Capture_h
+
+#include <Arduino.h>
+#include <Stream.h>
+
+#include "ANTPlus.h"
+
+#define ANT_CAPTURE_VERSION (1)
+
+#define ANT_CAPTURE_RECORD_RX_BYTES (0x00)
+#define ANT_CAPTURE_RECORD_TX_FRAME (0x40)
+#define ANT_CAPTURE_RECORD_READ     (0x80)
+#define ANT_CAPTURE_RECORD_RTS      (0xC0)
+#define ANT_CAPTURE_RECORD_TYPE_MASK (0xC0)
+#define ANT_CAPTURE_RECORD_ARG_MASK  (0x3F)
+
+#if !defined(ANT_CAPTURE_RX_CHUNK)
+#define ANT_CAPTURE_RX_CHUNK (16) //!< RX bytes staged before they are written as one record. At most 63.
+#endif
+
+#if (ANT_CAPTURE_RX_CHUNK > ANT_CAPTURE_RECORD_ARG_MASK) || (ANT_CAPTURE_RX_CHUNK < 1)
+#error "ANT_CAPTURE_RX_CHUNK must be 1..63"
+#endif
+
+#define ANT_CAPTURE_REPLAY_BUFFER (63) //!< Largest record payload (RX_BYTES with a count of 63)
+
+ANT_STATIC_ASSERT(MESSAGE_READ_COUNT <= 16, message_read_fits_in_the_read_record);
+ANT_STATIC_ASSERT(MESG_MAX_SIZE <= ANT_CAPTURE_REPLAY_BUFFER, tx_frame_fits_in_the_replay_buffer);
+
+//! Streaming capture writer. Attach with ANTPlus::setCapture() (needs ANTPLUS_CAPTURE).
+//Records go straight to the Print (e.g. an SD File or a spare hardware serial) -- only ANT_CAPTURE_RX_CHUNK bytes are held in RAM.
+//NOTE: The Print is written from readPacket()/send() -- keep it fast (buffered) or the UART may overrun while it writes.
+class ANTCapture
+{
+  public:
+    ANTCapture();
+
+    //! Writes the header
+    void begin(Print & out);
+    //! Writes out any staged RX bytes. Call before closing the Print.
+    void end();
+
+    void rxByte(byte value);
+    void txFrame(const byte * frame);
+    void readOutcome(MESSAGE_READ outcome);
+    void rts();
+
+    unsigned long bytesWritten() {return bytes_written;};
+
+  private:
+    void flushRx();
+    void writeHeader(byte flags, unsigned long at_us);
+    void writeByte(byte value);
+
+    Print *       out;
+    unsigned long last_us;
+    unsigned long rx_start_us;
+    unsigned long bytes_written;
+    byte          rx_count;
+    byte          rx_stage[ANT_CAPTURE_RX_CHUNK];
+};
+
+//! Feeds a capture back in as the module's Stream (pass it to ANTPlus::begin()).
+//RX bytes become available at their recorded time (scaled by speed) and stay available until read.
+//TX writes from the library are checked against the recorded TX frames (see txMatches()).
+//RTS records call the RTS callback at their time (from inside available()/read()) -- it should call ANTPlus::rTSHighAssertion().
+//The library then sends on its next call, as it did when it recorded. Call available() at the top of the loop so that is
+//the same call as in the recording (on hardware the RTS interrupt fires while the loop is busy).
+//Only one record is held in RAM, so the capture can be read straight from an SD File.
+class ANTCaptureReplay : public Stream
+{
+  public:
+    ANTCaptureReplay();
+
+    //! speed: 1 = as recorded, N = N times faster, 0 = no waiting (each record is due as soon as the last is used up)
+    //Returns false if capture does not start with a header this version can read
+    boolean begin(Stream & capture, unsigned int speed = 1);
+    void    setRtsCallback(void (*callback)(void * context), void * context) {rts_callback = callback; rts_context = context;};
+
+    //! Every record has been used
+    boolean finished();
+    //! Outcomes recorded in READ records so far (compare with what the library returns on replay)
+    const ANT_ReadCounts & recordedOutcomes() {return recorded_outcomes;};
+    //! TX written during replay is the same as the TX recorded (so far)
+    boolean txMatches() {return (tx_bytes == recorded_tx_bytes) && (tx_hash == recorded_tx_hash);};
+    unsigned long txFrames() {return recorded_tx_frames;};
+
+    int    available();
+    int    read();
+    int    peek();
+    void   flush() {};
+    size_t write(uint8_t value);
+    using Print::write;
+
+  private:
+    void    advance();
+    boolean loadRecord();
+    boolean readVarint(unsigned long * value);
+    int     captureByte();
+    static void hash(unsigned int * sum, byte value);
+
+    Stream *      capture;
+    unsigned int  speed;
+    unsigned long start_us;
+    unsigned long record_us;   //!< Recorded time of the loaded record
+    boolean       loaded;
+    boolean       at_end;
+    byte          record_flags;
+    byte          record_size;
+    byte          record[ANT_CAPTURE_REPLAY_BUFFER];
+    byte          rx_pos;      //!< Next RX byte in record (when an RX_BYTES record is being read out)
+    byte          rx_end;
+
+    void (*rts_callback)(void * context);
+    void *        rts_context;
+
+    ANT_ReadCounts recorded_outcomes;
+    unsigned long  recorded_tx_frames;
+    unsigned long  recorded_tx_bytes;
+    unsigned int   recorded_tx_hash;
+    unsigned long  tx_bytes;
+    unsigned int   tx_hash;
+};
+
+#endif //ANTPlus_Capture_h
@@ -0,0 +1,219 @@
+//Copyright 2013 Brody Kenrick.
+//Heart rate monitor decoding. See ANTPlus_HeartRate.h
+
+#include "ANTPlus.h"
+#include "ANTPlus_HeartRate.h"
+
+ANT_STATIC_ASSERT(sizeof(ANT_HRMDataPage) == 8, hrm_page_is_8_bytes);
+ANT_STATIC_ASSERT(ANT_HRM_MAX_RR <= ANT_HRM_RR_VALUE_MASK, rr_fits_in_a_ring_entry);
+
+#define ANT_HRM_LE16(bytes) ((bytes)[0] | ((unsigned int) (bytes)[1] << 8))
+
+//Offsets in the page (the layout of ANT_HRMDataPage). Read as bytes -- the order of bit fields is up to the compiler.
+#define ANT_HRM_BEAT_TIME  (4) //!< 1/1024 s, 2 bytes
+#define ANT_HRM_BEAT_COUNT (6)
+#define ANT_HRM_HEART_RATE (7)
+
+ANTHeartRate::ANTHeartRate()
+{
+  hrmSink.heart_rate = NULL;
+  hrmSink.page = pageSink;
+  hrmSink.context = this;
+  reset();
+}
+
+void ANTHeartRate::reset()
+{
+  first_seen = false;
+  toggle_seen = false;
+  last_toggle = 0;
+  last_count = 0;
+  last_time = 0;
+  new_run = true;
+  heart_rate = 0;
+  beat_total = 0;
+  missed_beats = 0;
+  rr_head = 0;
+  rr_count = 0;
+  rr_total = 0;
+  rr_pairs = 0;
+  sum_squares = 0;
+  operating_time = 0;
+  manufacturer_id = 0;
+  serial_number = 0;
+  hardware_version = 0;
+  software_version = 0;
+  model_number = 0;
+}
+
+void ANTHeartRate::pageSink( const ANT_Channel * /*channel*/, const ANT_HRMDataPage * page, void * context )
+{
+  ((ANTHeartRate *) context)->update( (const byte *) page );
+}
+
+byte ANTHeartRate::update( const byte * page )
+{
+  heart_rate = page[ANT_HRM_HEART_RATE];
+
+  byte toggle = page[0] >> 7;
+  byte page_number = page[0] & 0x7F;
+  if( first_seen && (toggle != last_toggle) )
+  {
+    toggle_seen = true;
+  }
+  last_toggle = toggle;
+  if( toggle_seen )
+  {
+    switch( page_number )
+    {
+      case DATA_PAGE_HEART_RATE_1:
+        operating_time = 2UL * (page[1] | ((unsigned long) page[2] << 8) | ((unsigned long) page[3] << 16));
+        break;
+      case DATA_PAGE_HEART_RATE_2:
+        manufacturer_id = page[1];
+        serial_number = ANT_HRM_LE16( &page[2] );
+        break;
+      case DATA_PAGE_HEART_RATE_3:
+        hardware_version = page[1];
+        software_version = page[2];
+        model_number = page[3];
+        break;
+    }
+  }
+
+  unsigned int beat_time = ANT_HRM_LE16( &page[ANT_HRM_BEAT_TIME] );
+  byte beat_count = page[ANT_HRM_BEAT_COUNT];
+  if( !first_seen )
+  {
+    first_seen = true;
+    last_count = beat_count;
+    last_time = beat_time;
+    return 0;
+  }
+  byte new_beats = beat_count - last_count;
+  if( new_beats == 0 )
+  {
+    //Same beat as the last page
+    return 0;
+  }
+  unsigned int span = (uint16_t) (beat_time - last_time); //Both roll over at 16 bits (unsigned int is wider off AVR)
+  last_count = beat_count;
+  last_time = beat_time;
+  beat_total += new_beats;
+  missed_beats += new_beats - 1;
+
+  //The last interval is known exactly from page 4 -- only the ones before it (if any) are made up
+  unsigned int last_rr = span;
+  byte         made_up = new_beats - 1;
+  boolean      measured = (made_up == 0);
+  if( toggle_seen && (page_number == DATA_PAGE_HEART_RATE_4) )
+  {
+    last_rr = (uint16_t) (beat_time - ANT_HRM_LE16( &page[2] )); //Previous heart beat event time
+    measured = true;
+  }
+  else if( made_up > 0 )
+  {
+    last_rr = span / new_beats;
+  }
+  if( (new_beats > ANT_HRM_MAX_MISSED_BEATS) || (last_rr < ANT_HRM_MIN_RR) || (last_rr > ANT_HRM_MAX_RR) ||
+      (last_rr > span) || ((made_up > 0) && ((span - last_rr) < (made_up * (unsigned int) ANT_HRM_MIN_RR))) ||
+      ((span - last_rr) > (made_up * (unsigned int) ANT_HRM_MAX_RR)) )
+  {
+    //Can't say when the beats were -- start again from this one
+    new_run = true;
+    return new_beats;
+  }
+
+  //Shared evenly over the missed beats (the first ones get the remainder so they add up)
+  unsigned int missed_span = span - last_rr;
+  for( byte i = 0; i < made_up; i++ )
+  {
+    unsigned int rr = (missed_span / made_up) + ((i < (missed_span % made_up)) ? 1 : 0);
+    addInterval( rr | ANT_HRM_RR_RECONSTRUCTED );
+  }
+  addInterval( measured ? last_rr : (last_rr | ANT_HRM_RR_RECONSTRUCTED) );
+  return new_beats;
+}
+
+//! A successive pair counted in the RMSSD -- both received and no gap between them
+boolean ANTHeartRate::paired( unsigned int older, unsigned int newer )
+{
+  return ((older & ANT_HRM_RR_RECONSTRUCTED) == 0) && ((newer & (ANT_HRM_RR_RECONSTRUCTED | ANT_HRM_RR_NEW_RUN)) == 0);
+}
+
+static unsigned long square_difference( unsigned int a, unsigned int b )
+{
+  long difference = (long) (a & ANT_HRM_RR_VALUE_MASK) - (long) (b & ANT_HRM_RR_VALUE_MASK);
+  return (unsigned long) (difference * difference);
+}
+
+//! Add to the ring and keep sum_squares/rr_pairs up to date -- the pair leaving (if the ring is full) and the new pair
+void ANTHeartRate::addInterval( unsigned int entry )
+{
+  if( new_run )
+  {
+    entry |= ANT_HRM_RR_NEW_RUN;
+    new_run = false;
+  }
+  if( rr_count == ANT_HRM_RR_RING_SIZE )
+  {
+    unsigned int oldest = rr_ring[rr_head & (ANT_HRM_RR_RING_SIZE - 1)];
+    unsigned int next = rr_ring[(byte) (rr_head + 1) & (ANT_HRM_RR_RING_SIZE - 1)];
+    if( paired( oldest, next ) )
+    {
+      sum_squares -= square_difference( next, oldest );
+      rr_pairs--;
+    }
+  }
+  if( rr_count > 0 )
+  {
+    unsigned int previous = rrEntry( 0 );
+    if( paired( previous, entry ) )
+    {
+      sum_squares += square_difference( entry, previous );
+      rr_pairs++;
+    }
+  }
+  if( rr_count < ANT_HRM_RR_RING_SIZE )
+  {
+    rr_count++;
+  }
+  rr_ring[rr_head & (ANT_HRM_RR_RING_SIZE - 1)] = entry;
+  rr_head++;
+  rr_total++;
+}
+
+//! Integer square root -- 16 steps whatever the value
+static unsigned int square_root( unsigned long value )
+{
+  unsigned long root = 0;
+  unsigned long bit = 1UL << 30;
+  while( bit > 0 )
+  {
+    if( value >= (root + bit) )
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (unsigned int) root;
+}
+
+unsigned int ANTHeartRate::rmssd() const
+{
+  if( rr_pairs == 0 )
+  {
+    return 0;
+  }
+  //Mean square in (1/1024 s)^2 to ms^2: * 1000^2 / 1024^2 = * 15625 / 16384
+  unsigned long mean_square = sum_squares / rr_pairs;
+  mean_square -= (mean_square * 759UL) / 16384UL;
+  //Rounded to the nearest ms
+  unsigned int root = square_root( mean_square );
+  return ((mean_square - ((unsigned long) root * root)) > root) ? (root + 1) : root;
+}
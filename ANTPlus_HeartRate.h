@@ -0,0 +1,112 @@
+//Copyright 2013 Brody Kenrick.
+//Heart rate monitor decoding -- beat timing, R-R intervals and RMSSD from the HRM data pages
+
+//Feed it the pages of one HRM channel, from the profile:
+//
+//  static ANTHeartRate hrm;
+//  ...
+//  antplus.add_profile( &ant_profile_hrm, hrm.sink() );
+//
+//or from a sink of your own (ANT_HRMSink::page) with update().
+//
+//Every page has the time of the last heart beat event (1/1024 s, rolls over at 64 s) and a count of beats (rolls over at 256).
+//Each new beat gives an R-R interval -- the time since the one before. Beats that came and went between the pages that were
+//received (the count went up by more than 1) are put back in: with page 4 (the time of the beat before the last is on it) only
+//the intervals before that one are unknown. Those are shared evenly over the time they took and marked as reconstructed.
+//After a gap too long to tell how many beats there were (ANT_HRM_MAX_MISSED_BEATS, or intervals outside ANT_HRM_MIN_RR..ANT_HRM_MAX_RR)
+//the beats are counted but no intervals are made up for them.
+//
+//The last ANT_HRM_RR_RING_SIZE intervals are kept (rr()). RMSSD -- the root mean square of the differences between successive
+//intervals -- is over the pairs of received (not reconstructed) successive intervals among them, kept up to date as each is added.
+//
+//Straps that do not toggle bit 7 of the page number (legacy, page 0 only) have nothing in bytes 1-3 -- the background pages
+//(1-3) and page 4 are only used once the toggle has been seen to change.
+
+#ifndef ANTPlus_HeartRate_h
+#define ANTPlus_HeartRate_h
+
+#include <Arduino.h>
+
+#include "ANTPlus.h"
+
+#if !defined(ANT_HRM_RR_RING_SIZE)
+#define ANT_HRM_RR_RING_SIZE (16) //!< R-R intervals kept (2 bytes each). Power of two, 2..128. RMSSD is over up to one less pair than this.
+#endif
+
+#if ((ANT_HRM_RR_RING_SIZE & (ANT_HRM_RR_RING_SIZE - 1)) != 0) || (ANT_HRM_RR_RING_SIZE < 2) || (ANT_HRM_RR_RING_SIZE > 128)
+#error "ANT_HRM_RR_RING_SIZE must be a power of two, 2..128"
+#endif
+
+#if !defined(ANT_HRM_MAX_MISSED_BEATS)
+#define ANT_HRM_MAX_MISSED_BEATS (8) //!< More beats than this between two pages are counted but not reconstructed
+#endif
+
+#define ANT_HRM_MIN_RR (256)  //!< Shortest R-R interval believed (1/1024 s) -- 240 bpm
+#define ANT_HRM_MAX_RR (2048) //!< Longest R-R interval believed (1/1024 s) -- 30 bpm
+
+#define ANT_HRM_RR_RECONSTRUCTED (0x8000) //!< R-R ring entry -- made up for a missed beat
+#define ANT_HRM_RR_NEW_RUN       (0x4000) //!< R-R ring entry -- first after a gap (not differenced with the one before it)
+#define ANT_HRM_RR_VALUE_MASK    (0x0FFF)
+
+class ANTHeartRate
+{
+  public:
+    ANTHeartRate();
+    //! Forget everything (e.g. a different strap)
+    void reset();
+
+    //! Decode one page (the 8 bytes of an ANT_HRMDataPage). Returns the number of new beats (including missed ones).
+    byte update( const byte * page );
+    //! Sink for ANTPlus::add_profile() with ant_profile_hrm that calls update()
+    const ANT_HRMSink * sink() const {return &hrmSink;};
+
+    byte          heartRate() const {return heart_rate;};   //!< Computed by the strap. 0 is invalid.
+    unsigned long beats() const {return beat_total;};        //!< Since the first page (or reset())
+    unsigned int  missedBeats() const {return missed_beats;}; //!< Beats between the pages received (included in beats())
+    boolean       toggling() const {return toggle_seen;};     //!< Not a legacy strap -- bytes 1-3 and the background pages are used
+
+    //! R-R intervals in the ring (up to ANT_HRM_RR_RING_SIZE)
+    byte          rrCount() const {return rr_count;};
+    //! R-R intervals added since reset() -- the difference from the last call is how many of rr() are new
+    unsigned long intervals() const {return rr_total;};
+    //! R-R interval in 1/1024 s. age 0 is the latest.
+    unsigned int  rr( byte age ) const {return rrEntry(age) & ANT_HRM_RR_VALUE_MASK;};
+    boolean       rrReconstructed( byte age ) const {return (rrEntry(age) & ANT_HRM_RR_RECONSTRUCTED) != 0;};
+    //! RMSSD in ms over the successive pairs in the ring (0 until there is one)
+    unsigned int  rmssd() const;
+    byte          rmssdPairs() const {return rr_pairs;};
+
+    //Background pages -- 0 until seen
+    unsigned long operating_time;   //!< Cumulative operating time in s (page 1)
+    byte          manufacturer_id;  //!< Page 2
+    unsigned int  serial_number;    //!< Upper 16 bits (page 2)
+    byte          hardware_version; //!< Page 3
+    byte          software_version;
+    byte          model_number;
+
+  private:
+    unsigned int rrEntry( byte age ) const {return rr_ring[(byte) (rr_head - 1 - age) & (ANT_HRM_RR_RING_SIZE - 1)];};
+    void         addInterval( unsigned int entry );
+    static boolean paired( unsigned int older, unsigned int newer );
+    static void  pageSink( const ANT_Channel * channel, const ANT_HRMDataPage * page, void * context );
+
+    ANT_HRMSink   hrmSink;
+    boolean       first_seen;
+    boolean       toggle_seen;
+    byte          last_toggle;
+    byte          last_count;
+    unsigned int  last_time;
+    boolean       new_run;          //!< The next interval starts a run
+    byte          heart_rate;
+    unsigned long beat_total;
+    unsigned int  missed_beats;
+
+    unsigned int  rr_ring[ANT_HRM_RR_RING_SIZE];
+    byte          rr_head;          //!< Free-running -- next slot to write
+    byte          rr_count;
+    unsigned long rr_total;
+    byte          rr_pairs;         //!< Successive pairs in sum_squares
+    unsigned long sum_squares;      //!< Of the differences of the successive pairs in the ring (1/1024 s squared)
+};
+
+#endif //ANTPlus_HeartRate_h
@@ -0,0 +1,211 @@
+//Copyright 2013 Brody Kenrick.
+//Typed encoders for the ANT messages used by ANTPlus (see antmessage.h)
+
+//Each message is a type with the data size taken from its MESG_*_SIZE constant.
+//The constructor takes exactly the fields of that message so a wrong number of
+//arguments is a compile error (not a corrupt frame as with the variadic ANTPlus::send()).
+//The frame is built in place (sync, length, id, data, checksum) ready to be written out.
+//The header part of the checksum is a compile time constant. When the fields are
+//constants too (e.g. ANT_SystemReset) the whole frame folds to constants.
+
+#ifndef ANTPlus_Messages_h
+#define ANTPlus_Messages_h
+
+#include <Arduino.h>
+
+#include "antdefines.h"
+#include "antmessage.h"
+
+#if (__cplusplus >= 201103L)
+#define ANT_STATIC_ASSERT(condition, message) static_assert((condition), #message)
+#else
+#define ANT_STATIC_ASSERT(condition, message) typedef char ANT_STATIC_ASSERT_##message[(condition) ? 1 : -1] __attribute__((unused))
+#endif
+
+//! A complete frame for message MSG_ID carrying SIZE data bytes. RESPONSE_ID is what the module answers with.
+template <byte MSG_ID, byte SIZE, byte RESPONSE_ID>
+class ANT_Message
+{
+  public:
+    enum
+    {
+      msg_id          = MSG_ID,
+      size            = SIZE,
+      response_id     = RESPONSE_ID,
+      frame_size      = SIZE + MESG_FRAME_SIZE,
+      header_checksum = MESG_TX_SYNC ^ SIZE ^ MSG_ID,
+    };
+
+    ANT_STATIC_ASSERT( SIZE <= MESG_MAX_DATA_SIZE, message_too_large );
+
+    byte frame[SIZE + MESG_FRAME_SIZE];
+
+  protected:
+    ANT_Message()
+    {
+      frame[0] = MESG_TX_SYNC;
+      frame[1] = SIZE;
+      frame[2] = MSG_ID;
+    };
+
+    //! Set data byte INDEX. An index outside the message is a compile error.
+    template <byte INDEX>
+    void set( byte value )
+    {
+      ANT_STATIC_ASSERT( INDEX < SIZE, data_index_outside_message );
+      frame[MESG_HEADER_SIZE + INDEX] = value;
+    };
+
+    //! Must be called last by each message constructor
+    void seal()
+    {
+      byte chksum = header_checksum;
+      for(byte i = 0; i < SIZE; i++)
+      {
+        chksum ^= frame[MESG_HEADER_SIZE + i];
+      }
+      frame[MESG_HEADER_SIZE + SIZE] = chksum;
+    };
+};
+
+//! Request message REQUESTED_ID (e.g. MESG_CAPABILITIES_ID, MESG_CHANNEL_ID_ID) from the module
+template <byte REQUESTED_ID>
+class ANT_Request : public ANT_Message<MESG_REQUEST_ID, MESG_REQUEST_SIZE, REQUESTED_ID>
+{
+  public:
+    explicit ANT_Request( byte channel )
+    {
+      this->template set<0>( channel );
+      this->template set<1>( REQUESTED_ID );
+      this->seal();
+    };
+};
+
+class ANT_SystemReset : public ANT_Message<MESG_SYSTEM_RESET_ID, MESG_SYSTEM_RESET_SIZE, MESG_START_UP>
+{
+  public:
+    ANT_SystemReset()
+    {
+      set<0>( 0 );
+      seal();
+    };
+};
+
+class ANT_AssignChannel : public ANT_Message<MESG_ASSIGN_CHANNEL_ID, MESG_ASSIGN_CHANNEL_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    ANT_AssignChannel( byte channel, byte channel_type, byte network )
+    {
+      set<0>( channel );
+      set<1>( channel_type );
+      set<2>( network );
+      seal();
+    };
+};
+
+class ANT_UnassignChannel : public ANT_Message<MESG_UNASSIGN_CHANNEL_ID, MESG_UNASSIGN_CHANNEL_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    explicit ANT_UnassignChannel( byte channel )
+    {
+      set<0>( channel );
+      seal();
+    };
+};
+
+//! device_number 0, transmission_type 0 (and no pairing bit in device_type) is a wildcard search
+class ANT_ChannelId : public ANT_Message<MESG_CHANNEL_ID_ID, MESG_CHANNEL_ID_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    ANT_ChannelId( byte channel, unsigned int device_number, byte device_type, byte transmission_type )
+    {
+      set<0>( channel );
+      set<1>( LOW_BYTE(device_number) );
+      set<2>( HIGH_BYTE(device_number) );
+      set<3>( device_type );
+      set<4>( transmission_type );
+      seal();
+    };
+};
+
+//! key is 8 bytes
+class ANT_NetworkKey : public ANT_Message<MESG_NETWORK_KEY_ID, MESG_NETWORK_KEY_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    ANT_NetworkKey( byte network, const byte * key )
+    {
+      set<0>( network );
+      memcpy( &frame[MESG_HEADER_SIZE + 1], key, MESG_NETWORK_KEY_SIZE - 1 );
+      seal();
+    };
+};
+
+//! timeout is in 2.5 second steps
+class ANT_ChannelSearchTimeout : public ANT_Message<MESG_CHANNEL_SEARCH_TIMEOUT_ID, MESG_CHANNEL_SEARCH_TIMEOUT_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    ANT_ChannelSearchTimeout( byte channel, byte timeout )
+    {
+      set<0>( channel );
+      set<1>( timeout );
+      seal();
+    };
+};
+
+//! Frequency = 2400 MHz + (freq * 1 MHz)
+class ANT_ChannelRadioFreq : public ANT_Message<MESG_CHANNEL_RADIO_FREQ_ID, MESG_CHANNEL_RADIO_FREQ_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    ANT_ChannelRadioFreq( byte channel, byte freq )
+    {
+      set<0>( channel );
+      set<1>( freq );
+      seal();
+    };
+};
+
+//! period is in 1/32768 seconds
+class ANT_ChannelPeriod : public ANT_Message<MESG_CHANNEL_MESG_PERIOD_ID, MESG_CHANNEL_MESG_PERIOD_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    ANT_ChannelPeriod( byte channel, unsigned int period )
+    {
+      set<0>( channel );
+      set<1>( LOW_BYTE(period) );
+      set<2>( HIGH_BYTE(period) );
+      seal();
+    };
+};
+
+class ANT_RadioTxPower : public ANT_Message<MESG_RADIO_TX_POWER_ID, MESG_RADIO_TX_POWER_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    explicit ANT_RadioTxPower( byte power )
+    {
+      set<0>( 0 );
+      set<1>( power );
+      seal();
+    };
+};
+
+class ANT_OpenChannel : public ANT_Message<MESG_OPEN_CHANNEL_ID, MESG_OPEN_CHANNEL_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    explicit ANT_OpenChannel( byte channel )
+    {
+      set<0>( channel );
+      seal();
+    };
+};
+
+class ANT_CloseChannel : public ANT_Message<MESG_CLOSE_CHANNEL_ID, MESG_CLOSE_CHANNEL_SIZE, MESG_RESPONSE_EVENT_ID>
+{
+  public:
+    explicit ANT_CloseChannel( byte channel )
+    {
+      set<0>( channel );
+      seal();
+    };
+};
+
+#endif //ANTPlus_Messages_h
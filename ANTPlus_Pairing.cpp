@@ -0,0 +1,130 @@
+//Copyright 2013 Brody Kenrick.
+//Cache of paired devices. See ANTPlus_Pairing.h
+
+#include "ANTPlus.h"
+
+#if defined(ANTPLUS_PAIRING)
+
+#include "ANTPlus_Pairing.h"
+
+ANTPairingCache::ANTPairingCache()
+{
+  store = NULL;
+  clear();
+}
+
+void ANTPairingCache::clear()
+{
+  memset(devices, 0, sizeof(devices));
+}
+
+boolean ANTPairingCache::begin(ANTPairingStore & store)
+{
+  this->store = &store;
+  clear();
+
+  byte data[ANT_PAIRING_STORE_SIZE];
+  if (!store.load(data, sizeof(data)))
+  {
+    return false;
+  }
+  byte chksum = 0;
+  for (byte i = 0; i < (sizeof(data) - 1); i++)
+  {
+    chksum ^= data[i];
+  }
+  if ((data[0] != 'P') || (data[1] != ANT_PAIRING_VERSION) || (data[2] > ANT_PAIRING_CACHE_SIZE) || (chksum != data[sizeof(data) - 1]))
+  {
+    return false;
+  }
+  for (byte i = 0; i < data[2]; i++)
+  {
+    const byte * device = &data[3 + (4 * i)];
+    devices[i].device_number = device[0] | (device[1] << 8);
+    devices[i].device_type = device[2];
+    devices[i].transmission_type = device[3];
+  }
+  return true;
+}
+
+byte ANTPairingCache::size() const
+{
+  byte count = 0;
+  while ((count < ANT_PAIRING_CACHE_SIZE) && (devices[count].device_type != 0))
+  {
+    count++;
+  }
+  return count;
+}
+
+const ANT_PairedDevice * ANTPairingCache::find(byte device_type) const
+{
+  for (byte i = 0; (i < ANT_PAIRING_CACHE_SIZE) && (devices[i].device_type != 0); i++)
+  {
+    if (devices[i].device_type == device_type)
+    {
+      return &devices[i];
+    }
+  }
+  return NULL;
+}
+
+void ANTPairingCache::remember(byte device_type, unsigned int device_number, byte transmission_type)
+{
+  if ((device_type == 0) || (device_number == 0))
+  {
+    //Wildcard -- not a device
+    return;
+  }
+  //Where it is now, or the least recently used (last) slot if it is new
+  byte index = 0;
+  while ((index < (ANT_PAIRING_CACHE_SIZE - 1)) && (devices[index].device_type != 0) &&
+         ((devices[index].device_type != device_type) || (devices[index].device_number != device_number)))
+  {
+    index++;
+  }
+  if ((index == 0) && (devices[0].device_type == device_type) && (devices[0].device_number == device_number) &&
+      (devices[0].transmission_type == transmission_type))
+  {
+    //Already the most recent -- nothing to write
+    return;
+  }
+  for (byte i = index; i > 0; i--)
+  {
+    devices[i] = devices[i - 1];
+  }
+  devices[0].device_number = device_number;
+  devices[0].device_type = device_type;
+  devices[0].transmission_type = transmission_type;
+  save();
+}
+
+void ANTPairingCache::save()
+{
+  if (store == NULL)
+  {
+    return;
+  }
+  byte data[ANT_PAIRING_STORE_SIZE];
+  memset(data, 0, sizeof(data));
+  data[0] = 'P';
+  data[1] = ANT_PAIRING_VERSION;
+  data[2] = size();
+  for (byte i = 0; i < data[2]; i++)
+  {
+    byte * device = &data[3 + (4 * i)];
+    device[0] = LOW_BYTE(devices[i].device_number);
+    device[1] = HIGH_BYTE(devices[i].device_number);
+    device[2] = devices[i].device_type;
+    device[3] = devices[i].transmission_type;
+  }
+  byte chksum = 0;
+  for (byte i = 0; i < (sizeof(data) - 1); i++)
+  {
+    chksum ^= data[i];
+  }
+  data[sizeof(data) - 1] = chksum;
+  store->save(data, sizeof(data));
+}
+
+#endif /*defined(ANTPLUS_PAIRING)*/
@@ -0,0 +1,80 @@
+//Copyright 2013 Brody Kenrick.
+//Remembering the devices channels have paired with so the next search is for that device rather than a wildcard (ANTPLUS_PAIRING)
+
+//A channel set up with a wildcard device number (ANT_Channel::device_number 0) pairs with whichever device of its type the
+//module hears first -- in a gym full of straps that may not be yours. Once a channel is tracking the library asks the module
+//for the channel id it paired with (ANT_Channel::paired_device_number) and, with a cache attached (ANTPlus::setPairingCache()),
+//remembers it. The next setup of a channel of that device type searches for that device. If it is not found within
+//ANT_PAIRING_SEARCH_TIMEOUT the module closes the channel and it is reopened as a wildcard search.
+//
+//The cache is most recently used first and the least recently used device is dropped when it is full. Only the most recent
+//device of a type is searched for. The cache is saved through an ANTPairingStore whenever it changes:
+//  ANTPairingEEPROM (ANTPlus_PairingEEPROM.h) on the Arduino, HostPairingFile (extras/host) on a PC.
+//
+//Stored as: 'P' <version> <count> then <device number LSB> <device number MSB> <device type> <transmission type> per device
+//and an XOR checksum of everything before it. ANT_PAIRING_STORE_SIZE bytes.
+
+#ifndef ANTPlus_Pairing_h
+#define ANTPlus_Pairing_h
+
+#include <Arduino.h>
+
+#define ANT_PAIRING_VERSION (1)
+
+#if !defined(ANT_PAIRING_CACHE_SIZE)
+#define ANT_PAIRING_CACHE_SIZE (4) //!< Devices remembered. 4 bytes each in SRAM and in the store.
+#endif
+
+#if !defined(ANT_PAIRING_SEARCH_TIMEOUT)
+#define ANT_PAIRING_SEARCH_TIMEOUT (4) //!< Search timeout (2.5 s units) for a remembered device before going back to a wildcard search
+#endif
+
+#if (ANT_PAIRING_CACHE_SIZE < 1) || (ANT_PAIRING_CACHE_SIZE > 63)
+#error "ANT_PAIRING_CACHE_SIZE must be 1..63"
+#endif
+
+#define ANT_PAIRING_STORE_SIZE (3 + (4 * ANT_PAIRING_CACHE_SIZE) + 1) //!< Bytes used in the store
+
+typedef struct ANT_PairedDevice_struct
+{
+  unsigned int device_number;
+  byte         device_type;       //!< Without the pairing bit. 0 is an empty slot.
+  byte         transmission_type;
+} ANT_PairedDevice;
+
+//! Where the cache is kept between power cycles. load() returns false if there is nothing (the cache starts empty).
+//A load of something that is not a saved cache (e.g. fresh EEPROM) is caught by the cache.
+class ANTPairingStore
+{
+  public:
+    virtual boolean load(byte * data, byte size) = 0;
+    virtual void    save(const byte * data, byte size) = 0;
+};
+
+//! Most recently used first cache of paired devices. Attach with ANTPlus::setPairingCache() (needs ANTPLUS_PAIRING).
+class ANTPairingCache
+{
+  public:
+    ANTPairingCache();
+
+    //! Load from store (kept -- changes are saved to it). Returns false if there was no valid cache in it (starts empty).
+    boolean begin(ANTPairingStore & store);
+
+    //! Most recently used device of device_type, or NULL
+    const ANT_PairedDevice * find(byte device_type) const;
+    //! device paired (now the most recently used). Saved if that changed the cache.
+    void remember(byte device_type, unsigned int device_number, byte transmission_type);
+    void clear();
+
+    byte size() const;
+    //! index 0 is the most recently used
+    const ANT_PairedDevice & at(byte index) const {return devices[index];};
+
+  private:
+    void save();
+
+    ANT_PairedDevice  devices[ANT_PAIRING_CACHE_SIZE];
+    ANTPairingStore * store;
+};
+
+#endif //ANTPlus_Pairing_h
@@ -0,0 +1,41 @@
+//Copyright 2013 Brody Kenrick.
+//EEPROM store for the pairing cache (see ANTPlus_Pairing.h). Include from the sketch (it needs the EEPROM library).
+
+#ifndef ANTPlus_PairingEEPROM_h
+#define ANTPlus_PairingEEPROM_h
+
+#include <EEPROM.h>
+
+#include "ANTPlus_Pairing.h"
+
+//! ANT_PAIRING_STORE_SIZE bytes of EEPROM from address. Only bytes that change are written (EEPROM wears out).
+class ANTPairingEEPROM : public ANTPairingStore
+{
+  public:
+    explicit ANTPairingEEPROM(int address = 0) : address(address) {};
+
+    boolean load(byte * data, byte size)
+    {
+      for (byte i = 0; i < size; i++)
+      {
+        data[i] = EEPROM.read(address + i);
+      }
+      return true;
+    };
+
+    void save(const byte * data, byte size)
+    {
+      for (byte i = 0; i < size; i++)
+      {
+        if (EEPROM.read(address + i) != data[i])
+        {
+          EEPROM.write(address + i, data[i]);
+        }
+      }
+    };
+
+  private:
+    int address;
+};
+
+#endif //ANTPlus_PairingEEPROM_h
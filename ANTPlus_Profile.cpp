@@ -0,0 +1,142 @@
+//Copyright 2013 Brody Kenrick.
+//Built in device profiles. See ANTPlus_Profile.h
+
+#include "ANTPlus.h"
+
+//Read from the raw bytes (not the bit field structs in ANTPlus.h) so the layout does not depend on the compiler
+
+//! Every HRM page has the beat event time, beat count and computed heart rate in bytes 4-7
+static void hrm_page( const ANT_Channel * channel, const byte * page, const void * sink )
+{
+  const ANT_HRMSink * hrm = (const ANT_HRMSink *) sink;
+  if( hrm->page != NULL )
+  {
+    hrm->page( channel, (const ANT_HRMDataPage *) page, hrm->context );
+  }
+  if( hrm->heart_rate != NULL )
+  {
+    hrm->heart_rate( channel, page[7], page[6], page[4] | (page[5] << 8), hrm->context );
+  }
+}
+
+static const ANT_PageDecoder hrm_pages[] PROGMEM =
+{
+  hrm_page, //DATA_PAGE_HEART_RATE_0
+  hrm_page, //DATA_PAGE_HEART_RATE_1
+  hrm_page, //DATA_PAGE_HEART_RATE_2
+  hrm_page, //DATA_PAGE_HEART_RATE_3
+  hrm_page, //DATA_PAGE_HEART_RATE_4
+  hrm_page, //5-7 (newer background pages) still have bytes 4-7
+  hrm_page,
+  hrm_page,
+};
+
+const ANT_Profile ant_profile_hrm PROGMEM =
+{
+  DEVCE_TYPE_HRM,
+  0x7F, //Page change toggle
+  sizeof(hrm_pages) / sizeof(hrm_pages[0]),
+  hrm_pages,
+  0, //Any network
+};
+
+static void sdm_page_1( const ANT_Channel * channel, const byte * page, const void * sink )
+{
+  const ANT_SDMSink * sdm = (const ANT_SDMSink *) sink;
+  if( sdm->speed_distance != NULL )
+  {
+    sdm->speed_distance( channel,
+                         (page[2] * 200U) + page[1],
+                         (page[3] << 4) | (page[4] >> 4),
+                         ((page[4] & 0x0F) << 8) | page[5],
+                         page[6],
+                         page[7],
+                         sdm->context );
+  }
+}
+
+static void sdm_page_2( const ANT_Channel * channel, const byte * page, const void * sink )
+{
+  const ANT_SDMSink * sdm = (const ANT_SDMSink *) sink;
+  if( sdm->cadence != NULL )
+  {
+    sdm->cadence( channel,
+                  (page[3] << 4) | (page[4] >> 4),
+                  ((page[4] & 0x0F) << 8) | page[5],
+                  page[7],
+                  sdm->context );
+  }
+}
+
+static const ANT_PageDecoder sdm_pages[] PROGMEM =
+{
+  NULL,       //Not an SDM page
+  sdm_page_1, //DATA_PAGE_SPEED_DISTANCE_1
+  sdm_page_2, //DATA_PAGE_SPEED_DISTANCE_2
+};
+
+const ANT_Profile ant_profile_sdm PROGMEM =
+{
+  DEVCE_TYPE_SDM,
+  0xFF,
+  sizeof(sdm_pages) / sizeof(sdm_pages[0]),
+  sdm_pages,
+  0, //Any network
+};
+
+static void speed_cadence_page( const ANT_Channel * channel, const byte * page, const void * sink )
+{
+  const ANT_SpeedCadenceSink * bike = (const ANT_SpeedCadenceSink *) sink;
+  if( bike->speed_cadence != NULL )
+  {
+    bike->speed_cadence( channel, page[0] | (page[1] << 8), page[2] | (page[3] << 8), page[4] | (page[5] << 8), page[6] | (page[7] << 8),
+                         bike->context );
+  }
+}
+
+static const ANT_PageDecoder speed_cadence_pages[] PROGMEM =
+{
+  speed_cadence_page,
+};
+
+const ANT_Profile ant_profile_speed_cadence PROGMEM =
+{
+  DEVCE_TYPE_CADENCE,
+  0x00, //No page number -- byte 0 is the cadence event time
+  sizeof(speed_cadence_pages) / sizeof(speed_cadence_pages[0]),
+  speed_cadence_pages,
+  0, //Any network
+};
+
+//! The programmable pages are 0x20-0x2F -- the page number is checked here rather than with a table of 48 entries
+static void gps_page( const ANT_Channel * channel, const byte * page, const void * sink )
+{
+  const ANT_GPSSink * gps = (const ANT_GPSSink *) sink;
+  if( (page[0] < DATA_PAGE_GPS_PROGRAMMABLE_FIRST) || (page[0] > DATA_PAGE_GPS_PROGRAMMABLE_LAST) )
+  {
+    return;
+  }
+  if( gps->page != NULL )
+  {
+    gps->page( channel, (const ANT_GPSDataPage *) page, gps->context );
+  }
+  if( (gps->location != NULL) && ((page[1] == GPS_DATA_ID_LATITUDE) || (page[1] == GPS_DATA_ID_LONGITUDE)) )
+  {
+    int32_t semicircles = (int32_t) ((uint32_t) page[2] | ((uint32_t) page[3] << 8) | ((uint32_t) page[4] << 16) | ((uint32_t) page[5] << 24));
+    gps->location( channel, page[1], semicircles, gps->context );
+  }
+}
+
+static const ANT_PageDecoder gps_pages[] PROGMEM =
+{
+  gps_page,
+};
+
+const ANT_Profile ant_profile_gps PROGMEM =
+{
+  DEVCE_TYPE_GPS,
+  0x00, //Every page to gps_page()
+  sizeof(gps_pages) / sizeof(gps_pages[0]),
+  gps_pages,
+  (1 << GPS_NETWORK), //Not the sensor channels -- their device type can be a wildcard too
+};
@@ -0,0 +1,108 @@
+//Copyright 2013 Brody Kenrick.
+//Device profiles -- decoders for the data pages of a device type, looked up from a table in flash (PROGMEM)
+
+//Included from ANTPlus.h (it needs ANT_Channel) -- include ANTPlus.h rather than this.
+//
+//A profile is a dense table of page decoders indexed by data page number (after page_mask -- the HRM toggle bit is masked
+//off) for one device type. ANTPlus::add_profile() registers a profile with the sink its decoders deliver to. Each added
+//channel is matched to a profile by ANT_Channel::device_type (and network_number, if the profile has networks) when either
+//is added, so routing a broadcast or acknowledged message is a table read -- the same cost whatever the number of profiles:
+//
+//  static void hr( const ANT_Channel * channel, byte computed_heart_rate, byte beat_count, unsigned int beat_time, void * context )
+//  {
+//    ...
+//  }
+//  static const ANT_HRMSink hrm_sink = { hr, NULL, NULL };
+//  ...
+//  antplus.add_profile( &ant_profile_hrm, &hrm_sink );
+//
+//Decoders are called from the read (readPacket() or readPackets()) with the 8 bytes of the page, before the packet is
+//returned to the sketch. Keep sinks short.
+//
+//A profile of your own is a PROGMEM ANT_Profile and a PROGMEM table of page_count ANT_PageDecoder (NULL for pages that
+//are not decoded). The sink is whatever its decoders expect.
+
+#ifndef ANTPlus_Profile_h
+#define ANTPlus_Profile_h
+
+#include <Arduino.h>
+
+#if !defined(ANT_PROFILE_MAX)
+#define ANT_PROFILE_MAX (4) //!< Profiles that can be added (see ANTPlus::add_profile()). Each is two pointers of SRAM.
+#endif
+
+#if (ANT_PROFILE_MAX < 1) || (ANT_PROFILE_MAX > 254)
+#error "ANT_PROFILE_MAX must be 1..254"
+#endif
+
+#define ANT_PROFILE_NONE (0xFF) //!< No profile for a channel
+
+//! Decode one data page (page[0] is the data page number) for channel into sink
+typedef void (*ANT_PageDecoder)( const ANT_Channel * channel, const byte * page, const void * sink );
+
+//! Data page decoders for a device type. In PROGMEM -- as is the table pages points to.
+typedef struct ANT_Profile_struct
+{
+  byte device_type;               //!< Without the pairing bit
+  byte page_mask;                 //!< Applied to the data page number before the lookup
+  byte page_count;                //!< Entries in pages. Pages after these are not decoded.
+  const ANT_PageDecoder * pages;  //!< Indexed by (masked) data page number. NULL entries are not decoded.
+  byte networks;                  //!< Bit per ANT_Channel::network_number (0..7) the profile is for. 0 (or left out) is any network.
+} ANT_Profile;
+
+//! Heart rate monitor (DEVCE_TYPE_HRM). Pages 0-7 (the toggle bit is masked off) into an ANT_HRMSink.
+extern const ANT_Profile ant_profile_hrm PROGMEM;
+
+//! Either callback can be NULL.
+//heart_rate has the values on every HRM page. beat_time is the last heart beat event in 1/1024 s; it and beat_count roll over.
+//page has the whole page -- e.g. for an ANTHeartRate (ANTPlus_HeartRate.h), which has a sink of its own.
+typedef struct ANT_HRMSink_struct
+{
+  void (*heart_rate)( const ANT_Channel * channel, byte computed_heart_rate, byte beat_count, unsigned int beat_time, void * context );
+  void (*page)( const ANT_Channel * channel, const ANT_HRMDataPage * page, void * context );
+  void * context;
+} ANT_HRMSink;
+
+//! Stride based speed and distance monitor (DEVCE_TYPE_SDM). Pages 1 and 2 into an ANT_SDMSink.
+extern const ANT_Profile ant_profile_sdm PROGMEM;
+
+//! Either callback can be NULL.
+//Page 1: time in 1/200 s (rolls over at 256 s), distance in 1/16 m (rolls over at 256 m), speed in 1/256 m/s,
+//        strides (rolls over at 256) and the update latency in 1/32 s.
+//Page 2: cadence in 1/16 strides/min, speed in 1/256 m/s and the status byte.
+typedef struct ANT_SDMSink_struct
+{
+  void (*speed_distance)( const ANT_Channel * channel, unsigned int time, unsigned int distance, unsigned int speed, byte strides, byte latency, void * context );
+  void (*cadence)( const ANT_Channel * channel, unsigned int cadence, unsigned int speed, byte status, void * context );
+  void * context;
+} ANT_SDMSink;
+
+//! Bike speed and cadence sensor (DEVCE_TYPE_CADENCE). Every message (there is no page number) into an ANT_SpeedCadenceSink.
+extern const ANT_Profile ant_profile_speed_cadence PROGMEM;
+
+//! Event times in 1/1024 s and cumulative revolutions (crank and wheel) -- all roll over at 16 bits.
+//See ANTSpeedCadence (ANTPlus_SpeedCadence.h).
+typedef struct ANT_SpeedCadenceSink_struct
+{
+  void (*speed_cadence)( const ANT_Channel * channel, unsigned int cadence_time, unsigned int cadence_revolutions,
+                         unsigned int speed_time, unsigned int speed_revolutions, void * context );
+  void * context;
+} ANT_SpeedCadenceSink;
+
+//! GPS (geocache) on its own network (GPS_NETWORK, DEVCE_GPS_FREQ, DEVCE_GPS_RATE). The programmable pages
+//(DATA_PAGE_GPS_PROGRAMMABLE_FIRST..LAST) into an ANT_GPSSink -- other pages are not decoded.
+//Only channels on GPS_NETWORK -- DEVCE_TYPE_GPS is 0, so a wildcard channel on another network is not decoded as GPS.
+extern const ANT_Profile ant_profile_gps PROGMEM;
+
+//! Either callback can be NULL.
+//location has a latitude or longitude (data_id GPS_DATA_ID_LATITUDE/GPS_DATA_ID_LONGITUDE -- each comes on a page of its own)
+//in semicircles: 2^31 is 180 degrees, so degrees = semicircles * (180.0 / 2147483648.0).
+//page has every programmable page (e.g. for the other data ids).
+typedef struct ANT_GPSSink_struct
+{
+  void (*location)( const ANT_Channel * channel, byte data_id, long semicircles, void * context );
+  void (*page)( const ANT_Channel * channel, const ANT_GPSDataPage * page, void * context );
+  void * context;
+} ANT_GPSSink;
+
+#endif //ANTPlus_Profile_h
@@ -0,0 +1,79 @@
+//Copyright 2013 Brody Kenrick.
+//Receive ring between the UART (ISR or Stream pump) and the ANTPlus frame parser
+
+#ifndef ANTPlus_RingBuffer_h
+#define ANTPlus_RingBuffer_h
+
+#include <Arduino.h>
+
+#if !defined(ANT_RX_RING_SIZE)
+#define ANT_RX_RING_SIZE (64) //!< Bytes buffered between the UART and the frame parser. Power of two, at most 128.
+#endif
+
+#if ((ANT_RX_RING_SIZE & (ANT_RX_RING_SIZE - 1)) != 0) || (ANT_RX_RING_SIZE > 128)
+#error "ANT_RX_RING_SIZE must be a power of two and no more than 128"
+#endif
+
+//! Stop the compiler reordering buffer accesses around an index update.
+#define ANT_RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+//! Lock-free single-producer/single-consumer byte ring.
+//Only the producer (UART RX ISR or a Stream pump) writes head. Only the consumer (the frame parser) writes tail.
+//Both are free-running bytes so each side is a single byte load/store (atomic on AVR) -- no need to disable interrupts.
+class ANTRingBuffer
+{
+  public:
+    ANTRingBuffer() : head(0), tail(0), overrun_count(0), high_water_mark(0) {};
+
+    //! Producer side. Returns false (and counts an overrun) if the ring is full -- the byte is dropped.
+    boolean put(byte value)
+    {
+      byte used = (byte)(head - tail);
+      if(used >= ANT_RX_RING_SIZE)
+      {
+        overrun_count++;
+        return false;
+      }
+      buf[head & (ANT_RX_RING_SIZE - 1)] = value;
+      ANT_RING_BARRIER();
+      head++;
+      if(used >= high_water_mark)
+      {
+        high_water_mark = used + 1;
+      }
+      return true;
+    };
+
+    //! Consumer side. Returns -1 if the ring is empty.
+    int get()
+    {
+      if(head == tail)
+      {
+        return -1;
+      }
+      byte value = buf[tail & (ANT_RX_RING_SIZE - 1)];
+      ANT_RING_BARRIER();
+      tail++;
+      return value;
+    };
+
+    byte available() const {return (byte)(head - tail);};
+    byte space() const     {return ANT_RX_RING_SIZE - available();};
+
+    //! Consumer side. Discards everything currently buffered.
+    void clear() {tail = head;};
+
+    //NOTE: overrun_count is multi-byte -- a read racing the producer might see a torn value on AVR
+    unsigned int overruns() const      {return overrun_count;};
+    byte         highWaterMark() const {return high_water_mark;};
+    void         resetStatistics()     {overrun_count = 0; high_water_mark = 0;};
+
+  private:
+    volatile byte head;
+    volatile byte tail;
+    volatile unsigned int overrun_count; //!< Bytes dropped as the ring was full
+    volatile byte high_water_mark;       //!< Most bytes ever held
+    byte buf[ANT_RX_RING_SIZE];
+};
+
+#endif //ANTPlus_RingBuffer_h
@@ -0,0 +1,64 @@
+//Copyright 2013 Brody Kenrick.
+//Channel setup scripts kept in flash (PROGMEM) and streamed to the ANT module
+
+//A script is a list of records ending with ANT_SCRIPT_END. Each record is
+//  <data size> <msg id> <data...> <response msg id expected>
+//Build them with the macros below, e.g.
+//
+//  static const byte hrm_setup[] PROGMEM =
+//  {
+//    ANT_SCRIPT_NETWORK_KEY( PUBLIC_NETWORK, ANT_SENSOR_NETWORK_KEY_BYTES ),
+//    ANT_SCRIPT_RECEIVE_CHANNEL( 0, PUBLIC_NETWORK, DEVCE_TYPE_HRM, DEVCE_TIMEOUT, DEVCE_SENSOR_FREQ, DEVCE_HRM_LOWEST_RATE ),
+//    ANT_SCRIPT_END
+//  };
+//  ...
+//  hrm_channel.setup_script = hrm_setup;
+//
+//NOTE: The network key must be given as 8 bytes (no braces) e.g. #define ANT_SENSOR_NETWORK_KEY_BYTES 0x00, 0x00, ...
+//The frames (and the key) then stay in flash. See ANTPlus::progress_setup_channels().
+//A script cannot reset the module (the other channels would be lost with it) -- use softReset().
+
+#ifndef ANTPlus_Script_h
+#define ANTPlus_Script_h
+
+#include "antdefines.h"
+#include "antmessage.h"
+
+#define ANT_SCRIPT_END (0)
+
+#define ANT_SCRIPT_REQUEST( channel, requested_id ) \
+  MESG_REQUEST_SIZE, MESG_REQUEST_ID, (channel), (requested_id), (requested_id)
+
+#define ANT_SCRIPT_ASSIGN_CHANNEL( channel, channel_type, network ) \
+  MESG_ASSIGN_CHANNEL_SIZE, MESG_ASSIGN_CHANNEL_ID, (channel), (channel_type), (network), MESG_RESPONSE_EVENT_ID
+
+#define ANT_SCRIPT_CHANNEL_ID( channel, device_number, device_type, transmission_type ) \
+  MESG_CHANNEL_ID_SIZE, MESG_CHANNEL_ID_ID, (channel), LOW_BYTE(device_number), HIGH_BYTE(device_number), (device_type), (transmission_type), MESG_RESPONSE_EVENT_ID
+
+//Indirection so a macro holding the 8 key bytes is expanded before they are counted
+#define ANT_SCRIPT_NETWORK_KEY( network, ... ) ANT_SCRIPT_NETWORK_KEY_8( network, __VA_ARGS__ )
+#define ANT_SCRIPT_NETWORK_KEY_8( network, k0, k1, k2, k3, k4, k5, k6, k7 ) \
+  MESG_NETWORK_KEY_SIZE, MESG_NETWORK_KEY_ID, (network), (k0), (k1), (k2), (k3), (k4), (k5), (k6), (k7), MESG_RESPONSE_EVENT_ID
+
+#define ANT_SCRIPT_CHANNEL_SEARCH_TIMEOUT( channel, timeout ) \
+  MESG_CHANNEL_SEARCH_TIMEOUT_SIZE, MESG_CHANNEL_SEARCH_TIMEOUT_ID, (channel), (timeout), MESG_RESPONSE_EVENT_ID
+
+#define ANT_SCRIPT_CHANNEL_RADIO_FREQ( channel, freq ) \
+  MESG_CHANNEL_RADIO_FREQ_SIZE, MESG_CHANNEL_RADIO_FREQ_ID, (channel), (freq), MESG_RESPONSE_EVENT_ID
+
+#define ANT_SCRIPT_CHANNEL_PERIOD( channel, period ) \
+  MESG_CHANNEL_MESG_PERIOD_SIZE, MESG_CHANNEL_MESG_PERIOD_ID, (channel), LOW_BYTE(period), HIGH_BYTE(period), MESG_RESPONSE_EVENT_ID
+
+#define ANT_SCRIPT_OPEN_CHANNEL( channel ) \
+  MESG_OPEN_CHANNEL_SIZE, MESG_OPEN_CHANNEL_ID, (channel), MESG_RESPONSE_EVENT_ID
+
+//! The sequence progress_setup_channel() sends for a wildcard receive channel (less the capabilities request and network key)
+#define ANT_SCRIPT_RECEIVE_CHANNEL( channel, network, device_type, timeout, freq, period ) \
+  ANT_SCRIPT_ASSIGN_CHANNEL( channel, CHANNEL_TYPE_SLAVE, network ), \
+  ANT_SCRIPT_CHANNEL_ID( channel, 0, device_type, 0 ), \
+  ANT_SCRIPT_CHANNEL_SEARCH_TIMEOUT( channel, timeout ), \
+  ANT_SCRIPT_CHANNEL_RADIO_FREQ( channel, freq ), \
+  ANT_SCRIPT_CHANNEL_PERIOD( channel, period ), \
+  ANT_SCRIPT_OPEN_CHANNEL( channel )
+
+#endif //ANTPlus_Script_h
@@ -0,0 +1,117 @@
+//Copyright 2013 Brody Kenrick.
+//Bike speed and cadence. See ANTPlus_SpeedCadence.h
+
+#include "ANTPlus.h"
+#include "ANTPlus_SpeedCadence.h"
+
+#define ANT_BIKE_RATE_SCALE (60UL * 1024UL * 16UL) //!< Revolutions per 1/1024 s to 1/16 rpm
+
+ANTSpeedCadence::ANTSpeedCadence()
+{
+  bikeSink.speed_cadence = speedCadenceSink;
+  bikeSink.context = this;
+  wheel_circumference = ANT_BIKE_WHEEL_CIRCUMFERENCE_MM;
+  reset();
+}
+
+void ANTSpeedCadence::reset()
+{
+  message_count = 0;
+  resetRate( crank );
+  resetRate( wheel );
+}
+
+void ANTSpeedCadence::resetRate( ANT_RevolutionRate & rate )
+{
+  memset( &rate, 0, sizeof(rate) );
+  rate.first = true;
+}
+
+void ANTSpeedCadence::speedCadenceSink( const ANT_Channel * /*channel*/, unsigned int cadence_time, unsigned int cadence_revolutions,
+                                        unsigned int speed_time, unsigned int speed_revolutions, void * context )
+{
+  ((ANTSpeedCadence *) context)->update( cadence_time, cadence_revolutions, speed_time, speed_revolutions );
+}
+
+void ANTSpeedCadence::update( unsigned int cadence_time, unsigned int cadence_revolutions, unsigned int speed_time, unsigned int speed_revolutions )
+{
+  message_count++;
+  updateRate( crank, cadence_time, cadence_revolutions );
+  updateRate( wheel, speed_time, speed_revolutions );
+}
+
+void ANTSpeedCadence::updateRate( ANT_RevolutionRate & rate, unsigned int time, unsigned int revolutions )
+{
+  if( rate.first )
+  {
+    rate.first = false;
+    rate.last_time = time;
+    rate.last_revolutions = revolutions;
+    return;
+  }
+  if( time == rate.last_time )
+  {
+    //No new event -- stopped once it has been long enough
+    if( rate.stale_messages < ANT_BIKE_STALE_MESSAGES )
+    {
+      rate.stale_messages++;
+    }
+    if( (rate.stale_messages == ANT_BIKE_STALE_MESSAGES) && !rate.restart )
+    {
+      rate.restart = true;
+      rate.rate = 0;
+      rate.events = 0;
+      rate.time_sum = 0;
+      rate.revolution_sum = 0;
+    }
+    return;
+  }
+  //Both roll over at 16 bits (unsigned int is wider off AVR)
+  unsigned int event_time = (uint16_t) (time - rate.last_time);
+  unsigned int event_revolutions = (uint16_t) (revolutions - rate.last_revolutions);
+  rate.last_time = time;
+  rate.last_revolutions = revolutions;
+  rate.stale_messages = 0;
+  rate.revolutions += event_revolutions;
+  if( rate.restart || (event_revolutions == 0) || (event_revolutions > 0xFF) )
+  {
+    //Timed from here
+    rate.restart = false;
+    return;
+  }
+
+  unsigned long event_rate = (event_revolutions * ANT_BIKE_RATE_SCALE) / event_time;
+  rate.rate = (event_rate > 0xFFFF) ? 0xFFFF : event_rate;
+
+  byte slot = rate.head & (ANT_BIKE_AVERAGE_EVENTS - 1);
+  if( rate.events == ANT_BIKE_AVERAGE_EVENTS )
+  {
+    rate.time_sum -= rate.event_time[slot];
+    rate.revolution_sum -= rate.event_revolutions[slot];
+  }
+  else
+  {
+    rate.events++;
+  }
+  rate.event_time[slot] = event_time;
+  rate.event_revolutions[slot] = event_revolutions;
+  rate.time_sum += event_time;
+  rate.revolution_sum += event_revolutions;
+  rate.head++;
+}
+
+unsigned int ANTSpeedCadence::averageRate( const ANT_RevolutionRate & rate )
+{
+  if( rate.time_sum == 0 )
+  {
+    return 0;
+  }
+  unsigned long average = (rate.revolution_sum * ANT_BIKE_RATE_SCALE) / rate.time_sum;
+  return (average > 0xFFFF) ? 0xFFFF : average;
+}
+
+//! 1/16 rpm of the wheel to 1/256 m/s: * circumference (mm) / (60 * 16) / 1000 * 256 = * circumference / 3750
+unsigned int ANTSpeedCadence::wheelSpeed( unsigned int rate ) const
+{
+  return ((unsigned long) rate * wheel_circumference) / 3750UL;
+}
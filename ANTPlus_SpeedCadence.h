@@ -0,0 +1,103 @@
+//Copyright 2013 Brody Kenrick.
+//Bike speed and cadence sensor -- instantaneous and averaged speed and cadence, distance and stopped detection
+
+//Feed it the messages of one combined speed and cadence sensor (DEVCE_TYPE_CADENCE, channel period DEVCE_CADENCE_RATE), from
+//the profile:
+//
+//  static ANTSpeedCadence bike;
+//  ...
+//  bike.setWheelCircumference( 2096 );
+//  antplus.add_profile( &ant_profile_speed_cadence, bike.sink() );
+//
+//or call update() with the values from a sink of your own (ANT_SpeedCadenceSink).
+//
+//Each message has the time of the last crank (cadence) and wheel (speed) event in 1/1024 s and the count of revolutions, all
+//rolling over at 16 bits. A rate comes from the revolutions between two events over the time between them. The average is over
+//the last ANT_BIKE_AVERAGE_EVENTS events (kept in a ring, with running sums -- constant time per message). All in fixed point.
+//
+//The sensor keeps sending the same event when the crank or wheel stops. After ANT_BIKE_STALE_MESSAGES of those the rate (and
+//its average) is 0 and cadenceStale()/speedStale() is true until the revolutions move again. The first event after that only restarts the timing
+//(the time since the last event may have rolled over) -- its revolutions still count towards the distance.
+
+#ifndef ANTPlus_SpeedCadence_h
+#define ANTPlus_SpeedCadence_h
+
+#include <Arduino.h>
+
+#include "ANTPlus.h"
+
+#if !defined(ANT_BIKE_AVERAGE_EVENTS)
+#define ANT_BIKE_AVERAGE_EVENTS (8) //!< Events averaged over (3 bytes each for speed and for cadence). Power of two, 2..16
+                                    //!< (16 x 255 revolutions still fits the 32 bit average).
+#endif
+
+#if ((ANT_BIKE_AVERAGE_EVENTS & (ANT_BIKE_AVERAGE_EVENTS - 1)) != 0) || (ANT_BIKE_AVERAGE_EVENTS < 2) || (ANT_BIKE_AVERAGE_EVENTS > 16)
+#error "ANT_BIKE_AVERAGE_EVENTS must be a power of two, 2..16"
+#endif
+
+#if !defined(ANT_BIKE_STALE_MESSAGES)
+#define ANT_BIKE_STALE_MESSAGES (12) //!< Messages without a new event before the crank or wheel is taken as stopped (~3 s at 4 Hz)
+#endif
+
+#if !defined(ANT_BIKE_WHEEL_CIRCUMFERENCE_MM)
+#define ANT_BIKE_WHEEL_CIRCUMFERENCE_MM (2096) //!< 700x23C
+#endif
+
+//! Revolutions and their rate for the crank or the wheel. Private to ANTSpeedCadence.
+typedef struct ANT_RevolutionRate_struct
+{
+  boolean       first;         //!< Nothing seen yet
+  boolean       restart;       //!< Stale -- the next event only restarts the timing
+  byte          stale_messages;
+  unsigned int  last_time;
+  unsigned int  last_revolutions;
+  unsigned long revolutions;   //!< Since the first message
+  unsigned int  rate;          //!< 1/16 rpm
+  unsigned int  event_time[ANT_BIKE_AVERAGE_EVENTS]; //!< 1/1024 s between events
+  byte          event_revolutions[ANT_BIKE_AVERAGE_EVENTS];
+  byte          events;        //!< In the ring
+  byte          head;          //!< Free-running -- next slot to write
+  unsigned long time_sum;      //!< Of the ring
+  unsigned int  revolution_sum;
+} ANT_RevolutionRate;
+
+class ANTSpeedCadence
+{
+  public:
+    ANTSpeedCadence();
+    //! Forget everything (e.g. a different sensor). The wheel circumference is kept.
+    void reset();
+    void setWheelCircumference( unsigned int millimetres ) {wheel_circumference = millimetres;};
+
+    //! One message (units as ANT_SpeedCadenceSink::speed_cadence)
+    void update( unsigned int cadence_time, unsigned int cadence_revolutions, unsigned int speed_time, unsigned int speed_revolutions );
+    //! Sink for ANTPlus::add_profile() with ant_profile_speed_cadence that calls update()
+    const ANT_SpeedCadenceSink * sink() const {return &bikeSink;};
+
+    unsigned int  cadence() const {return crank.rate;};                 //!< 1/16 rpm, over the last two events
+    unsigned int  averageCadence() const {return averageRate(crank);};  //!< 1/16 rpm, over ANT_BIKE_AVERAGE_EVENTS
+    unsigned long crankRevolutions() const {return crank.revolutions;};
+    boolean       cadenceStale() const {return crank.restart;};         //!< Not pedalling (or the sensor is not)
+    unsigned int  speed() const {return wheelSpeed(wheel.rate);};       //!< 1/256 m/s
+    unsigned int  averageSpeed() const {return wheelSpeed(averageRate(wheel));};
+    unsigned long wheelRevolutions() const {return wheel.revolutions;};
+    unsigned long distance() const {return wheel.revolutions * wheel_circumference;}; //!< mm
+    boolean       speedStale() const {return wheel.restart;};           //!< Stopped
+    unsigned long messages() const {return message_count;};
+
+  private:
+    static void updateRate( ANT_RevolutionRate & rate, unsigned int time, unsigned int revolutions );
+    static void resetRate( ANT_RevolutionRate & rate );
+    static unsigned int averageRate( const ANT_RevolutionRate & rate );
+    unsigned int wheelSpeed( unsigned int rate ) const;
+    static void speedCadenceSink( const ANT_Channel * channel, unsigned int cadence_time, unsigned int cadence_revolutions,
+                                  unsigned int speed_time, unsigned int speed_revolutions, void * context );
+
+    ANT_SpeedCadenceSink bikeSink;
+    unsigned int         wheel_circumference; //!< mm
+    unsigned long        message_count;
+    ANT_RevolutionRate   crank;
+    ANT_RevolutionRate   wheel;
+};
+
+#endif //ANTPlus_SpeedCadence_h
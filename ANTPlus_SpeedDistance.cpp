@@ -0,0 +1,62 @@
+//Copyright 2013 Brody Kenrick.
+//SDM totals. See ANTPlus_SpeedDistance.h
+
+#include "ANTPlus.h"
+#include "ANTPlus_SpeedDistance.h"
+
+ANTSpeedDistance::ANTSpeedDistance()
+{
+  sdmSink.speed_distance = speedDistanceSink;
+  sdmSink.cadence = cadenceSink;
+  sdmSink.context = this;
+  reset();
+}
+
+void ANTSpeedDistance::reset()
+{
+  first = true;
+  last_time = 0;
+  last_distance = 0;
+  last_strides = 0;
+  total_time = 0;
+  total_distance = 0;
+  total_strides = 0;
+  page_count = 0;
+  last_speed = 0;
+  last_cadence = 0;
+  last_status = 0;
+}
+
+void ANTSpeedDistance::speedDistanceSink( const ANT_Channel * /*channel*/, unsigned int time, unsigned int distance, unsigned int speed, byte strides, byte latency, void * context )
+{
+  ((ANTSpeedDistance *) context)->updateSpeedDistance( time, distance, speed, strides, latency );
+}
+
+void ANTSpeedDistance::cadenceSink( const ANT_Channel * /*channel*/, unsigned int cadence, unsigned int speed, byte status, void * context )
+{
+  ((ANTSpeedDistance *) context)->updateCadence( cadence, speed, status );
+}
+
+void ANTSpeedDistance::updateSpeedDistance( unsigned int time, unsigned int distance, unsigned int speed, byte strides, byte /*latency*/ )
+{
+  last_speed = speed;
+  if( !first )
+  {
+    //Time rolls over at 51200 (not a power of two) -- the others are masked. Added in unsigned int so it wraps back.
+    total_time += (time >= last_time) ? (time - last_time) : (unsigned int) ((time - last_time) + ANT_SDM_TIME_ROLLOVER);
+    total_distance += (distance - last_distance) & (ANT_SDM_DISTANCE_ROLLOVER - 1);
+    total_strides += (byte) (strides - last_strides);
+    page_count++;
+  }
+  first = false;
+  last_time = time;
+  last_distance = distance;
+  last_strides = strides;
+}
+
+void ANTSpeedDistance::updateCadence( unsigned int cadence, unsigned int speed, byte status )
+{
+  last_cadence = cadence;
+  last_speed = speed;
+  last_status = status;
+}
@@ -0,0 +1,73 @@
+//Copyright 2013 Brody Kenrick.
+//Stride based speed and distance monitor (SDM) -- totals of distance, time and strides from the SDM data pages
+
+//Feed it the pages of one SDM channel, from the profile:
+//
+//  static ANTSpeedDistance sdm;
+//  ...
+//  antplus.add_profile( &ant_profile_sdm, sdm.sink() );
+//
+//or call updateSpeedDistance()/updateCadence() with the values from a sink of your own (ANT_SDMSink).
+//
+//Page 1 carries the sensor's running time (1/200 s, rolls over at 256 s), distance (1/16 m, rolls over at 256 m) and
+//stride count (rolls over at 256). Each is kept whole with its fraction -- the totals are in the page's own units, added up
+//from the difference to the last page with its rollover. The first page (and the first after reset()/resume()) only sets
+//the starting point. No floats and no division: a few 16 bit subtractions and 32 bit additions per page.
+//
+//A gap longer than a rollover (256 m at a run is over a minute) can't be told from a shorter one -- call resume() when the
+//channel has been lost that long (e.g. ANT_Channel::last_dropout_ms) so the next page starts again rather than adding a
+//wrapped difference.
+
+#ifndef ANTPlus_SpeedDistance_h
+#define ANTPlus_SpeedDistance_h
+
+#include <Arduino.h>
+
+#include "ANTPlus.h"
+
+#define ANT_SDM_TIME_ROLLOVER     (256U * 200U) //!< 1/200 s
+#define ANT_SDM_DISTANCE_ROLLOVER (256U * 16U)  //!< 1/16 m
+
+class ANTSpeedDistance
+{
+  public:
+    ANTSpeedDistance();
+    //! Totals to 0 and the next page is the first
+    void reset();
+    //! The next page is the first -- totals are kept (see above)
+    void resume() {first = true;};
+
+    //! Page 1 (units as ANT_SDMSink::speed_distance)
+    void updateSpeedDistance( unsigned int time, unsigned int distance, unsigned int speed, byte strides, byte latency );
+    //! Page 2 (units as ANT_SDMSink::cadence)
+    void updateCadence( unsigned int cadence, unsigned int speed, byte status );
+    //! Sink for ANTPlus::add_profile() with ant_profile_sdm that calls the two above
+    const ANT_SDMSink * sink() const {return &sdmSink;};
+
+    unsigned long time() const {return total_time;};         //!< 1/200 s
+    unsigned long distance() const {return total_distance;}; //!< 1/16 m
+    unsigned long strides() const {return total_strides;};
+    unsigned long pages() const {return page_count;};         //!< Page 1s added up (the first after a resume() is not)
+    unsigned int  speed() const {return last_speed;};         //!< Instantaneous, 1/256 m/s (from either page)
+    unsigned int  cadence() const {return last_cadence;};     //!< 1/16 strides/min (page 2)
+    byte          status() const {return last_status;};       //!< Page 2
+
+  private:
+    static void speedDistanceSink( const ANT_Channel * channel, unsigned int time, unsigned int distance, unsigned int speed, byte strides, byte latency, void * context );
+    static void cadenceSink( const ANT_Channel * channel, unsigned int cadence, unsigned int speed, byte status, void * context );
+
+    ANT_SDMSink   sdmSink;
+    boolean       first;
+    unsigned int  last_time;
+    unsigned int  last_distance;
+    byte          last_strides;
+    unsigned long total_time;
+    unsigned long total_distance;
+    unsigned long total_strides;
+    unsigned long page_count;
+    unsigned int  last_speed;
+    unsigned int  last_cadence;
+    byte          last_status;
+};
+
+#endif //ANTPlus_SpeedDistance_h
@@ -0,0 +1,146 @@
+//Copyright 2013 Brody Kenrick.
+//Counters and histograms for seeing what the link is doing in the field. See ANTPlus_Statistics.h
+
+#include "ANTPlus.h"
+
+#if defined(ANTPLUS_STATISTICS)
+
+static const char * const outcome_names[MESSAGE_READ_COUNT] =
+{
+  "none", "bad checksum", "missing sync", "size exceeded", "timeout midmessage", "internal", "other", "expected",
+};
+
+void ANTStatistics::reset()
+{
+  memset(outcomes, 0, sizeof(outcomes));
+  rx_frames = 0;
+  tx_frames = 0;
+  hw_resets = 0;
+  soft_resets = 0;
+  retries = 0;
+  rts_timeouts = 0;
+  lost_start_ups = 0;
+  memset(broadcasts, 0, sizeof(broadcasts));
+  memset(rx_fails, 0, sizeof(rx_fails));
+  memset(searches, 0, sizeof(searches));
+  memset(broadcast_interval, 0, sizeof(broadcast_interval));
+  memset(&response_latency, 0, sizeof(response_latency));
+  memset(&dropout, 0, sizeof(dropout));
+  memset(last_broadcast_ms, 0, sizeof(last_broadcast_ms));
+}
+
+void ANTStatistics::addSample(ANT_Histogram & histogram, unsigned long ms)
+{
+  byte bucket = 0;
+  while ((ms > 0) && (bucket < (ANT_STATISTICS_BUCKETS - 1)))
+  {
+    ms >>= 1;
+    bucket++;
+  }
+  if (histogram.bucket[bucket] != 0xFFFF)
+  {
+    histogram.bucket[bucket]++;
+  }
+}
+
+void ANTStatistics::countBroadcast(byte channel, unsigned long now_ms)
+{
+  if (channel >= ANT_DEVICE_NUMBER_CHANNELS)
+  {
+    return;
+  }
+  //The first has nothing to measure from. After that gaps (reset, search, reopen) are counted as they are -- they are lost samples.
+  if (broadcasts[channel] > 0)
+  {
+    addSample(broadcast_interval[channel], now_ms - last_broadcast_ms[channel]);
+  }
+  last_broadcast_ms[channel] = now_ms;
+  broadcasts[channel]++;
+}
+
+void ANTStatistics::countChannelEvent(byte channel, byte event)
+{
+  if (channel >= ANT_DEVICE_NUMBER_CHANNELS)
+  {
+    return;
+  }
+  if (event == EVENT_RX_FAIL)
+  {
+    rx_fails[channel]++;
+  }
+  else if (event == EVENT_RX_FAIL_GO_TO_SEARCH)
+  {
+    searches[channel]++;
+  }
+}
+
+//! Non-empty buckets as "<floor ms>+:<count>"
+void ANTStatistics::printHistogram(Print & out, const ANT_Histogram & histogram)
+{
+  for (byte i = 0; i < ANT_STATISTICS_BUCKETS; i++)
+  {
+    if (histogram.bucket[i] == 0)
+    {
+      continue;
+    }
+    out.print(" ");
+    out.print(bucketFloorMs(i));
+    out.print("+:");
+    out.print(histogram.bucket[i]);
+  }
+  out.println();
+}
+
+void ANTStatistics::print(Print & out) const
+{
+  out.print("RX frames ");
+  out.print(rx_frames);
+  out.print(" TX frames ");
+  out.print(tx_frames);
+  out.print(" H/w resets ");
+  out.print(hw_resets);
+  out.print(" soft resets ");
+  out.println(soft_resets);
+  out.print("Retries ");
+  out.print(retries);
+  out.print(" RTS timeouts ");
+  out.print(rts_timeouts);
+  out.print(" lost START_UPs ");
+  out.println(lost_start_ups);
+
+  for (byte i = MESSAGE_READ_NONE + 1; i < MESSAGE_READ_COUNT; i++)
+  {
+    if (i == MESSAGE_READ_INTERNAL)
+    {
+      continue;
+    }
+    out.print(outcome_names[i]);
+    out.print(" ");
+    out.println(outcomes[i]);
+  }
+
+  for (byte channel = 0; channel < ANT_DEVICE_NUMBER_CHANNELS; channel++)
+  {
+    if ((broadcasts[channel] == 0) && (rx_fails[channel] == 0) && (searches[channel] == 0))
+    {
+      continue;
+    }
+    out.print("Ch ");
+    out.print(channel);
+    out.print(" broadcasts ");
+    out.print(broadcasts[channel]);
+    out.print(" rx fails ");
+    out.print(rx_fails[channel]);
+    out.print(" searches ");
+    out.print(searches[channel]);
+    out.print(" interval ms");
+    printHistogram(out, broadcast_interval[channel]);
+  }
+
+  out.print("Response ms");
+  printHistogram(out, response_latency);
+  out.print("Dropout ms");
+  printHistogram(out, dropout);
+}
+
+#endif /*defined(ANTPLUS_STATISTICS)*/
@@ -0,0 +1,72 @@
+//Copyright 2013 Brody Kenrick.
+//Counters and histograms for seeing what the link is doing in the field (ANTPLUS_STATISTICS)
+
+//Included from ANTPlus.h (it needs MESSAGE_READ) -- include ANTPlus.h rather than this.
+//
+//Histograms are log2 buckets of milliseconds: bucket 0 is < 1 ms, bucket N is [2^(N-1), 2^N) ms and the last bucket
+//also holds everything longer. Buckets stop counting at 65535.
+//e.g. a 4 Hz sensor lands in [128, 256) ms, one missed message in [256, 512) ms, two or three in [512, 1024) ms.
+//
+//SRAM is ~390 bytes on AVR with the defaults (half of it the per channel histograms -- 8 x 12 buckets, see ANT_STATISTICS_BUCKETS).
+
+#ifndef ANTPlus_Statistics_h
+#define ANTPlus_Statistics_h
+
+#include <Arduino.h>
+
+#if !defined(ANT_STATISTICS_BUCKETS)
+#define ANT_STATISTICS_BUCKETS (12) //!< Buckets per histogram. The last is >= 2^(N-2) ms (>= 1024 ms with 12).
+#endif
+
+#if (ANT_STATISTICS_BUCKETS < 2) || (ANT_STATISTICS_BUCKETS > 32)
+#error "ANT_STATISTICS_BUCKETS must be 2..32"
+#endif
+
+//! log2 histogram of durations in ms (see above)
+typedef struct ANT_Histogram_struct
+{
+  unsigned int bucket[ANT_STATISTICS_BUCKETS];
+} ANT_Histogram;
+
+//! What the library has seen since it was created (or resetStatistics()). Kept through hardware resets.
+//Read with ANTPlus::statistics(). Everything is filled in by ANTPlus.
+class ANTStatistics
+{
+  public:
+    ANTStatistics() {reset();};
+    void reset();
+
+    void countOutcome(MESSAGE_READ outcome) {outcomes[outcome]++;};
+    void countBroadcast(byte channel, unsigned long now_ms);
+    void countChannelEvent(byte channel, byte event);
+    void countResponse(unsigned long sent_ms, unsigned long now_ms) {addSample(response_latency, now_ms - sent_ms);};
+    void countDropout(unsigned long ms) {addSample(dropout, ms);};
+
+    static void addSample(ANT_Histogram & histogram, unsigned long ms);
+    //! Lowest duration (ms) that falls in bucket
+    static unsigned long bucketFloorMs(byte bucket) {return (bucket == 0) ? 0 : (1UL << (bucket - 1));};
+
+    void print(Print & out) const;
+
+    unsigned long outcomes[MESSAGE_READ_COUNT];                  //!< Every read outcome other than MESSAGE_READ_NONE (readPacket() and readPackets())
+    unsigned long rx_frames;                                     //!< Frames assembled (good or bad checksum)
+    unsigned long tx_frames;
+    unsigned int  hw_resets;                                     //!< Including the one in begin()
+    unsigned int  soft_resets;                                   //!< MESG_SYSTEM_RESET_ID sent by the library
+    unsigned int  retries;                                       //!< Commands resent (no response in ANT_RESPONSE_TIMEOUT_MS)
+    unsigned int  rts_timeouts;                                  //!< No RTS pulse after a frame (ANT_RTS_TIMEOUT_MS)
+    unsigned int  lost_start_ups;                                //!< No MESG_START_UP after a reset but the module was ready
+    unsigned long broadcasts[ANT_DEVICE_NUMBER_CHANNELS];        //!< MESG_BROADCAST_DATA_ID per channel
+    unsigned int  rx_fails[ANT_DEVICE_NUMBER_CHANNELS];          //!< EVENT_RX_FAIL per channel (a broadcast period with nothing received)
+    unsigned int  searches[ANT_DEVICE_NUMBER_CHANNELS];          //!< EVENT_RX_FAIL_GO_TO_SEARCH per channel (the sensor was lost)
+    ANT_Histogram broadcast_interval[ANT_DEVICE_NUMBER_CHANNELS]; //!< Time between broadcasts on each channel
+    ANT_Histogram response_latency;                              //!< Command sent (send() or queued) to its response
+    ANT_Histogram dropout;                                       //!< Tracking lost to the next broadcast, all channels (see ANT_Channel::last_dropout_ms)
+
+  private:
+    static void printHistogram(Print & out, const ANT_Histogram & histogram);
+
+    unsigned long last_broadcast_ms[ANT_DEVICE_NUMBER_CHANNELS];
+};
+
+#endif //ANTPlus_Statistics_h
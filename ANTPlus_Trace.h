@@ -0,0 +1,154 @@
+//Copyright 2013 Brody Kenrick.
+//Tracing the parser, TX, RTS and channel setup into a small RAM ring (ANTPLUS_TRACE)
+
+//Included from ANTPlus.h.
+//Each hook in the library is trace.record<EVENT>(arg). With ANTPLUS_TRACE off (or EVENT masked out of ANT_TRACE_EVENTS)
+//that is an empty inline function and compiles to nothing.
+//With it on an entry is 4 bytes: micros() since the previous entry (65535 means that or longer), the event and one argument byte.
+//Nothing is printed while tracing (unlike ANTPLUS_DEBUG) -- dump() the ring afterwards, e.g. once a problem is noticed,
+//so the timing being looked at is not disturbed by the looking.
+//NOTE: Not safe against interrupts. The hooks run where the library runs (the main loop).
+
+#ifndef ANTPlus_Trace_h
+#define ANTPlus_Trace_h
+
+#include <Arduino.h>
+
+typedef enum
+{
+  ANT_TRACE_RX_BYTE,            //!< arg: the byte (as the parser takes it from the receive ring). Masked out by default
+  ANT_TRACE_FRAME_COMPLETE,     //!< arg: msg id
+  ANT_TRACE_CHECKSUM_FAIL,      //!< arg: msg id
+  ANT_TRACE_SIZE_EXCEEDED,      //!< arg: length byte
+  ANT_TRACE_RESYNC,             //!< arg: bytes skipped to the next sync (255 means that or more)
+  ANT_TRACE_TIMEOUT_MIDMESSAGE, //!< arg: bytes of the partial frame that was dropped
+  ANT_TRACE_SEND_START,         //!< arg: msg id (before the write)
+  ANT_TRACE_SEND_END,           //!< arg: msg id (once the write has returned)
+  ANT_TRACE_RTS,                //!< arg: 0, or 1 if there was no edge and the pin was read (ANT_RTS_TIMEOUT_MS). Clear to send (from the main loop, not the interrupt)
+  ANT_TRACE_RESPONSE,           //!< arg: msg id of the queued command that was answered
+  ANT_TRACE_HW_RESET,           //!< arg: 0
+  ANT_TRACE_SETUP_STEP,         //!< arg: ANT_TRACE_CHANNEL_ARG(channel, state_counter) -- the script offset for a script setup
+  ANT_TRACE_SETUP_ESTABLISH,    //!< arg: ANT_TRACE_CHANNEL_ARG(channel, ANT_CHANNEL_ESTABLISH)
+  ANT_TRACE_RETRY,              //!< arg: msg id of the command being resent (no response in ANT_RESPONSE_TIMEOUT_MS)
+  ANT_TRACE_SOFT_RESET,         //!< arg: 0
+  ANT_TRACE_START_UP_LOST,      //!< arg: 0. No MESG_START_UP but the module is clear to send -- carried on as if it had arrived
+  ANT_TRACE_CHANNEL_STATE,      //!< arg: ANT_TRACE_CHANNEL_ARG(channel, ANT_CHANNEL_STATE)
+
+  ANT_TRACE_EVENT_COUNT
+} ANT_TRACE_EVENT;
+
+//! Channel in the top 3 bits, value in the low 5
+#define ANT_TRACE_CHANNEL_ARG(channel, value) ((byte) ((((channel) & 0x07) << 5) | ((value) & 0x1F)))
+
+#if !defined(ANT_TRACE_RING_SIZE)
+#define ANT_TRACE_RING_SIZE (32) //!< Entries kept (the newest). Power of two, at most 128. 4 bytes each.
+#endif
+
+#if ((ANT_TRACE_RING_SIZE & (ANT_TRACE_RING_SIZE - 1)) != 0) || (ANT_TRACE_RING_SIZE > 128)
+#error "ANT_TRACE_RING_SIZE must be a power of two and no more than 128"
+#endif
+
+#if !defined(ANT_TRACE_EVENTS)
+#define ANT_TRACE_EVENTS (0xFFFFFFFFUL & ~(1UL << ANT_TRACE_RX_BYTE)) //!< Bit mask (1UL << ANT_TRACE_EVENT) of what is recorded. RX bytes would fill the ring in a frame.
+#endif
+
+typedef struct ANT_TraceEntry_struct
+{
+  unsigned int delta_us; //!< micros() since the previous entry (0xFFFF -- that or longer)
+  byte         event;    //!< ANT_TRACE_EVENT
+  byte         arg;
+} ANT_TraceEntry;
+
+//! Trace ring. Use the ANT_TraceRing typedef (on or off with ANTPLUS_TRACE).
+template <bool ENABLED>
+class ANT_TraceRingT
+{
+  public:
+    ANT_TraceRingT() : head(0), count(0), last_us(0) {};
+
+    template <ANT_TRACE_EVENT EVENT>
+    void record(byte arg)
+    {
+      if ((ANT_TRACE_EVENTS & (1UL << EVENT)) == 0)
+      {
+        return;
+      }
+      unsigned long now = micros();
+      unsigned long delta = now - last_us;
+      last_us = now;
+      ANT_TraceEntry & entry = entries[head];
+      entry.delta_us = (delta > 0xFFFF) ? 0xFFFF : delta;
+      entry.event = EVENT;
+      entry.arg = arg;
+      head = (head + 1) & (ANT_TRACE_RING_SIZE - 1);
+      if (count < ANT_TRACE_RING_SIZE)
+      {
+        count++;
+      }
+    };
+
+    //! Entries held (at most ANT_TRACE_RING_SIZE)
+    byte size() const {return count;};
+    //! index 0 is the oldest entry held
+    const ANT_TraceEntry & at(byte index) const {return entries[(head - count + index) & (ANT_TRACE_RING_SIZE - 1)];};
+    void clear() {count = 0;};
+
+    //! Oldest first, one entry per line: +<delta us> <event> <arg>
+    void dump(Print & out) const
+    {
+      static const char * const names[ANT_TRACE_EVENT_COUNT] =
+      {
+        "RX_BYTE", "FRAME", "CHECKSUM_FAIL", "SIZE_EXCEEDED", "RESYNC", "TIMEOUT_MIDMESSAGE",
+        "SEND_START", "SEND_END", "RTS", "RESPONSE", "HW_RESET", "SETUP_STEP", "SETUP_ESTABLISH",
+        "RETRY", "SOFT_RESET", "START_UP_LOST", "CHANNEL_STATE",
+      };
+      for (byte i = 0; i < count; i++)
+      {
+        const ANT_TraceEntry & entry = at(i);
+        out.print("+");
+        out.print(entry.delta_us);
+        out.print(" ");
+        out.print((entry.event < ANT_TRACE_EVENT_COUNT) ? names[entry.event] : "?");
+        if ((entry.event == ANT_TRACE_SETUP_STEP) || (entry.event == ANT_TRACE_SETUP_ESTABLISH) || (entry.event == ANT_TRACE_CHANNEL_STATE))
+        {
+          out.print(" ch ");
+          out.print(entry.arg >> 5);
+          out.print(" ");
+          out.println(entry.arg & 0x1F);
+        }
+        else
+        {
+          out.print(" 0x");
+          out.println(entry.arg, HEX);
+        }
+      }
+    };
+
+  private:
+    ANT_TraceEntry entries[ANT_TRACE_RING_SIZE];
+    byte           head;
+    byte           count;
+    unsigned long  last_us;
+};
+
+//! Tracing off -- every hook is empty
+template <>
+class ANT_TraceRingT<false>
+{
+  public:
+    template <ANT_TRACE_EVENT EVENT>
+    void record(byte) {};
+
+    byte size() const {return 0;};
+    const ANT_TraceEntry & at(byte) const {static const ANT_TraceEntry none = {0, 0, 0}; return none;};
+    void clear() {};
+    void dump(Print &) const {};
+};
+
+#if defined(ANTPLUS_TRACE)
+typedef ANT_TraceRingT<true>  ANT_TraceRing;
+#else
+typedef ANT_TraceRingT<false> ANT_TraceRing;
+#endif
+
+#endif //ANTPlus_Trace_h
@@ -27,6 +27,8 @@ Wiring to the Arduino Pro Mini 3v3 can be seen in 'antplus' below.
 
 //#define ANTPLUS_ON_HW_UART //!< H/w UART (i.e. Serial) instead of software serial. NOTE: There seems to be issues in not getting as many broadcast packets when using hardware serial.........
 
+//#define USE_GPS_CHANNEL //!< Also listen for a GPS (geocache) on its own network (GPS_NETWORK with ANT_GPS_NETWORK_KEY) and print its location
+
 
 #if !defined(ANTPLUS_ON_HW_UART)
 #include <SoftwareSerial.h>
@@ -34,6 +36,12 @@ Wiring to the Arduino Pro Mini 3v3 can be seen in 'antplus' below.
 
 #include <ANTPlus.h>
 
+#if defined(ANTPLUS_PAIRING)
+//The strap paired with is kept in EEPROM and searched for first after a power cycle
+#include <EEPROM.h>
+#include <ANTPlus_PairingEEPROM.h>
+#endif //defined(ANTPLUS_PAIRING)
+
 
 #define USE_SERIAL_CONSOLE //!<Use the hardware serial as the console. This needs to be off if using hardware serial for driving the ANT+ module.
 
@@ -90,8 +98,7 @@ Wiring to the Arduino Pro Mini 3v3 can be seen in 'antplus' below.
 // ****************************************************************************
 
 //Arduino Pro Mini pins to the nrf24AP2 modules pinouts
-static const int RTS_PIN      = 2; //!< RTS on the nRF24AP2 module
-static const int RTS_PIN_INT  = 0; //!< The interrupt equivalent of the RTS_PIN
+static const int RTS_PIN      = 2; //!< RTS on the nRF24AP2 module. Must be an interrupt pin (the library attaches to it in begin())
 
 
 #if !defined(ANTPLUS_ON_HW_UART)
@@ -104,6 +111,11 @@ static SoftwareSerial ant_serial(TX_PIN, RX_PIN); // RXArd, TXArd -- Arduino is
 
 static ANTPlus        antplus   = ANTPlus(RTS_PIN, 3/*SUSPEND*/, 4/*SLEEP*/, 5/*RESET*/ );
 
+#if defined(ANTPLUS_PAIRING)
+static ANTPairingEEPROM pairing_store( 0 /*EEPROM address*/ );
+static ANTPairingCache  pairing_cache;
+#endif //defined(ANTPLUS_PAIRING)
+
 //ANT Channel config for HRM
 static ANT_Channel hrm_channel =
 {
@@ -119,81 +131,63 @@ static ANT_Channel hrm_channel =
   0, //state_counter
 };
 
-volatile int rts_ant_received = 0; //!< ANT RTS interrupt flag see isr_rts_ant()
+#if defined(USE_GPS_CHANNEL)
+//ANT Channel config for GPS -- the keys are sent once per network, so more HRM channels would not send ANT_SENSOR_NETWORK_KEY again
+static ANT_Channel gps_channel =
+{
+  1, //Channel Number
+  GPS_NETWORK,
+  DEVCE_TIMEOUT,
+  DEVCE_TYPE_GPS,
+  DEVCE_GPS_FREQ,
+  DEVCE_GPS_RATE,
+  ANT_GPS_NETWORK_KEY,
+  ANT_CHANNEL_ESTABLISH_PROGRESSING,
+  FALSE,
+  0, //state_counter
+};
+#endif //defined(USE_GPS_CHANNEL)
 
 // **************************************************************************************************
-// *********************************  ISRs  *********************************************************
+// ***********************************  ANT+  *******************************************************
 // **************************************************************************************************
 
-//! Interrupt service routine to get RTS from ANT messages
-void isr_rts_ant()
+//! Called by the library (from readPacket()) for every HRM page on channels of DEVCE_TYPE_HRM
+static void heart_rate( const ANT_Channel * channel, byte computed_heart_rate, byte beat_count, unsigned int beat_time, void * context )
 {
-  rts_ant_received = 1;
+  SERIAL_DEBUG_PRINT_F( "CHAN " );
+  SERIAL_DEBUG_PRINT( channel->channel_number );
+  SERIAL_DEBUG_PRINT_F( " HR[any_page] : BPM = ");
+  SERIAL_DEBUG_PRINTLN( computed_heart_rate );
 }
 
-// **************************************************************************************************
-// ***********************************  ANT+  *******************************************************
-// **************************************************************************************************
+static const ANT_HRMSink hrm_sink = { heart_rate, NULL, NULL };
 
-void process_packet( ANT_Packet * packet )
+#if defined(USE_GPS_CHANNEL)
+//! Called by the library for each latitude or longitude page from the GPS
+static void gps_location( const ANT_Channel * channel, byte data_id, long semicircles, void * context )
+{
+  SERIAL_DEBUG_PRINT_F( "CHAN " );
+  SERIAL_DEBUG_PRINT( channel->channel_number );
+  SERIAL_DEBUG_PRINT( (data_id == GPS_DATA_ID_LATITUDE) ? F(" GPS : Latitude = ") : F(" GPS : Longitude = ") );
+  SERIAL_DEBUG_PRINTLN2( semicircles * (180.0 / 2147483648.0), 6 );
+}
+
+static const ANT_GPSSink gps_sink = { gps_location, NULL, NULL };
+#endif //defined(USE_GPS_CHANNEL)
+
+void process_packet( const ANT_Packet * packet )
 {
 #if defined(USE_SERIAL_CONSOLE) && defined(ANTPLUS_DEBUG)
   //This function internally uses Serial.println
   //Only use it if the console is available and if the ANTPLUS library is in debug mode
   antplus.printPacket( packet, false );
 #endif //defined(USE_SERIAL_CONSOLE) && defined(ANTPLUS_DEBUG)
-   
-  switch ( packet->msg_id )
+
+  //Broadcasts have already been routed to the channel (data_rx) and decoded into hrm_sink
+  if( packet->msg_id != MESG_BROADCAST_DATA_ID )
   {
-    case MESG_BROADCAST_DATA_ID:
-    {
-      const ANT_Broadcast * broadcast = (const ANT_Broadcast *) packet->data;
-      SERIAL_DEBUG_PRINT_F( "CHAN " );
-      SERIAL_DEBUG_PRINT( broadcast->channel_number );
-      SERIAL_DEBUG_PRINT_F( " " );
-      const ANT_DataPage * dp = (const ANT_DataPage *) broadcast->data;
-      
-      //Update received data
-      if( broadcast->channel_number == hrm_channel.channel_number )
-      {
-        hrm_channel.data_rx = true;
-        //To determine the device type -- and the data pages -- check channel setups
-        if(hrm_channel.device_type == DEVCE_TYPE_HRM)
-        {
-            switch(dp->data_page_number)
-            {
-              case DATA_PAGE_HEART_RATE_0:
-              case DATA_PAGE_HEART_RATE_0ALT:
-              case DATA_PAGE_HEART_RATE_1:
-              case DATA_PAGE_HEART_RATE_1ALT:
-              case DATA_PAGE_HEART_RATE_2:
-              case DATA_PAGE_HEART_RATE_2ALT:
-              case DATA_PAGE_HEART_RATE_3:
-              case DATA_PAGE_HEART_RATE_3ALT:
-              case DATA_PAGE_HEART_RATE_4:
-              case DATA_PAGE_HEART_RATE_4ALT:
-              {
-                //As we only care about the computed heart rate
-                // we use a same struct for all HRM pages
-                const ANT_HRMDataPage * hrm_dp = (const ANT_HRMDataPage *) dp;
-                SERIAL_DEBUG_PRINT_F( "HR[any_page] : BPM = ");
-                SERIAL_DEBUG_PRINTLN( hrm_dp->computed_heart_rate );
-              }
-              break;
-  
-              default:
-                  SERIAL_DEBUG_PRINT_F(" HRM DP# ");
-                  SERIAL_DEBUG_PRINTLN( dp->data_page_number );
-                break;
-            }
-        }
-    }
-    break;
-    }
-    
-    default:
-      SERIAL_DEBUG_PRINTLN_F("Non-broadcast data received.");
-      break;
+    SERIAL_DEBUG_PRINTLN_F("Non-broadcast data received.");
   }
 }
 
@@ -214,10 +208,8 @@ void setup()
 
   SERIAL_DEBUG_PRINTLN_F("ANT+ Config.");
 
-  //We setup an interrupt to detect when the RTS is received from the ANT chip.
-  //This is a 50 usec HIGH signal at the end of each valid ANT message received from the host at the chip
-  attachInterrupt(RTS_PIN_INT, isr_rts_ant, RISING);
-
+  //RTS from the ANT chip is a 50 usec HIGH signal at the end of each valid ANT message received from the host.
+  //begin() attaches an interrupt on RTS_PIN for it -- queued messages go out on the next library call once it is low again.
 
 #if defined(ANTPLUS_ON_HW_UART)
   //Using hardware UART
@@ -229,6 +221,17 @@ void setup()
   antplus.begin( ant_serial );
 #endif
 
+#if defined(ANTPLUS_PAIRING)
+  pairing_cache.begin( pairing_store );
+  antplus.setPairingCache( &pairing_cache );
+#endif //defined(ANTPLUS_PAIRING)
+  antplus.add_profile( &ant_profile_hrm, &hrm_sink );
+  antplus.add_channel( &hrm_channel );
+#if defined(USE_GPS_CHANNEL)
+  antplus.add_profile( &ant_profile_gps, &gps_sink );
+  antplus.add_channel( &gps_channel );
+#endif //defined(USE_GPS_CHANNEL)
+
   SERIAL_DEBUG_PRINTLN_F("ANT+ Config Finished.");
   SERIAL_DEBUG_PRINTLN_F("Setup Finished.");
 }
@@ -239,20 +242,11 @@ void setup()
 
 void loop()
 {
-  byte packet_buffer[ANT_MAX_PACKET_LEN];
-  ANT_Packet * packet = (ANT_Packet *) packet_buffer;
+  const ANT_Packet * packet; //Points into the ANTPlus frame buffer -- valid until the next read
   MESSAGE_READ ret_val = MESSAGE_READ_NONE;
   
-  if(rts_ant_received == 1)
-  {
-    SERIAL_DEBUG_PRINTLN_F("Received RTS Interrupt. ");
-    antplus.rTSHighAssertion();
-    //Clear the ISR flag
-    rts_ant_received = 0;
-  }
-
   //Read messages until we get a none
-  while( (ret_val = antplus.readPacket(packet, ANT_MAX_PACKET_LEN, 0 )) != MESSAGE_READ_NONE )
+  while( (ret_val = antplus.readPacket(&packet, 0 )) != MESSAGE_READ_NONE )
   {
     if((ret_val == MESSAGE_READ_EXPECTED) || (ret_val == MESSAGE_READ_OTHER))
     {
@@ -272,26 +266,14 @@ void loop()
     {
       SERIAL_DEBUG_PRINT_F( "ReadPacket Error = " );
       SERIAL_DEBUG_PRINTLN( ret_val );
-      if(ret_val == MESSAGE_READ_ERROR_MISSING_SYNC)
-      {
-        //Nothing -- allow a re-read to get back in sync
-      }
-      else
-      if(ret_val == MESSAGE_READ_ERROR_BAD_CHECKSUM)
-      {
-        //Nothing -- fully formed package just bit errors
-      }
-      else
-      {
-        break;
-      }
+      //Nothing -- the library has already skipped ahead to the next sync. Re-read to carry on.
     }
   }
 
 
   if(hrm_channel.channel_establish != ANT_CHANNEL_ESTABLISH_COMPLETE)
   {
-    antplus.progress_setup_channel( &hrm_channel );
+    antplus.progress_setup_channels();
     if(hrm_channel.channel_establish == ANT_CHANNEL_ESTABLISH_COMPLETE)
     {
       SERIAL_DEBUG_PRINT( hrm_channel.channel_number );
@@ -309,5 +291,12 @@ void loop()
       SERIAL_DEBUG_PRINTLN_F( " - ERROR!" );
     }
   }
+#if defined(USE_GPS_CHANNEL)
+  else
+  if(gps_channel.channel_establish == ANT_CHANNEL_ESTABLISH_PROGRESSING)
+  {
+    antplus.progress_setup_channels();
+  }
+#endif //defined(USE_GPS_CHANNEL)
 }
 
@@ -0,0 +1,91 @@
+//Copyright 2013 Brody Kenrick.
+//Host (Linux) stand-in for the parts of the Arduino core used by ANTPlus.
+//Lets the library build and run off target for benchmarks and simulation. See README.md in this directory.
+
+#ifndef ANTPlus_Host_Arduino_h
+#define ANTPlus_Host_Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+//glibc's LITTLE_ENDIAN (from <endian.h>, pulled in by <stdlib.h> and friends) would clash with the library's own in types.h.
+//Include it now -- whatever the tool included first -- and leave the name to the library (nothing here needs glibc's value).
+#include <endian.h>
+#undef LITTLE_ENDIAN
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH    (1)
+#define LOW     (0)
+
+#define INPUT   (0)
+#define OUTPUT  (1)
+
+#define CHANGE  (1)
+#define FALLING (2)
+#define RISING  (3)
+
+#define DEC     (10)
+#define HEX     (16)
+
+#define HOST_NUM_PINS (32)
+
+#define PROGMEM
+#define pgm_read_byte(address)  (*(const uint8_t *)(address))
+#define pgm_read_word(address)  (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_ptr(address)   (*(void * const *)(address))
+#define F(string)               (string)
+
+//! Any pin can interrupt on the host
+#define digitalPinToInterrupt(pin) (pin)
+
+//Clock -- simulated. Only moves when advanced (host_advance_micros()) or by delay()/delayMicroseconds().
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+
+void host_advance_micros(unsigned long us);
+void host_set_micros(unsigned long us);
+
+//GPIO -- outputs are recorded, inputs are driven by the host (host_set_pin())
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+//! Drive an input pin. Runs an attached ISR if the edge matches its mode (and interrupts are on).
+void host_set_pin(uint8_t pin, uint8_t value);
+
+//! Called after the clock moves or an output pin is written. Lets a simulated peripheral (e.g. SimulatedANTModule) keep up.
+//One hook at a time -- NULL to remove.
+void host_set_update_hook(void (*hook)(void * context), void * context);
+
+#include "Print.h"
+#include "Stream.h"
+
+//! Console -- writes to stdout
+class HostSerial : public Stream
+{
+  public:
+    void   begin(unsigned long /*baud*/) {};
+    int    available() {return 0;};
+    int    read()      {return -1;};
+    int    peek()      {return -1;};
+    void   flush()     {fflush(stdout);};
+    size_t write(uint8_t value) {return fwrite(&value, 1, 1, stdout);};
+    using Print::write;
+};
+
+extern HostSerial Serial;
+
+#endif //ANTPlus_Host_Arduino_h
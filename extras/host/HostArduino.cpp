@@ -0,0 +1,142 @@
+//Copyright 2013 Brody Kenrick.
+//Host (Linux) stand-in for the Arduino core -- simulated clock and GPIO
+
+#include "Arduino.h"
+
+HostSerial Serial;
+
+static unsigned long host_micros_now = 0;
+
+static uint8_t pin_level[HOST_NUM_PINS];
+static uint8_t pin_mode[HOST_NUM_PINS];
+
+static void (*pin_isr[HOST_NUM_PINS])(void);
+static int     pin_isr_mode[HOST_NUM_PINS];
+static boolean interrupts_enabled = true;
+
+static void (*update_hook)(void * context) = NULL;
+static void * update_hook_context = NULL;
+
+static void host_update()
+{
+  if (update_hook != NULL)
+  {
+    update_hook(update_hook_context);
+  }
+}
+
+void host_set_update_hook(void (*hook)(void * context), void * context)
+{
+  update_hook = hook;
+  update_hook_context = context;
+}
+
+unsigned long millis()
+{
+  return host_micros_now / 1000;
+}
+
+unsigned long micros()
+{
+  return host_micros_now;
+}
+
+void delay(unsigned long ms)
+{
+  host_micros_now += ms * 1000;
+  host_update();
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  host_micros_now += us;
+  host_update();
+}
+
+void host_advance_micros(unsigned long us)
+{
+  host_micros_now += us;
+  host_update();
+}
+
+void host_set_micros(unsigned long us)
+{
+  host_micros_now = us;
+  host_update();
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < HOST_NUM_PINS)
+  {
+    pin_mode[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin < HOST_NUM_PINS)
+  {
+    pin_level[pin] = value ? HIGH : LOW;
+    host_update();
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (pin < HOST_NUM_PINS)
+  {
+    return pin_level[pin];
+  }
+  return LOW;
+}
+
+//NOTE: digitalPinToInterrupt() is the identity on the host -- interrupt == pin
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode)
+{
+  if (interrupt < HOST_NUM_PINS)
+  {
+    pin_isr[interrupt] = isr;
+    pin_isr_mode[interrupt] = mode;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+  if (interrupt < HOST_NUM_PINS)
+  {
+    pin_isr[interrupt] = NULL;
+  }
+}
+
+void noInterrupts()
+{
+  interrupts_enabled = false;
+}
+
+void interrupts()
+{
+  interrupts_enabled = true;
+}
+
+void host_set_pin(uint8_t pin, uint8_t value)
+{
+  if (pin >= HOST_NUM_PINS)
+  {
+    return;
+  }
+  uint8_t previous = pin_level[pin];
+  pin_level[pin] = value ? HIGH : LOW;
+
+  if ((pin_isr[pin] == NULL) || !interrupts_enabled || (previous == pin_level[pin]))
+  {
+    return;
+  }
+  int mode = pin_isr_mode[pin];
+  if ((mode == CHANGE) ||
+      ((mode == RISING) && (pin_level[pin] == HIGH)) ||
+      ((mode == FALLING) && (pin_level[pin] == LOW)))
+  {
+    pin_isr[pin]();
+  }
+}
@@ -0,0 +1,47 @@
+//Copyright 2013 Brody Kenrick.
+//Host stand-in for the EEPROM pairing store -- the cache is kept in a file
+
+#ifndef ANTPlus_HostPairingFile_h
+#define ANTPlus_HostPairingFile_h
+
+#include <stdio.h>
+
+#include "ANTPlus_Pairing.h"
+
+//! The whole file is the store. A missing file is an empty cache.
+class HostPairingFile : public ANTPairingStore
+{
+  public:
+    explicit HostPairingFile(const char * path) : saves(0), path(path) {};
+
+    boolean load(byte * data, byte size)
+    {
+      FILE * file = fopen(path, "rb");
+      if (file == NULL)
+      {
+        return false;
+      }
+      boolean ok = (fread(data, 1, size, file) == size);
+      fclose(file);
+      return ok;
+    };
+
+    void save(const byte * data, byte size)
+    {
+      FILE * file = fopen(path, "wb");
+      if (file == NULL)
+      {
+        return;
+      }
+      fwrite(data, 1, size, file);
+      fclose(file);
+      saves++;
+    };
+
+    unsigned long saves; //!< Writes (each one would be an EEPROM write on the Arduino)
+
+  private:
+    const char * path;
+};
+
+#endif //ANTPlus_HostPairingFile_h
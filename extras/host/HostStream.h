@@ -0,0 +1,47 @@
+//Copyright 2013 Brody Kenrick.
+//Host Stream stand-in to connect ANTPlus to a buffer instead of a UART
+
+#ifndef ANTPlus_HostStream_h
+#define ANTPlus_HostStream_h
+
+#include <vector>
+
+#include "Arduino.h"
+
+//! Bytes given to inject() are what the library reads. Everything the library writes is kept in tx.
+class HostStream : public Stream
+{
+  public:
+    HostStream() : rx_pos(0) {};
+
+    void inject(const uint8_t * data, size_t size)
+    {
+      if (rx_pos == rx.size())
+      {
+        rx.clear();
+        rx_pos = 0;
+      }
+      rx.insert(rx.end(), data, data + size);
+    };
+
+    int available() {return (int)(rx.size() - rx_pos);};
+    int read()      {return (rx_pos < rx.size()) ? rx[rx_pos++] : -1;};
+    int peek()      {return (rx_pos < rx.size()) ? rx[rx_pos] : -1;};
+    void flush()    {};
+
+    size_t write(uint8_t value) {tx.push_back(value); return 1;};
+    size_t write(const uint8_t * buffer, size_t size)
+    {
+      tx.insert(tx.end(), buffer, buffer + size);
+      return size;
+    };
+    using Print::write;
+
+    std::vector<uint8_t> tx;
+
+  private:
+    std::vector<uint8_t> rx;
+    size_t rx_pos;
+};
+
+#endif //ANTPlus_HostStream_h
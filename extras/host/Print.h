@@ -0,0 +1,65 @@
+//Copyright 2013 Brody Kenrick.
+//Host stand-in for the Arduino Print class (the subset ANTPlus uses)
+
+#ifndef ANTPlus_Host_Print_h
+#define ANTPlus_Host_Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+class Print
+{
+  public:
+    virtual ~Print() {};
+
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t * buffer, size_t size)
+    {
+      size_t n = 0;
+      while (size--)
+      {
+        n += write(*buffer++);
+      }
+      return n;
+    };
+    size_t write(const char * str) {return write((const uint8_t *) str, strlen(str));};
+
+    size_t print(const char * str)                 {return write(str);};
+    size_t print(char value)                       {return write((uint8_t) value);};
+    size_t print(unsigned char value, int base = 10) {return print((unsigned long) value, base);};
+    size_t print(int value, int base = 10)           {return print((long) value, base);};
+    size_t print(unsigned int value, int base = 10)  {return print((unsigned long) value, base);};
+    size_t print(long value, int base = 10)
+    {
+      char buffer[24];
+      if (base == 16)
+      {
+        snprintf(buffer, sizeof(buffer), "%lX", (unsigned long) value);
+      }
+      else
+      {
+        snprintf(buffer, sizeof(buffer), "%ld", value);
+      }
+      return print((const char *) buffer);
+    };
+    size_t print(unsigned long value, int base = 10)
+    {
+      char buffer[24];
+      snprintf(buffer, sizeof(buffer), (base == 16) ? "%lX" : "%lu", value);
+      return print((const char *) buffer);
+    };
+    size_t print(double value, int digits = 2)
+    {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+      return print((const char *) buffer);
+    };
+
+    size_t println() {return write("\r\n");};
+    template <class T> size_t println(T value)           {size_t n = print(value);       return n + println();};
+    template <class T> size_t println(T value, int base) {size_t n = print(value, base); return n + println();};
+};
+
+#endif //ANTPlus_Host_Print_h
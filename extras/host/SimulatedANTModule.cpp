@@ -0,0 +1,718 @@
+//Copyright 2013 Brody Kenrick.
+//Simulated nRF24AP2 for the host build. See SimulatedANTModule.h
+
+#include "SimulatedANTModule.h"
+
+#define SIM_START_UP_HARDWARE_RESET (0x01) //!< START_UP reason -- reset line
+#define SIM_START_UP_COMMAND_RESET  (0x20) //!< START_UP reason -- MESG_SYSTEM_RESET_ID
+
+static unsigned long period_micros(unsigned int period)
+{
+  return (unsigned long) (((unsigned long long) period * 1000000ULL) / 32768ULL);
+}
+
+SimulatedANTModule::SimulatedANTModule(byte rts_pin, byte reset_pin, unsigned long baud_rate)
+{
+  this->rts_pin = rts_pin;
+  this->reset_pin = reset_pin;
+
+  byte_us = (10 * 1000000UL + baud_rate - 1) / baud_rate;
+  rts_delay_us = 50;
+  rts_width_us = 50;
+  response_delay_us = 200;
+  startup_us = 2000;
+  acquire_delay_us = 0;
+  fail_to_search_us = 2000000;
+  uart_buffer_size = 64;
+
+  broadcast_drop_probability = 0;
+  bit_error_rate = 0;
+  host_frame_drop_probability = 0;
+
+  host_frames = 0;
+  host_frames_bad = 0;
+  host_frames_dropped = 0;
+  broadcasts_sent = 0;
+  broadcasts_dropped = 0;
+  bytes_corrupted = 0;
+  uart_overruns = 0;
+  resets = 0;
+  network_keys_set = 0;
+
+  holding_reset = false;
+  in_reset = false;
+  seed(1);
+  rx_count = 0;
+  host_wire_free_us = 0;
+  module_wire_free_us = 0;
+  module_generation = 0;
+  memset(network_keyed, 0, sizeof(network_keyed));
+  for (int i = 0; i < SIM_ANT_NUMBER_CHANNELS; i++)
+  {
+    memset(&channels[i], 0, sizeof(channels[i]));
+    channels[i].state = SIM_CHANNEL_UNASSIGNED;
+    channels[i].sensor = -1;
+  }
+
+  host_set_pin(rts_pin, LOW);
+  host_set_update_hook(update_hook, this);
+}
+
+SimulatedANTModule::~SimulatedANTModule()
+{
+  host_set_update_hook(NULL, NULL);
+}
+
+int SimulatedANTModule::add_sensor(byte device_type, unsigned int device_number, byte transmission_type, byte freq, unsigned int period,
+                                   unsigned long phase_us, SimPageGenerator generator, void * context)
+{
+  SimSensor sensor;
+  sensor.device_type = device_type;
+  sensor.device_number = device_number;
+  sensor.transmission_type = transmission_type;
+  sensor.freq = freq;
+  sensor.period = period;
+  sensor.phase_us = phase_us;
+  sensor.in_range = true;
+  sensor.generator = generator;
+  sensor.context = context;
+  sensors.push_back(sensor);
+  return (int) sensors.size() - 1;
+}
+
+unsigned long SimulatedANTModule::sensor_message_micros(int sensor, unsigned long message_count)
+{
+  const SimSensor & s = sensors[sensor];
+  return s.phase_us + (unsigned long) (((unsigned long long) message_count * s.period * 1000000ULL) / 32768ULL);
+}
+
+//! First message sent by the sensor at or after after_us
+unsigned long SimulatedANTModule::next_message(int sensor, unsigned long after_us)
+{
+  const SimSensor & s = sensors[sensor];
+  if (after_us <= s.phase_us)
+  {
+    return 0;
+  }
+  unsigned long long count = ((unsigned long long) (after_us - s.phase_us) * 32768ULL) / ((unsigned long long) s.period * 1000000ULL);
+  while (sensor_message_micros(sensor, (unsigned long) count) < after_us)
+  {
+    count++;
+  }
+  return (unsigned long) count;
+}
+
+//! Page 4 of the HRM profile. Beats are evenly spaced at the heart rate.
+void SimulatedANTModule::hrm_page(byte page[8], unsigned long message_count, unsigned int period, void * context)
+{
+  unsigned long bpm = (context != NULL) ? *(const unsigned int *) context : 60;
+  unsigned long long now_1024 = ((unsigned long long) message_count * period * 1024ULL) / 32768ULL;
+  unsigned long long beats = (now_1024 * bpm) / (60ULL * 1024ULL);
+  unsigned int beat_time = (unsigned int) ((beats * 60ULL * 1024ULL) / bpm);
+  unsigned int previous_beat_time = (beats > 0) ? (unsigned int) (((beats - 1) * 60ULL * 1024ULL) / bpm) : 0;
+
+  //Page number toggle bit changes every 4 messages
+  page[0] = 0x04 | (((message_count / 4) & 1) << 7);
+  page[1] = 0xFF; //Manufacturer specific
+  page[2] = previous_beat_time & 0xFF;
+  page[3] = (previous_beat_time >> 8) & 0xFF;
+  page[4] = beat_time & 0xFF;
+  page[5] = (beat_time >> 8) & 0xFF;
+  page[6] = beats & 0xFF;
+  page[7] = bpm;
+}
+
+void SimulatedANTModule::seed(unsigned long value)
+{
+  //Spread small seeds over the state so the first few draws are not all tiny
+  random_state = (uint32_t) ((value + 1) * 2654435761UL) ^ 0x9E3779B9UL;
+  if (random_state == 0)
+  {
+    random_state = 1;
+  }
+  for (int i = 0; i < 8; i++)
+  {
+    random_unit();
+  }
+}
+
+double SimulatedANTModule::random_unit()
+{
+  //xorshift32
+  uint32_t x = (uint32_t) random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  random_state = x;
+  return x / 4294967296.0;
+}
+
+void SimulatedANTModule::update_hook(void * context)
+{
+  ((SimulatedANTModule *) context)->update();
+}
+
+void SimulatedANTModule::update()
+{
+  unsigned long now = micros();
+
+  //Reset line is driven by the library (see ANTPlus::hardwareReset())
+  if (digitalRead(reset_pin) == LOW)
+  {
+    if (!holding_reset)
+    {
+      holding_reset = true;
+      enter_reset();
+    }
+  }
+  else if (holding_reset)
+  {
+    holding_reset = false;
+    byte reason = SIM_START_UP_HARDWARE_RESET;
+    schedule(now + startup_us, SIM_EVENT_START_UP, 0, &reason);
+  }
+
+  //An event can run an ISR that moves the clock and comes back in here -- each event is removed before it runs
+  while (!events.empty() && (events.begin()->first <= now))
+  {
+    unsigned long at_us = events.begin()->first;
+    SimEvent event = events.begin()->second;
+    events.erase(events.begin());
+    run_event(at_us, event);
+  }
+  deliver();
+}
+
+void SimulatedANTModule::schedule(unsigned long at_us, SIM_EVENT type, byte channel, const byte * frame)
+{
+  SimEvent event;
+  event.type = type;
+  event.channel = channel;
+  event.generation = (type == SIM_EVENT_CHANNEL_SLOT) ? channels[channel].generation : module_generation;
+  if (frame != NULL)
+  {
+    memcpy(event.frame, frame, (type == SIM_EVENT_HOST_FRAME) ? (frame[1] + MESG_FRAME_SIZE) : 1);
+  }
+  events.insert(std::make_pair(at_us, event));
+}
+
+void SimulatedANTModule::set_rts(boolean high)
+{
+  host_set_pin(rts_pin, high ? HIGH : LOW);
+}
+
+void SimulatedANTModule::run_event(unsigned long at_us, const SimEvent & event)
+{
+  if (event.type == SIM_EVENT_CHANNEL_SLOT)
+  {
+    if (event.generation == channels[event.channel].generation)
+    {
+      channel_slot(at_us, event.channel);
+    }
+    return;
+  }
+  if (event.generation != module_generation)
+  {
+    //Lost in a reset
+    return;
+  }
+  switch (event.type)
+  {
+    case SIM_EVENT_HOST_FRAME:
+      host_frame(at_us, event.frame);
+      break;
+    case SIM_EVENT_RTS_HIGH:
+      set_rts(true);
+      break;
+    case SIM_EVENT_RTS_LOW:
+      set_rts(false);
+      break;
+    case SIM_EVENT_START_UP:
+      in_reset = false;
+      send_to_host(at_us, MESG_START_UP, event.frame, 1);
+      set_rts(false);
+      break;
+    default:
+      break;
+  }
+}
+
+//! Move bytes that have finished arriving into the host's receive buffer
+void SimulatedANTModule::deliver()
+{
+  unsigned long now = micros();
+  while (!wire.empty() && (wire.front().first <= now))
+  {
+    if (uart.size() < uart_buffer_size)
+    {
+      uart.push_back(wire.front().second);
+    }
+    else
+    {
+      uart_overruns++;
+    }
+    wire.pop_front();
+  }
+}
+
+void SimulatedANTModule::send_to_host(unsigned long at_us, byte msg_id, const byte * data, byte size)
+{
+  if (in_reset)
+  {
+    return;
+  }
+  byte frame[MESG_MAX_SIZE];
+  frame[0] = MESG_TX_SYNC;
+  frame[1] = size;
+  frame[2] = msg_id;
+  byte checksum = MESG_TX_SYNC ^ size ^ msg_id;
+  for (byte i = 0; i < size; i++)
+  {
+    frame[3 + i] = data[i];
+    checksum ^= data[i];
+  }
+  frame[3 + size] = checksum;
+
+  unsigned long t = (at_us > module_wire_free_us) ? at_us : module_wire_free_us;
+  for (byte i = 0; i < size + MESG_FRAME_SIZE; i++)
+  {
+    byte value = frame[i];
+    if ((bit_error_rate > 0) && (random_unit() < 8 * bit_error_rate))
+    {
+      value ^= 1 << (byte) (random_unit() * 8);
+      bytes_corrupted++;
+    }
+    t += byte_us;
+    wire.push_back(std::make_pair(t, value));
+  }
+  module_wire_free_us = t;
+}
+
+void SimulatedANTModule::send_response(unsigned long at_us, byte channel, byte msg_id, byte code)
+{
+  byte data[MESG_RESPONSE_EVENT_SIZE] = {channel, msg_id, code};
+  send_to_host(at_us, MESG_RESPONSE_EVENT_ID, data, sizeof(data));
+}
+
+//! Module state is lost. RTS is held high until START_UP.
+void SimulatedANTModule::enter_reset()
+{
+  resets++;
+  in_reset = true;
+  module_generation++;
+  rx_count = 0;
+  wire.clear();
+  module_wire_free_us = micros();
+  memset(network_keyed, 0, sizeof(network_keyed));
+  for (int i = 0; i < SIM_ANT_NUMBER_CHANNELS; i++)
+  {
+    unsigned long generation = channels[i].generation + 1;
+    memset(&channels[i], 0, sizeof(channels[i]));
+    channels[i].state = SIM_CHANNEL_UNASSIGNED;
+    channels[i].sensor = -1;
+    channels[i].generation = generation;
+  }
+  set_rts(true);
+}
+
+int SimulatedANTModule::available()
+{
+  update();
+  return (int) uart.size();
+}
+
+int SimulatedANTModule::read()
+{
+  update();
+  if (uart.empty())
+  {
+    return -1;
+  }
+  byte value = uart.front();
+  uart.pop_front();
+  return value;
+}
+
+int SimulatedANTModule::peek()
+{
+  update();
+  return uart.empty() ? -1 : uart.front();
+}
+
+size_t SimulatedANTModule::write(const uint8_t * buffer, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+  {
+    write(buffer[i]);
+  }
+  return size;
+}
+
+//! Bytes from the host. Each one takes a byte time on the wire -- the frame is handled when the last one arrives.
+size_t SimulatedANTModule::write(uint8_t value)
+{
+  update();
+  unsigned long now = micros();
+  host_wire_free_us = ((now > host_wire_free_us) ? now : host_wire_free_us) + byte_us;
+  if (in_reset)
+  {
+    return 1;
+  }
+
+  if ((rx_count == 0) && (value != MESG_TX_SYNC))
+  {
+    return 1;
+  }
+  rx_frame[rx_count++] = value;
+  if ((rx_count == 2) && (value > MESG_MAX_DATA_SIZE))
+  {
+    rx_count = 0;
+    return 1;
+  }
+  if ((rx_count > 2) && (rx_count == rx_frame[1] + MESG_FRAME_SIZE))
+  {
+    rx_count = 0;
+    if ((host_frame_drop_probability > 0) && (random_unit() < host_frame_drop_probability))
+    {
+      host_frames_dropped++;
+      return 1;
+    }
+    schedule(host_wire_free_us, SIM_EVENT_HOST_FRAME, 0, rx_frame);
+  }
+  return 1;
+}
+
+void SimulatedANTModule::host_frame(unsigned long at_us, const byte * frame)
+{
+  host_frames++;
+  byte size = frame[1];
+  byte checksum = 0;
+  for (byte i = 0; i < size + MESG_FRAME_SIZE; i++)
+  {
+    checksum ^= frame[i];
+  }
+  if (checksum != 0)
+  {
+    //Ignored -- no reply and no RTS
+    host_frames_bad++;
+    return;
+  }
+
+  schedule(at_us + rts_delay_us, SIM_EVENT_RTS_HIGH, 0);
+  schedule(at_us + rts_delay_us + rts_width_us, SIM_EVENT_RTS_LOW, 0);
+  command(at_us + response_delay_us, frame[2], frame + 3, size);
+}
+
+void SimulatedANTModule::command(unsigned long at_us, byte msg_id, const byte * data, byte size)
+{
+  byte channel_number = (size > 0) ? data[0] : 0;
+  SimChannel * channel = (channel_number < SIM_ANT_NUMBER_CHANNELS) ? &channels[channel_number] : NULL;
+  byte code = RESPONSE_NO_ERROR;
+
+  switch (msg_id)
+  {
+    case MESG_SYSTEM_RESET_ID:
+    {
+      enter_reset();
+      byte reason = SIM_START_UP_COMMAND_RESET;
+      schedule(at_us + startup_us, SIM_EVENT_START_UP, 0, &reason);
+      return;
+    }
+
+    case MESG_REQUEST_ID:
+      if (size >= 2)
+      {
+        if (data[1] == MESG_CAPABILITIES_ID)
+        {
+          byte reply[MESG_CAPABILITIES_SIZE] = {SIM_ANT_NUMBER_CHANNELS, SIM_ANT_NUMBER_NETWORKS, 0, 0};
+          send_to_host(at_us, MESG_CAPABILITIES_ID, reply, sizeof(reply));
+          return;
+        }
+        if ((data[1] == MESG_CHANNEL_ID_ID) && (channel != NULL))
+        {
+          unsigned int device_number = channel->device_number;
+          byte device_type = channel->device_type;
+          byte transmission_type = channel->transmission_type;
+          if ((channel->state == SIM_CHANNEL_TRACKING) && (channel->sensor >= 0))
+          {
+            device_number = sensors[channel->sensor].device_number;
+            device_type = sensors[channel->sensor].device_type;
+            transmission_type = sensors[channel->sensor].transmission_type;
+          }
+          byte reply[MESG_CHANNEL_ID_SIZE] = {channel_number, (byte) (device_number & 0xFF), (byte) (device_number >> 8), device_type, transmission_type};
+          send_to_host(at_us, MESG_CHANNEL_ID_ID, reply, sizeof(reply));
+          return;
+        }
+        if ((data[1] == MESG_CHANNEL_STATUS_ID) && (channel != NULL))
+        {
+          byte reply[MESG_CHANNEL_STATUS_SIZE] = {channel_number, (byte) channel->state};
+          send_to_host(at_us, MESG_CHANNEL_STATUS_ID, reply, sizeof(reply));
+          return;
+        }
+      }
+      code = INVALID_MESSAGE;
+      break;
+
+    case MESG_NETWORK_KEY_ID:
+      code = ((size >= 9) && (data[0] < SIM_ANT_NUMBER_NETWORKS)) ? RESPONSE_NO_ERROR : INVALID_MESSAGE;
+      if (code == RESPONSE_NO_ERROR)
+      {
+        network_keyed[data[0]] = true;
+        network_keys_set++;
+      }
+      break;
+
+    case MESG_RADIO_TX_POWER_ID:
+      code = (size >= 2) ? RESPONSE_NO_ERROR : INVALID_MESSAGE;
+      break;
+
+    case MESG_ASSIGN_CHANNEL_ID:
+      if ((channel == NULL) || (size < 3) || (data[2] >= SIM_ANT_NUMBER_NETWORKS))
+      {
+        code = INVALID_MESSAGE;
+      }
+      else if (channel->state != SIM_CHANNEL_UNASSIGNED)
+      {
+        code = CHANNEL_IN_WRONG_STATE;
+      }
+      else
+      {
+        channel->state = SIM_CHANNEL_ASSIGNED;
+        channel->type = data[1];
+        channel->network = data[2];
+      }
+      break;
+
+    case MESG_UNASSIGN_CHANNEL_ID:
+      if (channel == NULL)
+      {
+        code = INVALID_MESSAGE;
+      }
+      else if (channel->state != SIM_CHANNEL_ASSIGNED)
+      {
+        code = CHANNEL_IN_WRONG_STATE;
+      }
+      else
+      {
+        channel->state = SIM_CHANNEL_UNASSIGNED;
+      }
+      break;
+
+    case MESG_CHANNEL_ID_ID:
+    case MESG_CHANNEL_SEARCH_TIMEOUT_ID:
+    case MESG_CHANNEL_RADIO_FREQ_ID:
+    case MESG_CHANNEL_MESG_PERIOD_ID:
+    {
+      byte needed = (msg_id == MESG_CHANNEL_ID_ID) ? 5 : ((msg_id == MESG_CHANNEL_MESG_PERIOD_ID) ? 3 : 2);
+      if ((channel == NULL) || (size < needed))
+      {
+        code = INVALID_MESSAGE;
+      }
+      else if (channel->state == SIM_CHANNEL_UNASSIGNED)
+      {
+        code = CHANNEL_IN_WRONG_STATE;
+      }
+      else if (msg_id == MESG_CHANNEL_ID_ID)
+      {
+        channel->device_number = data[1] | (data[2] << 8);
+        channel->device_type = data[3];
+        channel->transmission_type = data[4];
+      }
+      else if (msg_id == MESG_CHANNEL_SEARCH_TIMEOUT_ID)
+      {
+        channel->search_timeout = data[1];
+      }
+      else if (msg_id == MESG_CHANNEL_RADIO_FREQ_ID)
+      {
+        channel->freq = data[1];
+      }
+      else
+      {
+        channel->period = data[1] | (data[2] << 8);
+      }
+      break;
+    }
+
+    case MESG_OPEN_CHANNEL_ID:
+      if (channel == NULL)
+      {
+        code = INVALID_MESSAGE;
+      }
+      else if ((channel->state != SIM_CHANNEL_ASSIGNED) || (channel->period == 0))
+      {
+        code = CHANNEL_IN_WRONG_STATE;
+      }
+      else
+      {
+        channel->state = SIM_CHANNEL_SEARCHING;
+        channel->sensor = -1;
+        channel->search_start_us = at_us;
+        channel->generation++;
+        schedule(at_us, SIM_EVENT_CHANNEL_SLOT, channel_number);
+      }
+      break;
+
+    case MESG_CLOSE_CHANNEL_ID:
+      if (channel == NULL)
+      {
+        code = INVALID_MESSAGE;
+      }
+      else if ((channel->state != SIM_CHANNEL_SEARCHING) && (channel->state != SIM_CHANNEL_TRACKING))
+      {
+        code = CHANNEL_IN_WRONG_STATE;
+      }
+      else
+      {
+        send_response(at_us, channel_number, msg_id, RESPONSE_NO_ERROR);
+        close_channel(at_us, channel_number);
+        return;
+      }
+      break;
+
+    default:
+      code = INVALID_MESSAGE;
+      break;
+  }
+  send_response(at_us, channel_number, msg_id, code);
+}
+
+void SimulatedANTModule::close_channel(unsigned long at_us, byte channel_number)
+{
+  SimChannel & channel = channels[channel_number];
+  channel.state = SIM_CHANNEL_ASSIGNED;
+  channel.sensor = -1;
+  channel.generation++;
+  send_response(at_us, channel_number, MESG_EVENT_ID, EVENT_CHANNEL_CLOSED);
+}
+
+//! Sensor matching the channel id (0 is a wildcard) on the same frequency. The channel period must be a multiple of the sensor's.
+//Nothing is found on a network without a key (the key's value is not checked).
+//With several matching (e.g. a wildcard among many straps) it is whichever is heard first -- one at random.
+int SimulatedANTModule::find_sensor(const SimChannel & channel)
+{
+  if (!network_keyed[channel.network])
+  {
+    return -1;
+  }
+  std::vector<int> matching;
+  for (size_t i = 0; i < sensors.size(); i++)
+  {
+    const SimSensor & sensor = sensors[i];
+    if (sensor.in_range &&
+        (sensor.freq == channel.freq) &&
+        ((channel.period % sensor.period) == 0) &&
+        ((channel.device_number == 0) || (channel.device_number == sensor.device_number)) &&
+        ((channel.device_type == 0) || (channel.device_type == sensor.device_type)) &&
+        ((channel.transmission_type == 0) || (channel.transmission_type == sensor.transmission_type)))
+    {
+      matching.push_back((int) i);
+    }
+  }
+  if (matching.empty())
+  {
+    return -1;
+  }
+  if (matching.size() == 1)
+  {
+    return matching[0];
+  }
+  return matching[(size_t) (random_unit() * matching.size())];
+}
+
+//! A searching channel looks for a sensor every channel period. Once one is picked it listens for that sensor's messages.
+void SimulatedANTModule::channel_slot(unsigned long at_us, byte channel_number)
+{
+  SimChannel & channel = channels[channel_number];
+
+  if (channel.state == SIM_CHANNEL_SEARCHING)
+  {
+    if ((channel.search_timeout != 0xFF) &&
+        ((at_us - channel.search_start_us) >= channel.search_timeout * SIM_ANT_SEARCH_TIMEOUT_UNIT_US))
+    {
+      send_response(at_us, channel_number, MESG_EVENT_ID, EVENT_RX_SEARCH_TIMEOUT);
+      close_channel(at_us, channel_number);
+      return;
+    }
+    if (channel.sensor < 0)
+    {
+      channel.sensor = find_sensor(channel);
+      if (channel.sensor < 0)
+      {
+        schedule(at_us + period_micros(channel.period), SIM_EVENT_CHANNEL_SLOT, channel_number);
+      }
+      else
+      {
+        channel.message_count = next_message(channel.sensor, at_us + acquire_delay_us);
+        schedule(sensor_message_micros(channel.sensor, channel.message_count), SIM_EVENT_CHANNEL_SLOT, channel_number);
+      }
+      return;
+    }
+  }
+
+  const SimSensor & sensor = sensors[channel.sensor];
+  boolean dropped = (broadcast_drop_probability > 0) && (random_unit() < broadcast_drop_probability);
+  if (sensor.in_range && !dropped)
+  {
+    channel_receive(at_us, channel_number);
+  }
+  else
+  {
+    channel_missed(at_us, channel_number);
+  }
+}
+
+void SimulatedANTModule::channel_receive(unsigned long at_us, byte channel_number)
+{
+  SimChannel & channel = channels[channel_number];
+  const SimSensor & sensor = sensors[channel.sensor];
+
+  byte data[MESG_DATA_SIZE];
+  data[0] = channel_number;
+  if (sensor.generator != NULL)
+  {
+    sensor.generator(data + 1, channel.message_count, sensor.period, sensor.context);
+  }
+  else
+  {
+    //Message count -- little endian
+    memset(data + 1, 0, 8);
+    for (byte i = 0; i < 4; i++)
+    {
+      data[1 + i] = (channel.message_count >> (8 * i)) & 0xFF;
+    }
+  }
+  send_to_host(at_us, MESG_BROADCAST_DATA_ID, data, sizeof(data));
+  broadcasts_sent++;
+
+  channel.state = SIM_CHANNEL_TRACKING;
+  channel.last_rx_us = at_us;
+  channel.message_count += channel.period / sensor.period;
+  schedule(sensor_message_micros(channel.sensor, channel.message_count), SIM_EVENT_CHANNEL_SLOT, channel_number);
+}
+
+void SimulatedANTModule::channel_missed(unsigned long at_us, byte channel_number)
+{
+  SimChannel & channel = channels[channel_number];
+  broadcasts_dropped++;
+
+  if (channel.state == SIM_CHANNEL_SEARCHING)
+  {
+    //Not acquired yet -- look again
+    channel.sensor = -1;
+    schedule(at_us + period_micros(channel.period), SIM_EVENT_CHANNEL_SLOT, channel_number);
+    return;
+  }
+
+  send_response(at_us, channel_number, MESG_EVENT_ID, EVENT_RX_FAIL);
+  if ((at_us - channel.last_rx_us) >= fail_to_search_us)
+  {
+    send_response(at_us, channel_number, MESG_EVENT_ID, EVENT_RX_FAIL_GO_TO_SEARCH);
+    channel.state = SIM_CHANNEL_SEARCHING;
+    channel.search_start_us = at_us;
+    channel.sensor = -1;
+    schedule(at_us + period_micros(channel.period), SIM_EVENT_CHANNEL_SLOT, channel_number);
+    return;
+  }
+  channel.message_count += channel.period / sensors[channel.sensor].period;
+  schedule(sensor_message_micros(channel.sensor, channel.message_count), SIM_EVENT_CHANNEL_SLOT, channel_number);
+}
@@ -0,0 +1,192 @@
+//Copyright 2013 Brody Kenrick.
+//Simulated nRF24AP2 for the host build -- stands in for the module at the other end of the UART.
+//
+//Consumes the host's frames and answers them (RESPONSE_EVENT, CAPABILITIES, CHANNEL_ID, CHANNEL_STATUS, START_UP)
+//with the UART bytes spaced at the baud rate. RTS is pulsed on the RTS pin after each message (and held high
+//through a reset), the reset pin is watched for hardware resets, and open channels search for and track
+//simulated sensors that broadcast at their channel period.
+//Faults: dropped broadcasts (EVENT_RX_FAIL), bit errors on the UART, host frames the module never sees,
+//and the host's UART receive buffer overrunning.
+//
+//Everything runs off the simulated clock (see Arduino.h) -- the module catches up whenever the clock moves.
+
+#ifndef ANTPlus_SimulatedANTModule_h
+#define ANTPlus_SimulatedANTModule_h
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "Arduino.h"
+
+#include "antdefines.h"
+#include "antmessage.h"
+
+#define SIM_ANT_NUMBER_CHANNELS (8)
+#define SIM_ANT_NUMBER_NETWORKS (3)
+
+#define SIM_ANT_SEARCH_TIMEOUT_UNIT_US (2500000UL) //!< Search timeout is in 2.5 s units (255 = never)
+
+//! Fills the 8 byte payload of a broadcast. message_count is the sensor's own count of messages sent (period in 1/32768 s).
+typedef void (*SimPageGenerator)(byte page[8], unsigned long message_count, unsigned int period, void * context);
+
+typedef struct
+{
+  byte          device_type;
+  unsigned int  device_number;
+  byte          transmission_type;
+  byte          freq;
+  unsigned int  period;     //!< 1/32768 s
+  unsigned long phase_us;   //!< Time of message 0
+  boolean       in_range;
+  SimPageGenerator generator;
+  void *        context;
+} SimSensor;
+
+//Matches the channel state in a CHANNEL_STATUS response
+typedef enum
+{
+  SIM_CHANNEL_UNASSIGNED = 0,
+  SIM_CHANNEL_ASSIGNED   = 1,
+  SIM_CHANNEL_SEARCHING  = 2,
+  SIM_CHANNEL_TRACKING   = 3,
+} SIM_CHANNEL_STATE;
+
+typedef struct
+{
+  SIM_CHANNEL_STATE state;
+  byte          type;
+  byte          network;
+  unsigned int  device_number;     //!< 0 is a wildcard
+  byte          device_type;       //!< 0 is a wildcard
+  byte          transmission_type; //!< 0 is a wildcard
+  byte          search_timeout;
+  byte          freq;
+  unsigned int  period;
+  int           sensor;            //!< Sensor being acquired/tracked (-1 for none)
+  unsigned long message_count;     //!< Next sensor message this channel will listen for
+  unsigned long search_start_us;
+  unsigned long last_rx_us;
+  unsigned long generation;        //!< Bumped on open/close/reset so stale slots are ignored
+} SimChannel;
+
+typedef enum
+{
+  SIM_EVENT_HOST_FRAME,
+  SIM_EVENT_RTS_HIGH,
+  SIM_EVENT_RTS_LOW,
+  SIM_EVENT_START_UP,
+  SIM_EVENT_CHANNEL_SLOT,
+} SIM_EVENT;
+
+typedef struct
+{
+  SIM_EVENT     type;
+  byte          channel;
+  unsigned long generation;
+  byte          frame[MESG_MAX_SIZE];
+} SimEvent;
+
+class SimulatedANTModule : public Stream
+{
+  public:
+    //! Registers itself as the host update hook (see host_set_update_hook()). Only one module at a time.
+    SimulatedANTModule(byte rts_pin, byte reset_pin, unsigned long baud_rate = 9600);
+    ~SimulatedANTModule();
+
+    //! Returns the sensor index. Sensors start in range with a message at phase_us.
+    int  add_sensor(byte device_type, unsigned int device_number, byte transmission_type, byte freq, unsigned int period,
+                    unsigned long phase_us, SimPageGenerator generator = NULL, void * context = NULL);
+    void set_sensor_in_range(int sensor, boolean in_range) {sensors[sensor].in_range = in_range;};
+    //! Time the sensor sent message message_count -- for broadcast-to-application latency
+    unsigned long sensor_message_micros(int sensor, unsigned long message_count);
+    const SimChannel & channel(byte channel_number) {return channels[channel_number];};
+
+    //! HRM page 4 (toggling page number). context is a const unsigned int * heart rate in bpm.
+    static void hrm_page(byte page[8], unsigned long message_count, unsigned int period, void * context);
+
+    void seed(unsigned long value);
+    //! Catch up to the current time. Called by the update hook and by every Stream call.
+    void update();
+
+    //Stream -- the module's end of the UART. read()/available() see the host's receive buffer.
+    int    available();
+    int    read();
+    int    peek();
+    void   flush() {};
+    size_t write(uint8_t value);
+    size_t write(const uint8_t * buffer, size_t size);
+    using Print::write;
+
+    //Timing
+    unsigned long byte_us;            //!< 10 bits at the baud rate
+    unsigned long rts_delay_us;       //!< End of a host frame to RTS high
+    unsigned long rts_width_us;       //!< RTS pulse
+    unsigned long response_delay_us;  //!< End of a host frame to the first byte of the reply
+    unsigned long startup_us;         //!< Reset released to START_UP
+    unsigned long acquire_delay_us;   //!< Search time before a sensor in range can be picked up
+    unsigned long fail_to_search_us;  //!< Time without a message before EVENT_RX_FAIL_GO_TO_SEARCH
+    unsigned int  uart_buffer_size;   //!< Host receive buffer (64 for HardwareSerial/SoftwareSerial)
+
+    //Faults
+    double broadcast_drop_probability;
+    double bit_error_rate;               //!< Per bit sent to the host
+    double host_frame_drop_probability;  //!< Host frames lost on the way to the module (no reply, no RTS)
+
+    //Counters
+    unsigned long host_frames;
+    unsigned long host_frames_bad;
+    unsigned long host_frames_dropped;
+    unsigned long broadcasts_sent;
+    unsigned long broadcasts_dropped;
+    unsigned long bytes_corrupted;
+    unsigned long uart_overruns;
+    unsigned long resets;
+    unsigned long network_keys_set;     //!< MESG_NETWORK_KEY_ID accepted
+
+  private:
+    static void update_hook(void * context);
+
+    double random_unit();
+    void   schedule(unsigned long at_us, SIM_EVENT type, byte channel, const byte * frame = NULL);
+    void   set_rts(boolean high);
+    void   run_event(unsigned long at_us, const SimEvent & event);
+    void   deliver();
+    void   send_to_host(unsigned long at_us, byte msg_id, const byte * data, byte size);
+    void   send_response(unsigned long at_us, byte channel, byte msg_id, byte code);
+
+    void   enter_reset();
+    void   host_frame(unsigned long at_us, const byte * frame);
+    void   command(unsigned long at_us, byte msg_id, const byte * data, byte size);
+    void   close_channel(unsigned long at_us, byte channel_number);
+    void   channel_slot(unsigned long at_us, byte channel_number);
+    void   channel_receive(unsigned long at_us, byte channel_number);
+    void   channel_missed(unsigned long at_us, byte channel_number);
+    int    find_sensor(const SimChannel & channel);
+    unsigned long next_message(int sensor, unsigned long after_us);
+
+    byte          rts_pin;
+    byte          reset_pin;
+    boolean       holding_reset;  //!< Reset line low
+    boolean       in_reset;       //!< Reset line low or starting up
+    unsigned long random_state;
+
+    //Host to module
+    byte          rx_frame[MESG_MAX_SIZE];
+    byte          rx_count;
+    unsigned long host_wire_free_us;
+
+    //Module to host
+    std::deque< std::pair<unsigned long, byte> > wire;
+    unsigned long module_wire_free_us;
+    std::deque<byte> uart;
+
+    std::multimap<unsigned long, SimEvent> events;
+    unsigned long module_generation;
+
+    SimChannel             channels[SIM_ANT_NUMBER_CHANNELS];
+    boolean                network_keyed[SIM_ANT_NUMBER_NETWORKS]; //!< A key has been set since the last reset
+    std::vector<SimSensor> sensors;
+};
+
+#endif //ANTPlus_SimulatedANTModule_h
@@ -0,0 +1,18 @@
+//Copyright 2013 Brody Kenrick.
+//Host stand-in for the Arduino Stream class
+
+#ifndef ANTPlus_Host_Stream_h
+#define ANTPlus_Host_Stream_h
+
+#include "Print.h"
+
+class Stream : public Print
+{
+  public:
+    virtual int  available() = 0;
+    virtual int  read() = 0;
+    virtual int  peek() = 0;
+    virtual void flush() = 0;
+};
+
+#endif //ANTPlus_Host_Stream_h
@@ -0,0 +1,554 @@
+//Copyright 2013 Brody Kenrick.
+//Offline analyzer for raw ANT UART captures (the bytes exactly as they came from the module). See README.md in this directory.
+//
+//  analyze_capture [--threads N] [--chunk-mb N] [--period N] FILE...
+//
+//Each file is memory mapped (so files larger than RAM stream through the page cache) and cut into chunks that are
+//framed in parallel with the library's rules (MESG_TX_SYNC, length byte checked against ANT_MAX_PACKET_LEN, XOR checksum,
+//resync on the byte after a bad sync). The sync scan is memchr(), which libc vectorises.
+//
+//A chunk locks on at the first sync that starts two good frames in a row and frames everything that starts before its end.
+//Where that lock does not land where the previous chunk finished, the chunk is framed again from there so the totals
+//are exactly those of a single pass over the file.
+//
+//Channel events and data are attributed to the device type the module last reported for that channel (CHANNEL_ID responses).
+//Each chunk keeps what it saw per channel as blocks split at each CHANNEL_ID and the blocks are joined in file order, so
+//device types and RX_FAIL gap runs carry across chunk boundaries.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+
+#include "ANTPlus.h"
+
+#define ANALYZE_DEVICE_TYPE_UNKNOWN (-1) //!< No CHANNEL_ID seen (yet) for the channel
+#define ANALYZE_DEFAULT_CHUNK_MB    (16)
+#define ANALYZE_CHANNEL_PERIOD_HZ   (32768.0)
+
+typedef enum
+{
+  ANALYZE_BROADCAST,
+  ANALYZE_ACKNOWLEDGED,
+  ANALYZE_BURST,
+  ANALYZE_RX_FAIL,
+  ANALYZE_GO_TO_SEARCH,
+  ANALYZE_SEARCH_TIMEOUT,
+  ANALYZE_CHANNEL_CLOSED,
+
+  ANALYZE_COUNT
+} ANALYZE_COUNTER;
+
+static const char * const counter_names[ANALYZE_COUNT] =
+{
+  "bcast", "ack", "burst", "rx_fail", "to_srch", "srch_to", "closed",
+};
+
+//! What one chunk saw on one channel between CHANNEL_ID responses
+typedef struct
+{
+  int           device_type;     //!< ANALYZE_DEVICE_TYPE_UNKNOWN for the first block (the type comes from earlier chunks)
+  unsigned int  device_number;
+  unsigned long counts[ANALYZE_COUNT];
+  boolean       any_data;        //!< A broadcast/acknowledged/burst (ends an RX_FAIL run)
+  unsigned long leading_fails;   //!< RX_FAIL before the first data (all of them if there was no data)
+  unsigned long trailing_fails;  //!< RX_FAIL after the last data
+  unsigned long longest_fails;   //!< Longest run that both started and ended inside the block
+  unsigned long inner_gaps;      //!< Runs that started and ended inside the block
+} ChannelBlock;
+
+typedef struct
+{
+  size_t        first_frame;     //!< Offset the chunk locked on at (== end if it never did)
+  size_t        exit;            //!< Offset of the first frame (or sync) at or past the end -- where the next chunk should start
+  unsigned long frames;
+  unsigned long bad_checksum;
+  unsigned long size_exceeded;
+  unsigned long noise_bytes;     //!< Bytes skipped looking for a sync
+  unsigned long truncated;       //!< Frame cut off by the end of the file
+  unsigned long msg_ids[256];
+  std::vector<ChannelBlock> channels[ANT_DEVICE_NUMBER_CHANNELS];
+} ChunkResult;
+
+//! Totals for one device type
+typedef struct
+{
+  unsigned long counts[ANALYZE_COUNT];
+  unsigned long gaps;
+  unsigned long longest_gap;
+  std::set<unsigned int> device_numbers;
+} TypeStats;
+
+typedef enum
+{
+  FRAME_GOOD,
+  FRAME_BAD_CHECKSUM,
+  FRAME_SIZE_EXCEEDED,
+  FRAME_TRUNCATED,
+} FRAME_STATUS;
+
+//! Check the frame starting at p (a sync). *size is set to the frame size when the length is usable.
+static FRAME_STATUS check_frame(const byte * p, const byte * file_end, size_t * size)
+{
+  if ((file_end - p) < MESG_FRAME_SIZE)
+  {
+    return FRAME_TRUNCATED;
+  }
+  //Same rule as ANTPlus::frameByte()
+  if ((p[1] + MESG_FRAME_SIZE) > ANT_MAX_PACKET_LEN)
+  {
+    return FRAME_SIZE_EXCEEDED;
+  }
+  *size = p[1] + MESG_FRAME_SIZE;
+  if ((size_t) (file_end - p) < *size)
+  {
+    return FRAME_TRUNCATED;
+  }
+  byte checksum = 0;
+  for (size_t i = 0; i < (*size - 1); i++)
+  {
+    checksum ^= p[i];
+  }
+  return (checksum == p[*size - 1]) ? FRAME_GOOD : FRAME_BAD_CHECKSUM;
+}
+
+static ChannelBlock & current_block(ChunkResult & result, byte channel)
+{
+  std::vector<ChannelBlock> & blocks = result.channels[channel];
+  if (blocks.empty())
+  {
+    ChannelBlock block;
+    memset(&block, 0, sizeof(block));
+    block.device_type = ANALYZE_DEVICE_TYPE_UNKNOWN;
+    blocks.push_back(block);
+  }
+  return blocks.back();
+}
+
+static void count_data(ChannelBlock & block, ANALYZE_COUNTER counter)
+{
+  block.counts[counter]++;
+  if (block.any_data && (block.trailing_fails > 0))
+  {
+    block.longest_fails = std::max(block.longest_fails, block.trailing_fails);
+    block.inner_gaps++;
+  }
+  block.any_data = true;
+  block.trailing_fails = 0;
+}
+
+static void count_frame(ChunkResult & result, const ANT_Packet * packet)
+{
+  result.frames++;
+  result.msg_ids[packet->msg_id]++;
+  if (packet->length == 0)
+  {
+    return;
+  }
+  //Burst packets carry the sequence number in the top 3 bits of the channel byte
+  byte channel = (packet->msg_id == MESG_BURST_DATA_ID) ? (packet->data[0] & 0x1F) : packet->data[0];
+  if (channel >= ANT_DEVICE_NUMBER_CHANNELS)
+  {
+    return;
+  }
+
+  switch (packet->msg_id)
+  {
+    case MESG_BROADCAST_DATA_ID:
+      count_data(current_block(result, channel), ANALYZE_BROADCAST);
+      break;
+    case MESG_ACKNOWLEDGED_DATA_ID:
+      count_data(current_block(result, channel), ANALYZE_ACKNOWLEDGED);
+      break;
+    case MESG_BURST_DATA_ID:
+      count_data(current_block(result, channel), ANALYZE_BURST);
+      break;
+    case MESG_CHANNEL_ID_ID:
+      if (packet->length >= MESG_CHANNEL_ID_SIZE)
+      {
+        //Start a new block -- what follows belongs to this device
+        ChannelBlock block;
+        memset(&block, 0, sizeof(block));
+        block.device_type = packet->data[3] & 0x7F; //Top bit is the pairing bit
+        block.device_number = packet->data[1] | (packet->data[2] << 8);
+        result.channels[channel].push_back(block);
+      }
+      break;
+    case MESG_RESPONSE_EVENT_ID:
+      if ((packet->length >= MESG_RESPONSE_EVENT_SIZE) && (packet->data[1] == MESG_EVENT_ID))
+      {
+        ChannelBlock & block = current_block(result, channel);
+        switch (packet->data[2])
+        {
+          case EVENT_RX_FAIL:
+            block.counts[ANALYZE_RX_FAIL]++;
+            if (block.any_data)
+            {
+              block.trailing_fails++;
+            }
+            else
+            {
+              block.leading_fails++;
+            }
+            break;
+          case EVENT_RX_FAIL_GO_TO_SEARCH:
+            block.counts[ANALYZE_GO_TO_SEARCH]++;
+            break;
+          case EVENT_RX_SEARCH_TIMEOUT:
+            block.counts[ANALYZE_SEARCH_TIMEOUT]++;
+            break;
+          case EVENT_CHANNEL_CLOSED:
+            block.counts[ANALYZE_CHANNEL_CLOSED]++;
+            break;
+        }
+      }
+      break;
+  }
+}
+
+//! Frame [start, end) of the file. With lock the chunk first looks for two good frames in a row (it may start mid frame).
+//start may be past end (the previous chunk's last frame ran over this whole chunk) -- then there is nothing to do.
+static void analyze_chunk(const byte * file, size_t file_size, size_t start, size_t end, boolean lock, ChunkResult & result)
+{
+  memset(result.msg_ids, 0, sizeof(result.msg_ids));
+  for (int c = 0; c < ANT_DEVICE_NUMBER_CHANNELS; c++)
+  {
+    result.channels[c].clear();
+  }
+  result.frames = 0;
+  result.bad_checksum = 0;
+  result.size_exceeded = 0;
+  result.noise_bytes = 0;
+  result.truncated = 0;
+
+  const byte * file_end = file + file_size;
+  const byte * p = file + start;
+  const byte * stop = file + end;
+  size_t size;
+
+  if (lock)
+  {
+    while (p < stop)
+    {
+      p = (const byte *) memchr(p, MESG_TX_SYNC, stop - p);
+      if (p == NULL)
+      {
+        p = stop;
+        break;
+      }
+      if (check_frame(p, file_end, &size) == FRAME_GOOD)
+      {
+        size_t next_size;
+        if (((p + size) == file_end) || (check_frame(p + size, file_end, &next_size) == FRAME_GOOD))
+        {
+          break;
+        }
+      }
+      p++;
+    }
+  }
+  result.first_frame = p - file;
+
+  while (p < stop)
+  {
+    if (*p != MESG_TX_SYNC)
+    {
+      const byte * sync = (const byte *) memchr(p, MESG_TX_SYNC, file_end - p);
+      if (sync == NULL)
+      {
+        sync = file_end;
+      }
+      result.noise_bytes += sync - p;
+      p = sync;
+      continue;
+    }
+    switch (check_frame(p, file_end, &size))
+    {
+      case FRAME_GOOD:
+        count_frame(result, (const ANT_Packet *) p);
+        p += size;
+        break;
+      case FRAME_BAD_CHECKSUM:
+        //As the library -- the 'sync' may have been data so look again from the next byte
+        result.bad_checksum++;
+        p++;
+        break;
+      case FRAME_SIZE_EXCEEDED:
+        result.size_exceeded++;
+        p++;
+        break;
+      case FRAME_TRUNCATED:
+        result.truncated++;
+        p = file_end;
+        break;
+    }
+  }
+  result.exit = p - file;
+}
+
+//! Join a chunk's blocks onto the running state for the file (in file order)
+static void merge_chunk(const ChunkResult & chunk, int device_types[], unsigned long open_fails[],
+                        std::map<int, TypeStats> & types)
+{
+  for (int c = 0; c < ANT_DEVICE_NUMBER_CHANNELS; c++)
+  {
+    for (size_t b = 0; b < chunk.channels[c].size(); b++)
+    {
+      const ChannelBlock & block = chunk.channels[c][b];
+      if (block.device_type != ANALYZE_DEVICE_TYPE_UNKNOWN)
+      {
+        device_types[c] = block.device_type;
+      }
+      TypeStats & stats = types[device_types[c]];
+      if (block.device_type != ANALYZE_DEVICE_TYPE_UNKNOWN)
+      {
+        stats.device_numbers.insert(block.device_number);
+      }
+      for (int i = 0; i < ANALYZE_COUNT; i++)
+      {
+        stats.counts[i] += block.counts[i];
+      }
+      if (!block.any_data)
+      {
+        open_fails[c] += block.leading_fails;
+        continue;
+      }
+      unsigned long joined = open_fails[c] + block.leading_fails;
+      if (joined > 0)
+      {
+        stats.gaps++;
+        stats.longest_gap = std::max(stats.longest_gap, joined);
+      }
+      stats.gaps += block.inner_gaps;
+      stats.longest_gap = std::max(stats.longest_gap, block.longest_fails);
+      open_fails[c] = block.trailing_fails;
+    }
+  }
+}
+
+typedef struct
+{
+  unsigned long long bytes;
+  unsigned long      frames;
+  unsigned long      bad_checksum;
+  unsigned long      size_exceeded;
+  unsigned long      noise_bytes;
+  unsigned long      truncated;
+  unsigned long      reframed_chunks;
+  unsigned long      msg_ids[256];
+} Totals;
+
+static boolean analyze_file(const char * path, unsigned int threads, size_t chunk_size,
+                            Totals & totals, std::map<int, TypeStats> & types)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Can't read %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    fprintf(stderr, "Can't stat %s: %s\n", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+  size_t file_size = info.st_size;
+  if (file_size == 0)
+  {
+    close(fd);
+    return true;
+  }
+  const byte * file = (const byte *) mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED)
+  {
+    fprintf(stderr, "Can't map %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  madvise((void *) file, file_size, MADV_SEQUENTIAL);
+
+  size_t chunk_count = (file_size + chunk_size - 1) / chunk_size;
+  std::vector<ChunkResult> chunks(chunk_count);
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < std::min<size_t>(threads, chunk_count); t++)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      size_t i;
+      while ((i = next++) < chunk_count)
+      {
+        size_t start = i * chunk_size;
+        analyze_chunk(file, file_size, start, std::min(start + chunk_size, file_size), (i > 0), chunks[i]);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++)
+  {
+    workers[t].join();
+  }
+
+  //In file order. The state of the channels starts afresh with each file.
+  int device_types[ANT_DEVICE_NUMBER_CHANNELS];
+  unsigned long open_fails[ANT_DEVICE_NUMBER_CHANNELS];
+  for (int c = 0; c < ANT_DEVICE_NUMBER_CHANNELS; c++)
+  {
+    device_types[c] = ANALYZE_DEVICE_TYPE_UNKNOWN;
+    open_fails[c] = 0;
+  }
+  for (size_t i = 0; i < chunk_count; i++)
+  {
+    ChunkResult & chunk = chunks[i];
+    if ((i > 0) && (chunk.first_frame != chunks[i - 1].exit))
+    {
+      //Locked on somewhere else than a single pass would be -- frame it again from where the last chunk left off
+      size_t end = std::min((i + 1) * chunk_size, file_size);
+      analyze_chunk(file, file_size, chunks[i - 1].exit, end, false, chunk);
+      totals.reframed_chunks++;
+    }
+    totals.frames += chunk.frames;
+    totals.bad_checksum += chunk.bad_checksum;
+    totals.size_exceeded += chunk.size_exceeded;
+    totals.noise_bytes += chunk.noise_bytes;
+    totals.truncated += chunk.truncated;
+    for (int m = 0; m < 256; m++)
+    {
+      totals.msg_ids[m] += chunk.msg_ids[m];
+    }
+    merge_chunk(chunk, device_types, open_fails, types);
+  }
+  //A run still open at the end of the file is a gap too
+  for (int c = 0; c < ANT_DEVICE_NUMBER_CHANNELS; c++)
+  {
+    if (open_fails[c] > 0)
+    {
+      TypeStats & stats = types[device_types[c]];
+      stats.gaps++;
+      stats.longest_gap = std::max(stats.longest_gap, open_fails[c]);
+    }
+  }
+  totals.bytes += file_size;
+
+  munmap((void *) file, file_size);
+  return true;
+}
+
+static void print_report(const Totals & totals, const std::map<int, TypeStats> & types, unsigned int period, double seconds)
+{
+  unsigned long bad = totals.bad_checksum + totals.size_exceeded;
+  printf("%llu bytes in %.3f s (%.1f MB/s), %lu chunk(s) framed again at a boundary\n",
+         totals.bytes, seconds, (seconds > 0) ? (totals.bytes / seconds / 1e6) : 0.0, totals.reframed_chunks);
+  printf("frames %lu, bad checksum %lu, size exceeded %lu (%.3f%% bad), noise bytes %lu, truncated %lu\n",
+         totals.frames, totals.bad_checksum, totals.size_exceeded,
+         (totals.frames + bad) ? (100.0 * bad / (totals.frames + bad)) : 0.0, totals.noise_bytes, totals.truncated);
+
+  printf("\n%-8s %10s\n", "msg id", "frames");
+  for (int m = 0; m < 256; m++)
+  {
+    if (totals.msg_ids[m] > 0)
+    {
+      printf("0x%02X     %10lu\n", m, totals.msg_ids[m]);
+    }
+  }
+
+  //Every broadcast or RX_FAIL is one channel period
+  printf("\n%-6s %4s", "type", "devs");
+  for (int i = 0; i < ANALYZE_COUNT; i++)
+  {
+    printf(" %9s", counter_names[i]);
+  }
+  printf(" %7s %9s %7s %9s\n", "rx %", "gaps", "longest", "minutes");
+  for (std::map<int, TypeStats>::const_iterator it = types.begin(); it != types.end(); ++it)
+  {
+    const TypeStats & stats = it->second;
+    if (it->first == ANALYZE_DEVICE_TYPE_UNKNOWN)
+    {
+      printf("%-6s %4s", "?", "-");
+    }
+    else
+    {
+      printf("%-6d %4lu", it->first, (unsigned long) stats.device_numbers.size());
+    }
+    for (int i = 0; i < ANALYZE_COUNT; i++)
+    {
+      printf(" %9lu", stats.counts[i]);
+    }
+    unsigned long slots = stats.counts[ANALYZE_BROADCAST] + stats.counts[ANALYZE_ACKNOWLEDGED] + stats.counts[ANALYZE_RX_FAIL];
+    printf(" %7.2f %9lu %7lu %9.1f\n", slots ? (100.0 * (slots - stats.counts[ANALYZE_RX_FAIL]) / slots) : 0.0,
+           stats.gaps, stats.longest_gap, slots * (period / ANALYZE_CHANNEL_PERIOD_HZ) / 60.0);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  unsigned int threads = std::thread::hardware_concurrency();
+  size_t chunk_size = ANALYZE_DEFAULT_CHUNK_MB * 1024 * 1024;
+  unsigned int period = DEVCE_GPS_RATE; //8070 (4 Hz) -- the usual rate for HRM, SDM and bike sensors
+  std::vector<const char *> paths;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc))
+    {
+      threads = atoi(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "--chunk-mb") == 0) && (i + 1 < argc))
+    {
+      chunk_size = (size_t) (atof(argv[++i]) * 1024 * 1024);
+    }
+    else if ((strcmp(argv[i], "--period") == 0) && (i + 1 < argc))
+    {
+      period = atoi(argv[++i]);
+    }
+    else if (argv[i][0] != '-')
+    {
+      paths.push_back(argv[i]);
+    }
+    else
+    {
+      paths.clear();
+      break;
+    }
+  }
+  if (paths.empty() || (chunk_size < MESG_MAX_SIZE))
+  {
+    fprintf(stderr, "Usage: %s [--threads N] [--chunk-mb N] [--period N] FILE...\n", argv[0]);
+    return 2;
+  }
+  if (threads == 0)
+  {
+    threads = 1;
+  }
+
+  Totals totals;
+  memset(&totals, 0, sizeof(totals));
+  std::map<int, TypeStats> types;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    if (!analyze_file(paths[i], threads, chunk_size, totals, types))
+    {
+      return 2;
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  print_report(totals, types, period, seconds);
+  return 0;
+}
@@ -0,0 +1,980 @@
+//Copyright 2013 Brody Kenrick.
+//End to end benchmarks against the simulated module (SimulatedANTModule). See README.md in this directory.
+//
+//  1. Channel acquisition -- one HRM channel set up as in the example sketch (time to established, to first broadcast)
+//  2. Bring-up of 8 channels at once through the pipelined setup (and again with host frames lost -- resent, see ANT_COMMAND_RETRIES)
+//  3. Broadcast-to-application latency with 4 channels tracking, with and without faults
+//  4. Sensor dropout -- an HRM goes out of range for a while (past the search timeout the module closes the channel and it is reopened)
+//  5. R-R intervals and RMSSD (ANTHeartRate) from a strap with a varying heart rate while broadcasts are lost
+//  6. An HRM and a bike speed and cadence sensor together -- speed, cadence and distance (ANTSpeedCadence) and the bike stopping
+//  7. Two networks -- HRM channels on the public network and a GPS (geocache) channel on its own, one network key each
+//  8. Reconnecting in a gym -- your HRM and 7 others in range, a wildcard search vs. the pairing cache (built with -DANTPLUS_PAIRING)
+//  9. Cold start of an HRM channel from the built in setup steps and from a PROGMEM setup script (ANTPlus_Script.h)
+//
+//Each is run at several main loop periods (the time the sketch's loop() takes) on the simulated clock.
+//
+//  bench_acquisition [--trials N] [--seed N]
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <vector>
+
+#include "Arduino.h"
+#include "SimulatedANTModule.h"
+
+#include "ANTPlus.h"
+#include "ANTPlus_HeartRate.h"
+#include "ANTPlus_SpeedCadence.h"
+
+#if defined(ANTPLUS_PAIRING)
+#include "ANTPlus_Pairing.h"
+#include "HostPairingFile.h"
+#endif /*defined(ANTPLUS_PAIRING)*/
+
+#define BENCH_RTS_PIN      (2)
+#define BENCH_SUSPEND_PIN  (3)
+#define BENCH_SLEEP_PIN    (4)
+#define BENCH_RESET_PIN    (5)
+
+#define BENCH_SENSOR_PERIOD       (8070)      //!< 4 Hz -- HRM/SDM/bike sensors all send at about this rate
+#define BENCH_GIVE_UP_US          (60000000UL)
+#define BENCH_LATENCY_RUN_US      (60000000UL)
+
+static unsigned long bench_random_state = 12345;
+
+static unsigned long bench_random(unsigned long limit)
+{
+  bench_random_state = (bench_random_state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+  return bench_random_state % limit;
+}
+
+typedef struct
+{
+  ANTPlus *            antplus;
+  SimulatedANTModule * module;
+  unsigned long        loop_us;
+  unsigned long        rx_fail_events;
+  unsigned long        read_errors;
+  //Latency (broadcasts carry the sensor's message count -- see SimulatedANTModule::channel_receive())
+  std::vector<unsigned long> latency_us;
+} BenchRun;
+
+//! One pass of a sketch loop() like the example's: read everything, progress setup (RTS is the library's own interrupt)
+static ANT_CHANNEL_ESTABLISH loop_once(BenchRun & run)
+{
+  host_advance_micros(run.loop_us);
+
+  const ANT_Packet * packet;
+  MESSAGE_READ ret_val;
+  while ((ret_val = run.antplus->readPacket(&packet, 0)) != MESSAGE_READ_NONE)
+  {
+    if ((ret_val != MESSAGE_READ_EXPECTED) && (ret_val != MESSAGE_READ_OTHER))
+    {
+      run.read_errors++;
+      continue;
+    }
+    if ((packet->msg_id == MESG_BROADCAST_DATA_ID) && (run.antplus->get_channel(packet->data[0]) != NULL))
+    {
+      byte channel_number = packet->data[0];
+      unsigned long count = packet->data[1] | ((unsigned long) packet->data[2] << 8) | ((unsigned long) packet->data[3] << 16) | ((unsigned long) packet->data[4] << 24);
+      //Sensor i is on channel i
+      run.latency_us.push_back(micros() - run.module->sensor_message_micros(channel_number, count));
+    }
+    else if ((packet->msg_id == MESG_RESPONSE_EVENT_ID) && (packet->data[1] == MESG_EVENT_ID) && (packet->data[2] == EVENT_RX_FAIL))
+    {
+      run.rx_fail_events++;
+    }
+  }
+
+  return run.antplus->progress_setup_channels();
+}
+
+static void init_channel(ANT_Channel & channel, int channel_number, int device_type, int period)
+{
+  static const unsigned char key[8] = {0xB9, 0xA5, 0x21, 0xFB, 0xBD, 0x72, 0xC3, 0x45};
+  memset(&channel, 0, sizeof(channel));
+  channel.channel_number = channel_number;
+  channel.network_number = PUBLIC_NETWORK;
+  channel.timeout = DEVCE_TIMEOUT;
+  channel.device_type = device_type;
+  channel.freq = DEVCE_SENSOR_FREQ;
+  channel.period = period;
+  memcpy(channel.ant_net_key, key, sizeof(key));
+  channel.channel_establish = ANT_CHANNEL_ESTABLISH_PROGRESSING;
+}
+
+typedef struct
+{
+  double        established_ms;   //!< All channels ANT_CHANNEL_ESTABLISH_COMPLETE
+  double        first_rx_ms;      //!< All channels have had a broadcast
+  unsigned long frames_sent;
+  unsigned long extra_resets;     //!< Module resets (MESG_SYSTEM_RESET_ID or the reset line) after the one in begin()
+  boolean       gave_up;
+} BringUp;
+
+//! Channels 0..count-1, device types 120.. with a sensor each at a random phase
+//A setup_script (if any) is used for every channel instead of the built in steps.
+static BringUp bring_up(int count, int channel_period, unsigned long loop_us, unsigned long seed, double host_drop_probability,
+                        const byte * setup_script = NULL)
+{
+  BringUp result;
+  memset(&result, 0, sizeof(result));
+
+  host_set_micros(0);
+  SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+  module.seed(seed);
+  module.host_frame_drop_probability = host_drop_probability;
+  ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+
+  ANT_Channel channels[SIM_ANT_NUMBER_CHANNELS];
+  for (int i = 0; i < count; i++)
+  {
+    init_channel(channels[i], i, DEVCE_TYPE_HRM + i, channel_period);
+    channels[i].setup_script = setup_script;
+    module.add_sensor(DEVCE_TYPE_HRM + i, 1000 + i, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, bench_random(1000000));
+  }
+
+  antplus.begin(module);
+  for (int i = 0; i < count; i++)
+  {
+    antplus.add_channel(&channels[i]);
+  }
+
+  BenchRun run;
+  run.antplus = &antplus;
+  run.module = &module;
+  run.loop_us = loop_us;
+  run.rx_fail_events = 0;
+  run.read_errors = 0;
+
+  while ((result.established_ms == 0) || (result.first_rx_ms == 0))
+  {
+    if (micros() >= BENCH_GIVE_UP_US)
+    {
+      result.gave_up = true;
+      break;
+    }
+    ANT_CHANNEL_ESTABLISH establish = loop_once(run);
+    if ((result.established_ms == 0) && (establish == ANT_CHANNEL_ESTABLISH_COMPLETE))
+    {
+      result.established_ms = micros() / 1000.0;
+    }
+    int received = 0;
+    for (int i = 0; i < count; i++)
+    {
+      received += (channels[i].broadcast_count > 0) ? 1 : 0;
+    }
+    if ((result.first_rx_ms == 0) && (received == count))
+    {
+      result.first_rx_ms = micros() / 1000.0;
+    }
+  }
+  result.frames_sent = module.host_frames + module.host_frames_dropped;
+  result.extra_resets = module.resets - 1;
+  return result;
+}
+
+static void report_bring_up(const char * title, int count, int channel_period, int trials, double host_drop_probability = 0)
+{
+  static const unsigned long loop_periods_us[] = {100, 1000, 10000, 50000};
+
+  printf("%s (%d trials, random sensor phase)\n", title, trials);
+  printf("  %-10s %14s %14s %16s %16s %10s %10s\n", "loop (ms)", "setup mean", "setup max", "first rx mean", "first rx max", "frames", "resets");
+  for (size_t p = 0; p < sizeof(loop_periods_us) / sizeof(loop_periods_us[0]); p++)
+  {
+    double setup_sum = 0, setup_max = 0, rx_sum = 0, rx_max = 0;
+    unsigned long frames = 0, resets = 0, gave_up = 0;
+    for (int t = 0; t < trials; t++)
+    {
+      BringUp result = bring_up(count, channel_period, loop_periods_us[p], t + 1, host_drop_probability);
+      setup_sum += result.established_ms;
+      setup_max = std::max(setup_max, result.established_ms);
+      rx_sum += result.first_rx_ms;
+      rx_max = std::max(rx_max, result.first_rx_ms);
+      frames += result.frames_sent;
+      resets += result.extra_resets;
+      gave_up += result.gave_up ? 1 : 0;
+    }
+    printf("  %-10.1f %14.1f %14.1f %16.1f %16.1f %10.1f %10lu", loop_periods_us[p] / 1000.0,
+           setup_sum / trials, setup_max, rx_sum / trials, rx_max, (double) frames / trials, resets);
+    if (gave_up > 0)
+    {
+      printf("  (%lu gave up after %lu s)", gave_up, BENCH_GIVE_UP_US / 1000000);
+    }
+    printf("\n");
+  }
+  printf("\n");
+}
+
+#define BENCH_NETWORK_KEY_BYTES 0xB9, 0xA5, 0x21, 0xFB, 0xBD, 0x72, 0xC3, 0x45 //!< As init_channel()
+
+//! The example's HRM channel as a PROGMEM setup script (see ANTPlus_Script.h)
+static const byte bench_hrm_script[] PROGMEM =
+{
+  ANT_SCRIPT_NETWORK_KEY( PUBLIC_NETWORK, BENCH_NETWORK_KEY_BYTES ),
+  ANT_SCRIPT_RECEIVE_CHANNEL( 0, PUBLIC_NETWORK, DEVCE_TYPE_HRM, DEVCE_TIMEOUT, DEVCE_SENSOR_FREQ, DEVCE_HRM_LOWEST_RATE ),
+  ANT_SCRIPT_END
+};
+
+//! Cold start of one HRM channel from the built in steps and from bench_hrm_script -- the same sensor phases for both
+static void report_setup_script(const char * title, int trials)
+{
+  static const unsigned long loop_periods_us[] = {100, 1000, 10000, 50000};
+
+  printf("%s (%d trials, random sensor phase)\n", title, trials);
+  printf("  %-10s %16s %16s %16s %16s %12s %12s\n", "loop (ms)", "built in setup", "script setup", "built in rx", "script rx",
+         "built in fr", "script fr");
+  for (size_t p = 0; p < sizeof(loop_periods_us) / sizeof(loop_periods_us[0]); p++)
+  {
+    double setup_sum[2] = {0, 0}, rx_sum[2] = {0, 0};
+    unsigned long frames[2] = {0, 0}, gave_up = 0;
+    for (int t = 0; t < trials; t++)
+    {
+      unsigned long random_state = bench_random_state;
+      for (int script = 0; script < 2; script++)
+      {
+        bench_random_state = random_state;
+        BringUp result = bring_up(1, DEVCE_HRM_LOWEST_RATE, loop_periods_us[p], t + 1, 0, script ? bench_hrm_script : NULL);
+        setup_sum[script] += result.established_ms;
+        rx_sum[script] += result.first_rx_ms;
+        frames[script] += result.frames_sent;
+        gave_up += result.gave_up ? 1 : 0;
+      }
+    }
+    printf("  %-10.1f %16.1f %16.1f %16.1f %16.1f %12.1f %12.1f", loop_periods_us[p] / 1000.0, setup_sum[0] / trials, setup_sum[1] / trials,
+           rx_sum[0] / trials, rx_sum[1] / trials, (double) frames[0] / trials, (double) frames[1] / trials);
+    if (gave_up > 0)
+    {
+      printf("  (%lu gave up after %lu s)", gave_up, BENCH_GIVE_UP_US / 1000000);
+    }
+    printf("\n");
+  }
+  printf("  (means in ms from begin() -- setup is to established, rx to the first broadcast; fr is frames sent to the module)\n\n");
+}
+
+static void report_latency(const char * title, double drop_probability, double bit_error_rate)
+{
+  static const unsigned long loop_periods_us[] = {1000, 10000, 50000, 100000};
+  const int count = 4;
+
+  printf("%s\n", title);
+  printf("  %-10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "loop (ms)", "delivered", "sent", "mean (ms)", "p99 (ms)", "max (ms)", "overruns", "rx fails", "errors");
+  for (size_t p = 0; p < sizeof(loop_periods_us) / sizeof(loop_periods_us[0]); p++)
+  {
+    host_set_micros(0);
+    SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+    module.seed(p + 1);
+    ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+
+    ANT_Channel channels[count];
+    for (int i = 0; i < count; i++)
+    {
+      init_channel(channels[i], i, DEVCE_TYPE_HRM + i, BENCH_SENSOR_PERIOD);
+      module.add_sensor(DEVCE_TYPE_HRM + i, 1000 + i, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, bench_random(250000));
+    }
+    antplus.begin(module);
+    for (int i = 0; i < count; i++)
+    {
+      antplus.add_channel(&channels[i]);
+    }
+
+    BenchRun run;
+    run.antplus = &antplus;
+    run.module = &module;
+    run.loop_us = loop_periods_us[p];
+    run.rx_fail_events = 0;
+    run.read_errors = 0;
+
+    //Faults only once the channels are up
+    while ((loop_once(run) != ANT_CHANNEL_ESTABLISH_COMPLETE) && (micros() < BENCH_GIVE_UP_US))
+    {
+    }
+    module.broadcast_drop_probability = drop_probability;
+    module.bit_error_rate = bit_error_rate;
+    run.latency_us.clear();
+    unsigned long sent_before = module.broadcasts_sent;
+    unsigned long end_us = micros() + BENCH_LATENCY_RUN_US;
+    while (micros() < end_us)
+    {
+      loop_once(run);
+    }
+
+    std::vector<unsigned long> & latency = run.latency_us;
+    double mean = 0;
+    double p99 = 0;
+    double worst = 0;
+    if (!latency.empty())
+    {
+      std::sort(latency.begin(), latency.end());
+      for (size_t i = 0; i < latency.size(); i++)
+      {
+        mean += latency[i];
+      }
+      mean /= latency.size();
+      p99 = latency[(latency.size() * 99) / 100];
+      worst = latency.back();
+    }
+    printf("  %-10.1f %10lu %10lu %10.2f %10.2f %10.2f %10lu %10lu %10lu\n", loop_periods_us[p] / 1000.0,
+           (unsigned long) latency.size(), module.broadcasts_sent - sent_before, mean / 1000.0, p99 / 1000.0, worst / 1000.0,
+           module.uart_overruns, run.rx_fail_events, run.read_errors);
+  }
+  printf("\n");
+}
+
+//! One HRM channel tracking, then the sensor out of range for each period in turn (10 ms loop)
+static void report_dropout(const char * title)
+{
+  static const unsigned long out_of_range_ms[] = {1000, 10000, 40000, 120000};
+
+  printf("%s\n", title);
+  printf("  %-12s %16s %16s %10s %10s\n", "out (s)", "back after (ms)", "dropout (ms)", "state", "reopens");
+  host_set_micros(0);
+  SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+  module.seed(1);
+  ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+  ANT_Channel channel;
+  init_channel(channel, 0, DEVCE_TYPE_HRM, BENCH_SENSOR_PERIOD);
+  int sensor = module.add_sensor(DEVCE_TYPE_HRM, 1000, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, bench_random(250000));
+  antplus.begin(module);
+  antplus.add_channel(&channel);
+
+  BenchRun run;
+  run.antplus = &antplus;
+  run.module = &module;
+  run.loop_us = 10000;
+  run.rx_fail_events = 0;
+  run.read_errors = 0;
+
+  for (size_t d = 0; d < sizeof(out_of_range_ms) / sizeof(out_of_range_ms[0]); d++)
+  {
+    //Tracking for a few seconds first
+    unsigned long end_us = micros() + 5000000UL;
+    while ((micros() < end_us) || (channel.channel_state != ANT_CHANNEL_STATE_TRACKING))
+    {
+      loop_once(run);
+    }
+    unsigned long dropouts = channel.dropout_count;
+    module.set_sensor_in_range(sensor, false);
+    end_us = micros() + out_of_range_ms[d] * 1000UL;
+    while (micros() < end_us)
+    {
+      loop_once(run);
+    }
+    byte state = channel.channel_state;
+    module.set_sensor_in_range(sensor, true);
+    unsigned long back_us = micros();
+    unsigned long broadcasts = channel.broadcast_count;
+    while ((channel.broadcast_count == broadcasts) && ((micros() - back_us) < BENCH_GIVE_UP_US))
+    {
+      loop_once(run);
+    }
+    static const char * const state_names[] = {"closed", "reopening", "searching", "tracking"};
+    printf("  %-12.0f ", out_of_range_ms[d] / 1000.0);
+    if (channel.broadcast_count == broadcasts)
+    {
+      printf("%16s", "never");
+    }
+    else
+    {
+      printf("%16.1f", (micros() - back_us) / 1000.0);
+    }
+    //Shorter than the module's time to go to search is only missed broadcasts, not a dropout
+    if (channel.dropout_count == dropouts)
+    {
+      printf(" %16s", "-");
+    }
+    else
+    {
+      printf(" %16lu", channel.last_dropout_ms);
+    }
+    printf(" %10s %10u\n", state_names[state], channel.reopen_count);
+  }
+  printf("\n");
+}
+
+#define BENCH_HRV_RUN_US (300000000UL)
+
+//! A strap whose beats are ~120 bpm, swinging +-40 ms over a 4 s breath with +-15 ms of noise on top
+typedef struct
+{
+  std::vector<unsigned long long> beat_us;
+  unsigned long long phase_us;
+  std::deque<unsigned long> sent;  //!< Beat index on each page sent -- taken off as the pages are decoded
+  ANTHeartRate hrm;
+  //Results
+  boolean       started;
+  unsigned long first_beat;
+  unsigned long last_beat;
+  unsigned long measured, measured_error_max;
+  unsigned long reconstructed;
+  double        reconstructed_error_sum;
+  double        rmssd_sum, true_rmssd_sum;
+  unsigned long rmssd_samples;
+} HrvStrap;
+
+static unsigned int hrv_beat_time(const HrvStrap & strap, unsigned long beat)
+{
+  return (unsigned int) ((strap.beat_us[beat] * 1024ULL) / 1000000ULL);
+}
+
+static void hrv_page(byte page[8], unsigned long message_count, unsigned int period, void * context)
+{
+  HrvStrap & strap = *(HrvStrap *) context;
+  unsigned long long now_us = strap.phase_us + ((unsigned long long) message_count * period * 1000000ULL) / 32768ULL;
+  unsigned long beat = (std::upper_bound(strap.beat_us.begin(), strap.beat_us.end(), now_us) - strap.beat_us.begin()) - 1;
+  unsigned int beat_time = hrv_beat_time(strap, beat);
+  unsigned int previous_beat_time = (beat > 0) ? hrv_beat_time(strap, beat - 1) : 0;
+  strap.sent.push_back(beat);
+
+  page[0] = 0x04 | (((message_count / 4) & 1) << 7);
+  page[1] = 0xFF;
+  page[2] = previous_beat_time & 0xFF;
+  page[3] = (previous_beat_time >> 8) & 0xFF;
+  page[4] = beat_time & 0xFF;
+  page[5] = (beat_time >> 8) & 0xFF;
+  page[6] = beat & 0xFF;
+  page[7] = (byte) (60000000ULL / ((beat > 0) ? (strap.beat_us[beat] - strap.beat_us[beat - 1]) : strap.beat_us[1]));
+}
+
+//! Page decoded (from the profile) -- update the ANTHeartRate and check its new intervals against the beats sent
+static void hrv_decoded(const ANT_Channel * /*channel*/, const ANT_HRMDataPage * page, void * context)
+{
+  HrvStrap & strap = *(HrvStrap *) context;
+  unsigned long beat = strap.sent.front();
+  strap.sent.pop_front();
+  unsigned long intervals = strap.hrm.intervals();
+  byte new_beats = strap.hrm.update((const byte *) page);
+  byte new_intervals = strap.hrm.intervals() - intervals;
+  if (!strap.started)
+  {
+    strap.started = true;
+    strap.first_beat = beat;
+  }
+  strap.last_beat = beat;
+  //Intervals added this time are the newest in the ring (none after a gap that was too long)
+  for (byte age = 0; (age < new_intervals) && (age < strap.hrm.rrCount()) && (beat > age); age++)
+  {
+    long truth = (long) (unsigned int) (hrv_beat_time(strap, beat - age) - hrv_beat_time(strap, beat - age - 1));
+    long error = labs((long) strap.hrm.rr(age) - truth);
+    if (strap.hrm.rrReconstructed(age))
+    {
+      strap.reconstructed++;
+      strap.reconstructed_error_sum += error * 1000.0 / 1024.0;
+    }
+    else
+    {
+      strap.measured++;
+      strap.measured_error_max = std::max(strap.measured_error_max, (unsigned long) error);
+    }
+  }
+  //Against the RMSSD of the same number of true intervals
+  if ((new_beats > 0) && (strap.hrm.rrCount() == ANT_HRM_RR_RING_SIZE) && (beat >= ANT_HRM_RR_RING_SIZE + 1))
+  {
+    double sum = 0;
+    for (unsigned long b = beat - ANT_HRM_RR_RING_SIZE + 2; b <= beat; b++)
+    {
+      double a = (hrv_beat_time(strap, b) - hrv_beat_time(strap, b - 1)) & 0xFFFF;
+      double before = (hrv_beat_time(strap, b - 1) - hrv_beat_time(strap, b - 2)) & 0xFFFF;
+      sum += (a - before) * (a - before);
+    }
+    strap.true_rmssd_sum += sqrt(sum / (ANT_HRM_RR_RING_SIZE - 1)) * 1000.0 / 1024.0;
+    strap.rmssd_sum += strap.hrm.rmssd();
+    strap.rmssd_samples++;
+  }
+}
+
+static void report_hrv(const char * title)
+{
+  static const double drop_probability[] = {0, 0.1, 0.3, 0.5};
+
+  printf("%s\n", title);
+  printf("  %-8s %8s %8s %8s %10s %18s %20s %12s %12s\n", "drop", "beats", "counted", "missed", "R-R", "R-R max error", "reconstructed error",
+         "RMSSD (ms)", "true (ms)");
+  for (size_t d = 0; d < sizeof(drop_probability) / sizeof(drop_probability[0]); d++)
+  {
+    host_set_micros(0);
+    SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+    module.seed(1 + d);
+    ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+    ANT_Channel channel;
+    init_channel(channel, 0, DEVCE_TYPE_HRM, BENCH_SENSOR_PERIOD);
+
+    static HrvStrap strap;
+    strap.beat_us.clear();
+    strap.sent.clear();
+    strap.hrm.reset();
+    strap.started = false;
+    strap.measured = strap.measured_error_max = strap.reconstructed = strap.rmssd_samples = 0;
+    strap.reconstructed_error_sum = strap.rmssd_sum = strap.true_rmssd_sum = 0;
+    //Its own random numbers so the reports after this one are as they were
+    unsigned long random_state = bench_random_state;
+    strap.phase_us = random_state % 250000;
+    for (unsigned long long t = 0; t < BENCH_HRV_RUN_US + BENCH_GIVE_UP_US; )
+    {
+      strap.beat_us.push_back(t);
+      random_state = (random_state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+      t += 500000ULL + (unsigned long long) (40000.0 * sin(2 * M_PI * t / 4e6) + 15000.0 - (random_state % 30000));
+    }
+    module.add_sensor(DEVCE_TYPE_HRM, 1000, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, strap.phase_us, hrv_page, &strap);
+    module.broadcast_drop_probability = drop_probability[d];
+
+    static const ANT_HRMSink sink = {NULL, hrv_decoded, &strap};
+    antplus.begin(module);
+    antplus.add_profile(&ant_profile_hrm, &sink);
+    antplus.add_channel(&channel);
+
+    BenchRun run;
+    run.antplus = &antplus;
+    run.module = &module;
+    run.loop_us = 10000;
+    run.rx_fail_events = 0;
+    run.read_errors = 0;
+    while (micros() < BENCH_HRV_RUN_US)
+    {
+      loop_once(run);
+    }
+
+    char drop[16];
+    snprintf(drop, sizeof(drop), "%.0f%%", drop_probability[d] * 100);
+    printf("  %-8s %8lu %8lu %8u %10lu %18.1f %20.1f %12.1f %12.1f\n", drop,
+           strap.last_beat - strap.first_beat, strap.hrm.beats(), strap.hrm.missedBeats(), strap.measured,
+           strap.measured_error_max * 1000.0 / 1024.0, (strap.reconstructed > 0) ? strap.reconstructed_error_sum / strap.reconstructed : 0,
+           strap.rmssd_sum / strap.rmssd_samples, strap.true_rmssd_sum / strap.rmssd_samples);
+  }
+  printf("  (R-R is received intervals, errors in ms -- reconstructed is the mean, RMSSD is the mean over the beats)\n\n");
+}
+
+#define BENCH_BIKE_STOP_US (240000000UL)
+#define BENCH_BIKE_RUN_US  (270000000UL)
+#define BENCH_BIKE_WARM_US (15000000UL)  //!< Averages are compared from here (the ring has filled)
+
+//! A ride -- cadence 90 +-10 rpm over a minute, speed 9 +-1.5 m/s over 90 s -- that stops dead at BENCH_BIKE_STOP_US
+typedef struct
+{
+  std::vector<unsigned long long> crank_us;   //!< Each crank revolution
+  std::vector<unsigned long long> wheel_us;   //!< Each wheel revolution
+  unsigned long long phase_us;
+  std::deque<unsigned long long> sent_us;     //!< Time of each page sent -- taken off as the pages are decoded
+  ANTSpeedCadence bike;
+  //Results
+  boolean       started;
+  unsigned long first_wheel;
+  unsigned long last_wheel;
+  unsigned long samples;
+  double        cadence_error_sum, average_cadence_error_sum;
+  double        speed_error_sum, average_speed_error_sum;
+  double        stopped_after_s;               //!< Both stale (-1 if never)
+  unsigned long hrm_pages;
+} BikeRide;
+
+static double bike_cadence(double t_s)
+{
+  return 90.0 + 10.0 * sin(2 * M_PI * t_s / 60.0);
+}
+
+static double bike_speed(double t_s)
+{
+  return 9.0 + 1.5 * sin(2 * M_PI * t_s / 90.0);
+}
+
+//! Index of the last event at or before now (events start at 0)
+static unsigned long bike_last_event(const std::vector<unsigned long long> & events, unsigned long long now_us)
+{
+  return (std::upper_bound(events.begin(), events.end(), now_us) - events.begin()) - 1;
+}
+
+static void bike_page(byte page[8], unsigned long message_count, unsigned int period, void * context)
+{
+  BikeRide & ride = *(BikeRide *) context;
+  unsigned long long now_us = ride.phase_us + ((unsigned long long) message_count * period * 1000000ULL) / 32768ULL;
+  unsigned long crank = bike_last_event(ride.crank_us, now_us);
+  unsigned long wheel = bike_last_event(ride.wheel_us, now_us);
+  unsigned int crank_time = (unsigned int) ((ride.crank_us[crank] * 1024ULL) / 1000000ULL);
+  unsigned int wheel_time = (unsigned int) ((ride.wheel_us[wheel] * 1024ULL) / 1000000ULL);
+  ride.sent_us.push_back(now_us);
+
+  page[0] = crank_time & 0xFF;
+  page[1] = (crank_time >> 8) & 0xFF;
+  page[2] = crank & 0xFF;
+  page[3] = (crank >> 8) & 0xFF;
+  page[4] = wheel_time & 0xFF;
+  page[5] = (wheel_time >> 8) & 0xFF;
+  page[6] = wheel & 0xFF;
+  page[7] = (wheel >> 8) & 0xFF;
+}
+
+//! Message decoded (from the profile) -- update the ANTSpeedCadence and compare it with the ride at the time it was sent
+static void bike_decoded(const ANT_Channel * /*channel*/, unsigned int cadence_time, unsigned int cadence_revolutions,
+                         unsigned int speed_time, unsigned int speed_revolutions, void * context)
+{
+  BikeRide & ride = *(BikeRide *) context;
+  unsigned long long sent_us = ride.sent_us.front();
+  ride.sent_us.pop_front();
+  ride.bike.update(cadence_time, cadence_revolutions, speed_time, speed_revolutions);
+  unsigned long wheel = bike_last_event(ride.wheel_us, sent_us);
+  if (!ride.started)
+  {
+    ride.started = true;
+    ride.first_wheel = wheel;
+  }
+  ride.last_wheel = wheel;
+
+  if ((sent_us >= BENCH_BIKE_WARM_US) && (sent_us < BENCH_BIKE_STOP_US))
+  {
+    double t_s = sent_us / 1e6;
+    ride.cadence_error_sum += fabs(ride.bike.cadence() / 16.0 - bike_cadence(t_s));
+    ride.average_cadence_error_sum += fabs(ride.bike.averageCadence() / 16.0 - bike_cadence(t_s));
+    ride.speed_error_sum += fabs(ride.bike.speed() / 256.0 - bike_speed(t_s));
+    ride.average_speed_error_sum += fabs(ride.bike.averageSpeed() / 256.0 - bike_speed(t_s));
+    ride.samples++;
+  }
+  if ((sent_us >= BENCH_BIKE_STOP_US) && (ride.stopped_after_s < 0) && ride.bike.cadenceStale() && ride.bike.speedStale())
+  {
+    ride.stopped_after_s = (sent_us - BENCH_BIKE_STOP_US) / 1e6;
+  }
+}
+
+static void bike_hrm_page(byte page[8], unsigned long /*message_count*/, unsigned int /*period*/, void * /*context*/)
+{
+  memset(page, 0, 8);
+  page[7] = 150;
+}
+
+static void bike_heart_rate(const ANT_Channel * /*channel*/, byte /*computed_heart_rate*/, byte /*beat_count*/, unsigned int /*beat_time*/, void * context)
+{
+  ((BikeRide *) context)->hrm_pages++;
+}
+
+static void report_bike(const char * title)
+{
+  static const double drop_probability[] = {0, 0.1, 0.3};
+
+  printf("%s\n", title);
+  printf("  %-8s %12s %12s %14s %14s %14s %14s %16s %12s\n", "drop", "HRM pages/s", "bike pages/s", "cadence error", "average error",
+         "speed error", "average error", "distance (m)", "stopped (s)");
+  for (size_t d = 0; d < sizeof(drop_probability) / sizeof(drop_probability[0]); d++)
+  {
+    host_set_micros(0);
+    SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+    module.seed(11 + d);
+    ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+    ANT_Channel hrm_channel;
+    ANT_Channel bike_channel;
+    init_channel(hrm_channel, 0, DEVCE_TYPE_HRM, BENCH_SENSOR_PERIOD);
+    init_channel(bike_channel, 1, DEVCE_TYPE_CADENCE, DEVCE_CADENCE_RATE);
+
+    static BikeRide ride;
+    ride.crank_us.clear();
+    ride.wheel_us.clear();
+    ride.sent_us.clear();
+    ride.bike.reset();
+    ride.started = false;
+    ride.samples = ride.hrm_pages = 0;
+    ride.cadence_error_sum = ride.average_cadence_error_sum = ride.speed_error_sum = ride.average_speed_error_sum = 0;
+    ride.stopped_after_s = -1;
+    //Its own random numbers so the reports after this one are as they were
+    unsigned long random_state = bench_random_state;
+    ride.phase_us = random_state % 250000;
+    for (double t_s = 0; t_s < BENCH_BIKE_STOP_US / 1e6; t_s += 60.0 / bike_cadence(t_s))
+    {
+      ride.crank_us.push_back((unsigned long long) (t_s * 1e6));
+    }
+    for (double t_s = 0; t_s < BENCH_BIKE_STOP_US / 1e6; t_s += (ANT_BIKE_WHEEL_CIRCUMFERENCE_MM / 1000.0) / bike_speed(t_s))
+    {
+      ride.wheel_us.push_back((unsigned long long) (t_s * 1e6));
+    }
+    random_state = (random_state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+    module.add_sensor(DEVCE_TYPE_HRM, 1000, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, random_state % 250000, bike_hrm_page, NULL);
+    module.add_sensor(DEVCE_TYPE_CADENCE, 2000, 1, DEVCE_SENSOR_FREQ, DEVCE_CADENCE_RATE, ride.phase_us, bike_page, &ride);
+    module.broadcast_drop_probability = drop_probability[d];
+
+    static const ANT_HRMSink hrm_sink = {bike_heart_rate, NULL, &ride};
+    static const ANT_SpeedCadenceSink bike_sink = {bike_decoded, &ride};
+    antplus.begin(module);
+    antplus.add_profile(&ant_profile_hrm, &hrm_sink);
+    antplus.add_profile(&ant_profile_speed_cadence, &bike_sink);
+    antplus.add_channel(&hrm_channel);
+    antplus.add_channel(&bike_channel);
+
+    BenchRun run;
+    run.antplus = &antplus;
+    run.module = &module;
+    run.loop_us = 10000;
+    run.rx_fail_events = 0;
+    run.read_errors = 0;
+    while (micros() < BENCH_BIKE_RUN_US)
+    {
+      loop_once(run);
+    }
+
+    char drop[16];
+    char distance[32];
+    char stopped[16];
+    snprintf(drop, sizeof(drop), "%.0f%%", drop_probability[d] * 100);
+    snprintf(distance, sizeof(distance), "%.1f/%.1f", ride.bike.distance() / 1000.0,
+             (ride.last_wheel - ride.first_wheel) * ANT_BIKE_WHEEL_CIRCUMFERENCE_MM / 1000.0);
+    snprintf(stopped, sizeof(stopped), (ride.stopped_after_s < 0) ? "never" : "%.2f", ride.stopped_after_s);
+    printf("  %-8s %12.2f %12.2f %14.2f %14.2f %14.3f %14.3f %16s %12s\n", drop,
+           ride.hrm_pages / (BENCH_BIKE_RUN_US / 1e6), ride.bike.messages() / (BENCH_BIKE_RUN_US / 1e6),
+           ride.cadence_error_sum / ride.samples, ride.average_cadence_error_sum / ride.samples,
+           ride.speed_error_sum / ride.samples, ride.average_speed_error_sum / ride.samples, distance, stopped);
+  }
+  printf("  (mean errors against the ride when the page was sent -- cadence in rpm, speed in m/s; distance is counted/true;\n"
+         "   stopped is after the bike stops until both are stale)\n\n");
+}
+
+#define BENCH_GPS_LATITUDE  (-33.8568)
+#define BENCH_GPS_LONGITUDE (151.2153)
+
+static long gps_semicircles(double degrees)
+{
+  return (long) lround(degrees * (2147483648.0 / 180.0));
+}
+
+//! A geocache sending its latitude and longitude on alternate programmable pages
+static void gps_page(byte page[8], unsigned long message_count, unsigned int /*period*/, void * /*context*/)
+{
+  byte data_id = (message_count & 1) ? GPS_DATA_ID_LONGITUDE : GPS_DATA_ID_LATITUDE;
+  unsigned long semicircles = (unsigned long) gps_semicircles((data_id == GPS_DATA_ID_LATITUDE) ? BENCH_GPS_LATITUDE : BENCH_GPS_LONGITUDE);
+  memset(page, 0xFF, 8);
+  page[0] = DATA_PAGE_GPS_PROGRAMMABLE_FIRST + data_id;
+  page[1] = data_id;
+  for (byte i = 0; i < 4; i++)
+  {
+    page[2 + i] = (semicircles >> (8 * i)) & 0xFF;
+  }
+}
+
+typedef struct
+{
+  long          latitude;
+  long          longitude;
+  unsigned long locations;
+} GpsFix;
+
+static void gps_location(const ANT_Channel * /*channel*/, byte data_id, long semicircles, void * context)
+{
+  GpsFix & fix = *(GpsFix *) context;
+  if (data_id == GPS_DATA_ID_LATITUDE)
+  {
+    fix.latitude = semicircles;
+  }
+  else
+  {
+    fix.longitude = semicircles;
+  }
+  fix.locations++;
+}
+
+//! HRM channels 0..count-2 on PUBLIC_NETWORK and a GPS channel on GPS_NETWORK, set up together (10 ms loop)
+static void report_networks(const char * title, int count)
+{
+  printf("%s\n", title);
+  host_set_micros(0);
+  SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+  module.seed(21);
+  ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+
+  static const unsigned char gps_key[8] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+  ANT_Channel channels[SIM_ANT_NUMBER_CHANNELS];
+  for (int i = 0; i < count - 1; i++)
+  {
+    init_channel(channels[i], i, DEVCE_TYPE_HRM, BENCH_SENSOR_PERIOD);
+    channels[i].device_number = 1000 + i;
+    module.add_sensor(DEVCE_TYPE_HRM, 1000 + i, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, (i * 37000UL) % 250000);
+  }
+  ANT_Channel & gps_channel = channels[count - 1];
+  init_channel(gps_channel, count - 1, DEVCE_TYPE_GPS, DEVCE_GPS_RATE);
+  gps_channel.network_number = GPS_NETWORK;
+  gps_channel.freq = DEVCE_GPS_FREQ;
+  memcpy(gps_channel.ant_net_key, gps_key, sizeof(gps_key));
+  module.add_sensor(19, 3000, 1, DEVCE_GPS_FREQ, DEVCE_GPS_RATE, 123000, gps_page, NULL);
+
+  static GpsFix fix;
+  memset(&fix, 0, sizeof(fix));
+  static const ANT_GPSSink gps_sink = {gps_location, NULL, &fix};
+  antplus.begin(module);
+  antplus.add_profile(&ant_profile_gps, &gps_sink);
+  for (int i = 0; i < count; i++)
+  {
+    antplus.add_channel(&channels[i]);
+  }
+
+  BenchRun run;
+  run.antplus = &antplus;
+  run.module = &module;
+  run.loop_us = 10000;
+  run.rx_fail_events = 0;
+  run.read_errors = 0;
+  double established_ms = 0;
+  double first_rx_ms = 0;
+  while ((micros() < BENCH_GIVE_UP_US) && ((established_ms == 0) || (first_rx_ms == 0) || (fix.locations < 2)))
+  {
+    if ((loop_once(run) == ANT_CHANNEL_ESTABLISH_COMPLETE) && (established_ms == 0))
+    {
+      established_ms = micros() / 1000.0;
+    }
+    int received = 0;
+    for (int i = 0; i < count; i++)
+    {
+      received += (channels[i].broadcast_count > 0) ? 1 : 0;
+    }
+    if ((first_rx_ms == 0) && (received == count))
+    {
+      first_rx_ms = micros() / 1000.0;
+    }
+  }
+  printf("  %d channels (%d on PUBLIC_NETWORK, 1 on GPS_NETWORK): %lu network keys set, %lu frames, setup %.1f ms, all received %.1f ms\n",
+         count, count - 1, module.network_keys_set, module.host_frames, established_ms, first_rx_ms);
+  printf("  GPS location %.6f, %.6f (sent %.6f, %.6f)\n\n", fix.latitude * (180.0 / 2147483648.0), fix.longitude * (180.0 / 2147483648.0),
+         BENCH_GPS_LATITUDE, BENCH_GPS_LONGITUDE);
+}
+
+#if defined(ANTPLUS_PAIRING)
+#define BENCH_OWN_HRM     (1000)
+#define BENCH_GYM_STRAPS  (7)
+
+typedef struct
+{
+  double  first_rx_ms;
+  boolean own;
+  boolean gave_up;
+} Reconnect;
+
+//! One HRM channel from begin() to its first broadcast and the channel id read back. Other straps (if any) are in range.
+//Returns with the cache (if any) updated through its store.
+static Reconnect reconnect(ANTPairingCache * cache, int other_straps, boolean own_in_range, unsigned long seed)
+{
+  Reconnect result;
+  memset(&result, 0, sizeof(result));
+
+  host_set_micros(0);
+  SimulatedANTModule module(BENCH_RTS_PIN, BENCH_RESET_PIN);
+  module.seed(seed);
+  int own = module.add_sensor(DEVCE_TYPE_HRM, BENCH_OWN_HRM, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, bench_random(250000));
+  module.set_sensor_in_range(own, own_in_range);
+  for (int i = 0; i < other_straps; i++)
+  {
+    module.add_sensor(DEVCE_TYPE_HRM, 2000 + i, 1, DEVCE_SENSOR_FREQ, BENCH_SENSOR_PERIOD, bench_random(250000));
+  }
+  ANTPlus antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+  antplus.setPairingCache(cache);
+  ANT_Channel channel;
+  init_channel(channel, 0, DEVCE_TYPE_HRM, BENCH_SENSOR_PERIOD);
+  antplus.begin(module);
+  antplus.add_channel(&channel);
+
+  BenchRun run;
+  run.antplus = &antplus;
+  run.module = &module;
+  run.loop_us = 10000;
+  run.rx_fail_events = 0;
+  run.read_errors = 0;
+  while ((channel.broadcast_count == 0) || (channel.paired_device_number == 0))
+  {
+    if (micros() >= BENCH_GIVE_UP_US)
+    {
+      result.gave_up = true;
+      return result;
+    }
+    loop_once(run);
+    if ((result.first_rx_ms == 0) && (channel.broadcast_count > 0))
+    {
+      result.first_rx_ms = micros() / 1000.0;
+    }
+  }
+  result.own = (channel.paired_device_number == BENCH_OWN_HRM);
+  return result;
+}
+
+//! Each trial is a power cycle: the cache is loaded from the file the last session saved
+static void report_reconnect(int trials)
+{
+  char path[] = "/tmp/bench_pairing_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+  {
+    printf("Reconnecting in a gym -- can't make a temporary file\n\n");
+    return;
+  }
+  close(fd);
+
+  printf("Reconnecting in a gym: your HRM and %d others in range (%d trials, 10 ms loop, pairing cache in a HostPairingFile)\n", BENCH_GYM_STRAPS, trials);
+  printf("  %-34s %14s %14s %10s %10s\n", "search", "first rx mean", "first rx max", "yours", "saves");
+  for (int mode = 0; mode < 3; mode++)
+  {
+    static const char * const names[] = {"wildcard (no cache)", "remembered HRM", "remembered HRM not there"};
+    HostPairingFile store(path);
+    double sum = 0, worst = 0;
+    int own = 0, gave_up = 0;
+    for (int t = 0; t < trials; t++)
+    {
+      ANTPairingCache cache;
+      remove(path);
+      if (mode > 0)
+      {
+        //Last session: paired at home, only your HRM about
+        cache.begin(store);
+        reconnect(&cache, 0, true, t + 1);
+        //Power cycle
+        cache.begin(store);
+      }
+      Reconnect result = reconnect((mode > 0) ? &cache : NULL, BENCH_GYM_STRAPS, mode != 2, t + 1);
+      sum += result.first_rx_ms;
+      worst = std::max(worst, result.first_rx_ms);
+      own += result.own ? 1 : 0;
+      gave_up += result.gave_up ? 1 : 0;
+    }
+    printf("  %-34s %14.1f %14.1f %9d%% %10lu", names[mode], sum / trials, worst, (100 * own) / trials, store.saves);
+    if (gave_up > 0)
+    {
+      printf("  (%d gave up after %lu s)", gave_up, BENCH_GIVE_UP_US / 1000000);
+    }
+    printf("\n");
+  }
+  remove(path);
+  printf("\n");
+}
+#endif /*defined(ANTPLUS_PAIRING)*/
+
+int main(int argc, char ** argv)
+{
+  int trials = 20;
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "--trials") == 0) && (i + 1 < argc))
+    {
+      trials = atoi(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc))
+    {
+      bench_random_state = strtoul(argv[++i], NULL, 10);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [--trials N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("Times are from begin() on the simulated clock. 9600 baud, sensors at %d/32768 s.\n\n", BENCH_SENSOR_PERIOD);
+  report_bring_up("HRM channel acquisition (channel period DEVCE_HRM_LOWEST_RATE)", 1, DEVCE_HRM_LOWEST_RATE, trials);
+  report_bring_up("8 channel bring-up", SIM_ANT_NUMBER_CHANNELS, BENCH_SENSOR_PERIOD, trials);
+  report_bring_up("8 channel bring-up, 5% of host frames lost", SIM_ANT_NUMBER_CHANNELS, BENCH_SENSOR_PERIOD, trials, 0.05);
+  report_latency("Broadcast to application latency, 4 channels, 60 s", 0, 0);
+  report_latency("Broadcast to application latency, 4 channels, 60 s, 5% dropped, bit error rate 1e-5", 0.05, 1e-5);
+  report_dropout("HRM out of range (search timeout DEVCE_TIMEOUT, state at the end of the time out of range)");
+  report_hrv("Heart rate variability, 300 s at ~120 bpm with broadcasts lost (ANTHeartRate)");
+  report_bike("HRM and bike speed and cadence (DEVCE_CADENCE_RATE), 240 s ride then stopped, broadcasts lost (ANTSpeedCadence)");
+  report_networks("Two networks, each key sent once (GPS locations decoded by ant_profile_gps)", 4);
+#if defined(ANTPLUS_PAIRING)
+  report_reconnect(trials);
+#endif /*defined(ANTPLUS_PAIRING)*/
+  report_setup_script("HRM channel cold start, built in setup against ANT_SCRIPT_RECEIVE_CHANNEL", trials);
+  return 0;
+}
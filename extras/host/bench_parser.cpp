@@ -0,0 +1,524 @@
+//Copyright 2013 Brody Kenrick.
+//Host benchmark for the receive parser and the send paths. See README.md in this directory.
+//
+//Pushes synthetic frames (broadcasts and response events, optionally with noise and bad checksums)
+//through each read API and reports frames/sec, ns/frame and the worst single call.
+//The decode cases add decoding the HRM pages: by a switch in the sketch and by the profile table (ANTPlus_Profile.h).
+//
+//  bench_parser [--frames N] [--noise] [--save FILE] [--compare FILE] [--tolerance PERCENT]
+//
+//--save writes ns/frame per case. --compare exits non-zero if any case is slower than
+//the saved value by more than the tolerance (default 15%) -- baselines are per machine.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "HostStream.h"
+
+#include "ANTPlus.h"
+
+#define BENCH_RTS_PIN      (2)
+#define BENCH_SUSPEND_PIN  (3)
+#define BENCH_SLEEP_PIN    (4)
+#define BENCH_RESET_PIN    (5)
+
+#define BENCH_BLOCK_FRAMES (4096) //!< Frames generated once and injected repeatedly
+#define BENCH_NOISE_EVERY  (16)   //!< With --noise: a noise byte and a corrupt frame every this many frames
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct
+{
+  std::string   name;
+  unsigned long frames;
+  double        seconds;
+  double        worst_call_ns;
+} BenchResult;
+
+static HostStream    stream;
+static ANTPlus       antplus(BENCH_RTS_PIN, BENCH_SUSPEND_PIN, BENCH_SLEEP_PIN, BENCH_RESET_PIN);
+static ANT_Channel   bench_channel;
+static unsigned long sink_packets;
+
+static double elapsed_ns(bench_clock::time_point start, bench_clock::time_point end)
+{
+  return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void append_frame(std::vector<byte> & out, byte msg_id, const byte * data, byte size)
+{
+  byte checksum = MESG_TX_SYNC ^ size ^ msg_id;
+  out.push_back(MESG_TX_SYNC);
+  out.push_back(size);
+  out.push_back(msg_id);
+  for (byte i = 0; i < size; i++)
+  {
+    out.push_back(data[i]);
+    checksum ^= data[i];
+  }
+  out.push_back(checksum);
+}
+
+//! Broadcasts on channel 0 with a response event every 8th frame.
+//Returns the number of good frames in the block.
+static unsigned long build_block(std::vector<byte> & out, boolean noise)
+{
+  unsigned long good = 0;
+  out.clear();
+  for (unsigned long i = 0; i < BENCH_BLOCK_FRAMES; i++)
+  {
+    if ((i % 8) == 7)
+    {
+      const byte response[MESG_RESPONSE_EVENT_SIZE] = {0, MESG_EVENT_ID, EVENT_RX_FAIL};
+      append_frame(out, MESG_RESPONSE_EVENT_ID, response, sizeof(response));
+    }
+    else
+    {
+      const byte broadcast[MESG_DATA_SIZE] = {0, 0x84, (byte) i, (byte) (i >> 8), 0x12, 0x34, (byte) i, 0x40, 0x55};
+      append_frame(out, MESG_BROADCAST_DATA_ID, broadcast, sizeof(broadcast));
+    }
+    good++;
+
+    if (noise && ((i % BENCH_NOISE_EVERY) == (BENCH_NOISE_EVERY - 1)))
+    {
+      out.push_back(0x00);
+      const byte broadcast[MESG_DATA_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+      append_frame(out, MESG_BROADCAST_DATA_ID, broadcast, sizeof(broadcast));
+      out[out.size() - 1] ^= 0xFF; //Bad checksum
+    }
+  }
+  return good;
+}
+
+static void bench_reset()
+{
+  antplus.hardwareReset();
+  stream.tx.clear();
+
+  //Module start up -- leaves the library clear to send and waiting on nothing
+  const byte start_up[1] = {0x00};
+  std::vector<byte> frame;
+  append_frame(frame, MESG_START_UP, start_up, sizeof(start_up));
+  stream.inject(&frame[0], frame.size());
+  antplus.rTSHighAssertion();
+  const ANT_Packet * packet;
+  while (antplus.readPacket(&packet, 0) != MESSAGE_READ_NONE)
+  {
+  }
+}
+
+typedef unsigned long (*ReadOnce)();
+
+static unsigned long read_copy()
+{
+  byte buffer[ANT_MAX_PACKET_LEN];
+  MESSAGE_READ ret = antplus.readPacket((ANT_Packet *) buffer, sizeof(buffer), 0);
+  return ((ret == MESSAGE_READ_EXPECTED) || (ret == MESSAGE_READ_OTHER)) ? 1 : ((ret == MESSAGE_READ_NONE) ? 0 : 2);
+}
+
+static unsigned long read_zero_copy()
+{
+  const ANT_Packet * packet;
+  MESSAGE_READ ret = antplus.readPacket(&packet, 0);
+  return ((ret == MESSAGE_READ_EXPECTED) || (ret == MESSAGE_READ_OTHER)) ? 1 : ((ret == MESSAGE_READ_NONE) ? 0 : 2);
+}
+
+static void count_sink(const ANT_Packet * /*packet*/, MESSAGE_READ /*outcome*/, void * /*context*/)
+{
+  sink_packets++;
+}
+
+static unsigned long read_batch()
+{
+  unsigned int delivered = antplus.readPackets(count_sink, NULL);
+  //readPackets() stops when the ring is empty -- 0 only when there was nothing to do
+  return (delivered > 0) ? delivered : ((stream.available() > 0) ? 2 : 0);
+}
+
+static unsigned long heart_rate_sum;
+
+//! What the sketches did before profiles: a switch on the message, the channel's device type and the page
+static unsigned long read_switch()
+{
+  const ANT_Packet * packet;
+  MESSAGE_READ ret = antplus.readPacket(&packet, 0);
+  if ((ret != MESSAGE_READ_EXPECTED) && (ret != MESSAGE_READ_OTHER))
+  {
+    return (ret == MESSAGE_READ_NONE) ? 0 : 2;
+  }
+  switch (packet->msg_id)
+  {
+    case MESG_BROADCAST_DATA_ID:
+    {
+      const ANT_Broadcast * broadcast = (const ANT_Broadcast *) packet->data;
+      const ANT_Channel * channel = antplus.get_channel(broadcast->channel_number);
+      if ((channel != NULL) && (channel->device_type == DEVCE_TYPE_HRM))
+      {
+        switch (broadcast->data[0])
+        {
+          case DATA_PAGE_HEART_RATE_0:
+          case DATA_PAGE_HEART_RATE_0ALT:
+          case DATA_PAGE_HEART_RATE_1:
+          case DATA_PAGE_HEART_RATE_1ALT:
+          case DATA_PAGE_HEART_RATE_2:
+          case DATA_PAGE_HEART_RATE_2ALT:
+          case DATA_PAGE_HEART_RATE_3:
+          case DATA_PAGE_HEART_RATE_3ALT:
+          case DATA_PAGE_HEART_RATE_4:
+          case DATA_PAGE_HEART_RATE_4ALT:
+            heart_rate_sum += ((const ANT_HRMDataPage *) broadcast->data)->computed_heart_rate;
+            break;
+        }
+      }
+      break;
+    }
+  }
+  return 1;
+}
+
+static void bench_heart_rate(const ANT_Channel * /*channel*/, byte computed_heart_rate, byte /*beat_count*/, unsigned int /*beat_time*/, void * /*context*/)
+{
+  heart_rate_sum += computed_heart_rate;
+}
+
+static const ANT_HRMSink bench_hrm_sink = {bench_heart_rate, NULL, NULL};
+static const ANT_SDMSink bench_sdm_sink = {NULL, NULL, NULL};
+
+//! Profiles for other device types -- only there to be registered
+static const ANT_PageDecoder bench_no_pages[] PROGMEM = {NULL};
+static const ANT_Profile bench_profile_cadence PROGMEM = {DEVCE_TYPE_CADENCE, 0xFF, 1, bench_no_pages, 0};
+static const ANT_Profile bench_profile_power PROGMEM = {11, 0xFF, 1, bench_no_pages, 0};
+
+//! One read API over total_frames good frames. Return value of read: 0 idle, 1 a packet, 2 progress without a packet.
+static BenchResult bench_read(const char * name, ReadOnce read, const std::vector<byte> & block, unsigned long block_good, unsigned long total_frames, boolean batch)
+{
+  BenchResult result;
+  result.name = name;
+  result.frames = 0;
+  result.worst_call_ns = 0;
+
+  bench_reset();
+  sink_packets = 0;
+
+  bench_clock::time_point start = bench_clock::now();
+  while (result.frames < total_frames)
+  {
+    stream.inject(&block[0], block.size());
+    unsigned long block_frames = 0;
+    for (;;)
+    {
+      bench_clock::time_point call_start = bench_clock::now();
+      unsigned long ret = read();
+      double call_ns = elapsed_ns(call_start, bench_clock::now());
+      if (call_ns > result.worst_call_ns)
+      {
+        result.worst_call_ns = call_ns;
+      }
+      if (ret == 0)
+      {
+        break;
+      }
+      if (!batch && (ret == 1))
+      {
+        block_frames++;
+      }
+    }
+    result.frames += batch ? block_good : block_frames;
+  }
+  result.seconds = elapsed_ns(start, bench_clock::now()) / 1e9;
+
+  if (batch && (sink_packets != result.frames))
+  {
+    fprintf(stderr, "%s: sink saw %lu packets, expected %lu\n", name, sink_packets, result.frames);
+    exit(2);
+  }
+  return result;
+}
+
+//! Variadic send with no response expected. RTS is asserted straight away.
+static BenchResult bench_send_variadic(unsigned long total_frames)
+{
+  BenchResult result;
+  result.name = "send (variadic)";
+  result.frames = 0;
+  result.worst_call_ns = 0;
+
+  bench_reset();
+  bench_clock::time_point start = bench_clock::now();
+  while (result.frames < total_frames)
+  {
+    bench_clock::time_point call_start = bench_clock::now();
+    boolean sent = antplus.send(MESG_CHANNEL_MESG_PERIOD_ID, MESG_INVALID_ID, 3, 0, 0x86, 0x1F);
+    double call_ns = elapsed_ns(call_start, bench_clock::now());
+    if (!sent)
+    {
+      fprintf(stderr, "send (variadic): not sent\n");
+      exit(2);
+    }
+    if (call_ns > result.worst_call_ns)
+    {
+      result.worst_call_ns = call_ns;
+    }
+    antplus.rTSHighAssertion();
+    result.frames++;
+    if (stream.tx.size() > (1 << 20))
+    {
+      stream.tx.clear();
+    }
+  }
+  result.seconds = elapsed_ns(start, bench_clock::now()) / 1e9;
+  return result;
+}
+
+//! Typed send (ANTPlus_Messages.h) of the same message, for comparison with the variadic one. It waits on the response, so that
+//! is fed back between sends -- untimed, only the send() calls add up.
+static BenchResult bench_send_typed(unsigned long total_frames)
+{
+  BenchResult result;
+  result.name = "send (typed)";
+  result.frames = 0;
+  result.worst_call_ns = 0;
+
+  const byte response[MESG_RESPONSE_EVENT_SIZE] = {0, MESG_CHANNEL_MESG_PERIOD_ID, RESPONSE_NO_ERROR};
+  std::vector<byte> response_frame;
+  append_frame(response_frame, MESG_RESPONSE_EVENT_ID, response, sizeof(response));
+
+  bench_reset();
+  double send_ns = 0;
+  while (result.frames < total_frames)
+  {
+    bench_clock::time_point call_start = bench_clock::now();
+    boolean sent = antplus.send(ANT_ChannelPeriod(0, 8070));
+    double call_ns = elapsed_ns(call_start, bench_clock::now());
+    if (!sent)
+    {
+      fprintf(stderr, "send (typed): not sent\n");
+      exit(2);
+    }
+    send_ns += call_ns;
+    if (call_ns > result.worst_call_ns)
+    {
+      result.worst_call_ns = call_ns;
+    }
+    antplus.rTSHighAssertion();
+    result.frames++;
+    stream.inject(&response_frame[0], response_frame.size());
+    const ANT_Packet * packet;
+    while (antplus.readPacket(&packet, 0) != MESSAGE_READ_NONE)
+    {
+    }
+    if (stream.tx.size() > (1 << 20))
+    {
+      stream.tx.clear();
+    }
+  }
+  result.seconds = send_ns / 1e9;
+  return result;
+}
+
+static void count_command(const ANT_Command * /*command*/, byte /*response_code*/, const ANT_Packet * /*response*/, void * context)
+{
+  (*(unsigned long *) context)++;
+}
+
+//! Typed command through the queue: queue, send on the next read, response parsed and matched, callback
+static BenchResult bench_command_round_trip(unsigned long total_frames)
+{
+  BenchResult result;
+  result.name = "queue_command round trip";
+  result.frames = 0;
+  result.worst_call_ns = 0;
+
+  unsigned long completed = 0;
+  const byte response[MESG_RESPONSE_EVENT_SIZE] = {0, MESG_CHANNEL_MESG_PERIOD_ID, RESPONSE_NO_ERROR};
+  std::vector<byte> response_frame;
+  append_frame(response_frame, MESG_RESPONSE_EVENT_ID, response, sizeof(response));
+
+  bench_reset();
+  bench_clock::time_point start = bench_clock::now();
+  while (result.frames < total_frames)
+  {
+    bench_clock::time_point call_start = bench_clock::now();
+
+    antplus.queue_command(ANT_ChannelPeriod(0, 8070), count_command, &completed);
+    read_zero_copy(); //Sends it
+    antplus.rTSHighAssertion();
+    stream.inject(&response_frame[0], response_frame.size());
+    read_zero_copy(); //Completes it
+
+    double call_ns = elapsed_ns(call_start, bench_clock::now());
+    if (call_ns > result.worst_call_ns)
+    {
+      result.worst_call_ns = call_ns;
+    }
+    result.frames++;
+    if (stream.tx.size() > (1 << 20))
+    {
+      stream.tx.clear();
+    }
+  }
+  result.seconds = elapsed_ns(start, bench_clock::now()) / 1e9;
+
+  if (completed != result.frames)
+  {
+    fprintf(stderr, "queue_command: %lu of %lu completed\n", completed, result.frames);
+    exit(2);
+  }
+  return result;
+}
+
+static double ns_per_frame(const BenchResult & result)
+{
+  return (result.seconds * 1e9) / result.frames;
+}
+
+static std::map<std::string, double> load_baseline(const char * path)
+{
+  std::map<std::string, double> baseline;
+  FILE * file = fopen(path, "r");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Can't open baseline %s\n", path);
+    exit(2);
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    char * tab = strchr(line, '\t');
+    if (tab != NULL)
+    {
+      *tab = '\0';
+      baseline[line] = atof(tab + 1);
+    }
+  }
+  fclose(file);
+  return baseline;
+}
+
+int main(int argc, char ** argv)
+{
+  unsigned long total_frames = 2000000;
+  boolean       noise = false;
+  const char *  save_path = NULL;
+  const char *  compare_path = NULL;
+  double        tolerance = 15.0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+    {
+      total_frames = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "--noise") == 0)
+    {
+      noise = true;
+    }
+    else if ((strcmp(argv[i], "--save") == 0) && (i + 1 < argc))
+    {
+      save_path = argv[++i];
+    }
+    else if ((strcmp(argv[i], "--compare") == 0) && (i + 1 < argc))
+    {
+      compare_path = argv[++i];
+    }
+    else if ((strcmp(argv[i], "--tolerance") == 0) && (i + 1 < argc))
+    {
+      tolerance = atof(argv[++i]);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [--frames N] [--noise] [--save FILE] [--compare FILE] [--tolerance PERCENT]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  antplus.begin(stream);
+  memset(&bench_channel, 0, sizeof(bench_channel));
+  bench_channel.channel_number = 0;
+  bench_channel.device_type = DEVCE_TYPE_HRM;
+  antplus.add_channel(&bench_channel);
+
+  std::vector<byte> block;
+  unsigned long block_good = build_block(block, noise);
+
+  std::vector<BenchResult> results;
+  results.push_back(bench_read("readPacket (copy)",      read_copy,      block, block_good, total_frames, false));
+  results.push_back(bench_read("readPacket (zero-copy)", read_zero_copy, block, block_good, total_frames, false));
+  results.push_back(bench_read("readPackets (batch)",    read_batch,     block, block_good, total_frames, true));
+
+  //Page decoding: the sketch's switch against the profile table with one and then four profiles (and channels) added
+  results.push_back(bench_read("decode (sketch switch)", read_switch, block, block_good, total_frames, false));
+  antplus.add_profile(&ant_profile_hrm, &bench_hrm_sink);
+  results.push_back(bench_read("decode (1 profile)", read_zero_copy, block, block_good, total_frames, false));
+  antplus.add_profile(&ant_profile_sdm, &bench_sdm_sink);
+  antplus.add_profile(&bench_profile_cadence, NULL);
+  antplus.add_profile(&bench_profile_power, NULL);
+  static ANT_Channel other_channels[3];
+  const int other_types[3] = {DEVCE_TYPE_SDM, DEVCE_TYPE_CADENCE, 11};
+  for (int i = 0; i < 3; i++)
+  {
+    memset(&other_channels[i], 0, sizeof(other_channels[i]));
+    other_channels[i].channel_number = i + 1;
+    other_channels[i].device_type = other_types[i];
+    antplus.add_channel(&other_channels[i]);
+  }
+  results.push_back(bench_read("decode (4 profiles)", read_zero_copy, block, block_good, total_frames, false));
+  if (heart_rate_sum == 0)
+  {
+    fprintf(stderr, "decode: no heart rates\n");
+    exit(2);
+  }
+
+  results.push_back(bench_send_variadic(total_frames));
+  results.push_back(bench_send_typed(total_frames));
+  results.push_back(bench_command_round_trip(total_frames / 4));
+
+  printf("%-28s %12s %14s %10s %16s\n", "case", "frames", "frames/sec", "ns/frame", "worst call (ns)");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    printf("%-28s %12lu %14.0f %10.1f %16.0f\n",
+           results[i].name.c_str(), results[i].frames, results[i].frames / results[i].seconds,
+           ns_per_frame(results[i]), results[i].worst_call_ns);
+  }
+  printf("(ring overruns %u, sync discards %lu%s)\n", antplus.rxRingOverruns(), antplus.syncDiscardCount(), noise ? ", with noise" : "");
+
+  if (save_path != NULL)
+  {
+    FILE * file = fopen(save_path, "w");
+    if (file == NULL)
+    {
+      fprintf(stderr, "Can't write baseline %s\n", save_path);
+      return 2;
+    }
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      fprintf(file, "%s\t%.2f\n", results[i].name.c_str(), ns_per_frame(results[i]));
+    }
+    fclose(file);
+  }
+
+  int regressions = 0;
+  if (compare_path != NULL)
+  {
+    std::map<std::string, double> baseline = load_baseline(compare_path);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      std::map<std::string, double>::const_iterator it = baseline.find(results[i].name);
+      if (it == baseline.end())
+      {
+        continue;
+      }
+      double change = 100.0 * (ns_per_frame(results[i]) - it->second) / it->second;
+      boolean regressed = change > tolerance;
+      printf("%-28s %+7.1f%% vs baseline%s\n", results[i].name.c_str(), change, regressed ? "  REGRESSION" : "");
+      regressions += regressed ? 1 : 0;
+    }
+  }
+  return (regressions > 0) ? 1 : 0;
+}
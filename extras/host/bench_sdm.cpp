@@ -0,0 +1,226 @@
+//Copyright 2013 Brody Kenrick.
+//SDM accumulation benchmark -- ANTSpeedDistance against update_sdm_rollover(). See README.md in this directory.
+//
+//A run (speed wandering between 2.5 and 4 m/s, ~170 strides/min) is turned into SDM page 1s at 4 Hz with the fields
+//rolling over as a sensor's do. Both accumulate them:
+//  update_sdm_rollover() -- whole seconds, whole metres and strides (three calls a page)
+//  ANTSpeedDistance     -- time, distance and strides with their fractions (one call a page)
+//and the totals are compared with the run's own. Then each is timed over the pages: ns and CPU cycles per page
+//(cycles from the time stamp counter where there is one).
+//
+//  bench_sdm [--hours N] [--repeat N]
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+
+#include "Arduino.h"
+
+#include "ANTPlus.h"
+#include "ANTPlus_SpeedDistance.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+//! Page 1 fields as the decoder gives them (see ANT_SDMSink::speed_distance)
+typedef struct
+{
+  unsigned int time;      //!< 1/200 s
+  unsigned int distance;  //!< 1/16 m
+  unsigned int speed;     //!< 1/256 m/s
+  byte         strides;
+  byte         time_int;  //!< Whole units for update_sdm_rollover()
+  byte         distance_int;
+} SdmPage;
+
+typedef struct
+{
+  double seconds;
+  double metres;
+  double strides;
+} RunTotals;
+
+static unsigned long bench_random_state = 12345;
+
+static double bench_random_unit()
+{
+  bench_random_state = (bench_random_state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+  return bench_random_state / 2147483648.0;
+}
+
+//! Pages every 0.25 s. The sensor's time/distance/strides are at its last stride (update latency is not modelled).
+static RunTotals make_run(std::vector<SdmPage> & pages, double hours)
+{
+  double t = 0, metres = 0, strides = 0, speed = 3.0;
+  RunTotals first = {0, 0, 0};
+  pages.clear();
+  while (t < hours * 3600.0)
+  {
+    speed += (bench_random_unit() - 0.5) * 0.05;
+    speed = (speed < 2.5) ? 2.5 : ((speed > 4.0) ? 4.0 : speed);
+    t += 0.25;
+    metres += speed * 0.25;
+    strides += (170.0 / 60.0) * 0.25;
+
+    SdmPage page;
+    unsigned long time_200 = (unsigned long) (t * 200.0);
+    unsigned long distance_16 = (unsigned long) (metres * 16.0);
+    page.time = time_200 % ANT_SDM_TIME_ROLLOVER;
+    page.distance = distance_16 % ANT_SDM_DISTANCE_ROLLOVER;
+    page.speed = (unsigned int) (speed * 256.0);
+    page.strides = ((unsigned long) strides) & 0xFF;
+    page.time_int = (time_200 / 200) & 0xFF;
+    page.distance_int = (distance_16 / 16) & 0xFF;
+    if (pages.empty())
+    {
+      //Totals are from the first page (it is the starting point for both)
+      first.seconds = time_200 / 200.0;
+      first.metres = distance_16 / 16.0;
+      first.strides = (double) (unsigned long) strides;
+    }
+    pages.push_back(page);
+  }
+  RunTotals totals;
+  totals.seconds = ((unsigned long) (t * 200.0)) / 200.0 - first.seconds;
+  totals.metres = ((unsigned long) (metres * 16.0)) / 16.0 - first.metres;
+  totals.strides = (double) (unsigned long) strides - first.strides;
+  return totals;
+}
+
+typedef struct
+{
+  unsigned long time;
+  unsigned long distance;
+  unsigned long strides;
+  int previous_time;
+  int previous_distance;
+  int previous_strides;
+} WholeUnits;
+
+static void whole_units_reset(WholeUnits & whole)
+{
+  memset(&whole, 0, sizeof(whole));
+  whole.previous_time = -1;
+  whole.previous_distance = -1;
+  whole.previous_strides = -1;
+}
+
+static inline void whole_units_update(WholeUnits & whole, const SdmPage & page)
+{
+  ANTPlus::update_sdm_rollover(page.time_int, &whole.time, &whole.previous_time);
+  ANTPlus::update_sdm_rollover(page.distance_int, &whole.distance, &whole.previous_distance);
+  ANTPlus::update_sdm_rollover(page.strides, &whole.strides, &whole.previous_strides);
+}
+
+static inline void speed_distance_update(ANTSpeedDistance & sdm, const SdmPage & page)
+{
+  sdm.updateSpeedDistance(page.time, page.distance, page.speed, page.strides, 0);
+}
+
+typedef struct
+{
+  double ns_per_page;
+  double cycles_per_page;
+} Timing;
+
+static volatile unsigned long bench_totals; //!< The totals go here so the updates are not optimised away
+
+template <class STATE, void (*RESET)(STATE &), void (*UPDATE)(STATE &, const SdmPage &), unsigned long (*TOTAL)(const STATE &)>
+static Timing time_updates(const std::vector<SdmPage> & pages, int repeat)
+{
+  STATE state;
+  unsigned long long cycles = 0;
+  double ns = 0;
+  for (int r = 0; r < repeat; r++)
+  {
+    RESET(state);
+    bench_clock::time_point start = bench_clock::now();
+    unsigned long long cycles_start = BENCH_CYCLES();
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+      UPDATE(state, pages[i]);
+    }
+    cycles += BENCH_CYCLES() - cycles_start;
+    ns += std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+    bench_totals = bench_totals + TOTAL(state);
+  }
+  Timing timing;
+  timing.ns_per_page = ns / ((double) pages.size() * repeat);
+  timing.cycles_per_page = (double) cycles / ((double) pages.size() * repeat);
+  return timing;
+}
+
+static unsigned long whole_units_total(const WholeUnits & whole)
+{
+  return whole.time + whole.distance + whole.strides;
+}
+
+static void sdm_reset(ANTSpeedDistance & sdm)
+{
+  sdm.reset();
+}
+
+static unsigned long sdm_total(const ANTSpeedDistance & sdm)
+{
+  return sdm.time() + sdm.distance() + sdm.strides();
+}
+
+int main(int argc, char ** argv)
+{
+  double hours = 3;
+  int    repeat = 50;
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "--hours") == 0) && (i + 1 < argc))
+    {
+      hours = atof(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "--repeat") == 0) && (i + 1 < argc))
+    {
+      repeat = atoi(argv[++i]);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [--hours N] [--repeat N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::vector<SdmPage> pages;
+  RunTotals run = make_run(pages, hours);
+
+  WholeUnits whole;
+  whole_units_reset(whole);
+  ANTSpeedDistance sdm;
+  for (size_t i = 0; i < pages.size(); i++)
+  {
+    whole_units_update(whole, pages[i]);
+    speed_distance_update(sdm, pages[i]);
+  }
+
+  printf("%.1f h run, %lu pages\n\n", hours, (unsigned long) pages.size());
+  printf("%-22s %14s %14s %12s\n", "", "time (s)", "distance (m)", "strides");
+  printf("%-22s %14.3f %14.4f %12.0f\n", "run", run.seconds, run.metres, run.strides);
+  printf("%-22s %14lu %14lu %12lu\n", "update_sdm_rollover", whole.time, whole.distance, whole.strides);
+  printf("%-22s %14.3f %14.4f %12lu\n", "ANTSpeedDistance", sdm.time() / 200.0, sdm.distance() / 16.0, sdm.strides());
+  boolean exact = (sdm.time() == (unsigned long) lround(run.seconds * 200.0)) && (sdm.distance() == (unsigned long) lround(run.metres * 16.0)) &&
+                  (sdm.strides() == (unsigned long) run.strides);
+  printf("ANTSpeedDistance totals %s\n\n", exact ? "exact" : "WRONG");
+
+  Timing whole_timing = time_updates<WholeUnits, whole_units_reset, whole_units_update, whole_units_total>(pages, repeat);
+  Timing sdm_timing = time_updates<ANTSpeedDistance, sdm_reset, speed_distance_update, sdm_total>(pages, repeat);
+  printf("%-22s %12s %16s\n", "per page", "ns", "cycles");
+  printf("%-22s %12.2f %16.1f\n", "update_sdm_rollover x3", whole_timing.ns_per_page, whole_timing.cycles_per_page);
+  printf("%-22s %12.2f %16.1f\n", "ANTSpeedDistance", sdm_timing.ns_per_page, sdm_timing.cycles_per_page);
+  printf("(cycles are the host's time stamp counter -- 0 where there is none)\n");
+  return exact ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+//Copyright 2013 Brody Kenrick.
+//Record a capture (ANTPlus_Capture.h) from the simulated module, or replay one and check the library still does the same.
+//See README.md in this directory.
+//
+//  replay_capture --record FILE [--seconds N] [--drop P] [--ber R] [--seed N] [--loop-us N]
+//  replay_capture FILE [--speed N] [--loop-us N]
+//
+//Both run the same sketch-like loop() (4 channels, as in bench_acquisition) so a replay sends what the recording sent.
+//A replay at the recorded speed exits non-zero if the read outcomes or the TX differ from the recording.
+//--speed N (N times faster, loop() too) or --speed 0 (as fast as it is read) are for throughput and soak runs.
+//The library's own timeouts are not scaled, so commands go out at different times -- the comparison is reported only
+//(and for --speed 0 only the total of good frames is compared).
+//Built with -DANTPLUS_STATISTICS and/or -DANTPLUS_TRACE as well, the library's statistics and the last trace entries are printed at the end.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Arduino.h"
+#include "HostStream.h"
+#include "SimulatedANTModule.h"
+
+#include "ANTPlus.h"
+#include "ANTPlus_Capture.h"
+
+#if !defined(ANTPLUS_CAPTURE)
+#error "Build with -DANTPLUS_CAPTURE"
+#endif
+
+#define REPLAY_RTS_PIN      (2)
+#define REPLAY_SUSPEND_PIN  (3)
+#define REPLAY_SLEEP_PIN    (4)
+#define REPLAY_RESET_PIN    (5)
+#define REPLAY_CHANNELS     (4)
+#define REPLAY_PERIOD       (8070)
+
+static void replay_rts(void * context)
+{
+  ((ANTPlus *) context)->rTSHighAssertion();
+}
+
+//! Print to a file
+class FilePrint : public Print
+{
+  public:
+    FilePrint(FILE * file) : file(file) {};
+    size_t write(uint8_t value) {return fwrite(&value, 1, 1, file);};
+    size_t write(const uint8_t * buffer, size_t size) {return fwrite(buffer, 1, size, file);};
+    using Print::write;
+  private:
+    FILE * file;
+};
+
+static ANT_Channel channels[REPLAY_CHANNELS];
+static ANT_ReadCounts outcomes;
+
+static void setup_channels(ANTPlus & antplus)
+{
+  static const unsigned char key[8] = {0xB9, 0xA5, 0x21, 0xFB, 0xBD, 0x72, 0xC3, 0x45};
+  for (int i = 0; i < REPLAY_CHANNELS; i++)
+  {
+    memset(&channels[i], 0, sizeof(channels[i]));
+    channels[i].channel_number = i;
+    channels[i].network_number = PUBLIC_NETWORK;
+    channels[i].timeout = DEVCE_TIMEOUT;
+    channels[i].device_type = DEVCE_TYPE_HRM + i;
+    channels[i].freq = DEVCE_SENSOR_FREQ;
+    channels[i].period = REPLAY_PERIOD;
+    memcpy(channels[i].ant_net_key, key, sizeof(key));
+    channels[i].channel_establish = ANT_CHANNEL_ESTABLISH_PROGRESSING;
+    antplus.add_channel(&channels[i]);
+  }
+}
+
+//! The sketch loop(). RTS is the library's own interrupt when recording, RTS records through replay_rts() on replay.
+static void loop_once(ANTPlus & antplus, unsigned long loop_us, ANTCaptureReplay * replay = NULL)
+{
+  host_advance_micros(loop_us);
+  if (replay != NULL)
+  {
+    //RTS records due now (the interrupt would have fired while the loop was busy)
+    replay->available();
+  }
+  const ANT_Packet * packet;
+  MESSAGE_READ ret_val;
+  while ((ret_val = antplus.readPacket(&packet, 0)) != MESSAGE_READ_NONE)
+  {
+    outcomes.outcome[ret_val]++;
+  }
+  antplus.progress_setup_channels();
+}
+
+static int record(const char * path, unsigned long seconds, double drop, double ber, unsigned long seed, unsigned long loop_us)
+{
+  FILE * file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Can't write %s\n", path);
+    return 2;
+  }
+  FilePrint out(file);
+
+  host_set_micros(0);
+  SimulatedANTModule module(REPLAY_RTS_PIN, REPLAY_RESET_PIN);
+  module.broadcast_drop_probability = drop;
+  module.bit_error_rate = ber;
+  module.seed(seed);
+  for (int i = 0; i < REPLAY_CHANNELS; i++)
+  {
+    module.add_sensor(DEVCE_TYPE_HRM + i, 1000 + i, 1, DEVCE_SENSOR_FREQ, REPLAY_PERIOD, 50000 * i, SimulatedANTModule::hrm_page);
+  }
+
+  ANTPlus antplus(REPLAY_RTS_PIN, REPLAY_SUSPEND_PIN, REPLAY_SLEEP_PIN, REPLAY_RESET_PIN);
+  ANTCapture capture;
+  capture.begin(out);
+  antplus.setCapture(&capture);
+  antplus.begin(module);
+  setup_channels(antplus);
+
+  while (micros() < seconds * 1000000UL)
+  {
+    loop_once(antplus, loop_us);
+  }
+  capture.end();
+  fclose(file);
+
+  printf("Recorded %lu s to %s: %lu bytes (%lu broadcasts, %lu bytes corrupted)\n",
+         seconds, path, capture.bytesWritten(), module.broadcasts_sent, module.bytes_corrupted);
+  return 0;
+}
+
+static int replay(const char * path, unsigned int speed, unsigned long loop_us)
+{
+  FILE * file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Can't read %s\n", path);
+    return 2;
+  }
+  std::vector<uint8_t> contents;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+  {
+    contents.insert(contents.end(), chunk, chunk + got);
+  }
+  fclose(file);
+  HostStream source;
+  if (!contents.empty())
+  {
+    source.inject(&contents[0], contents.size());
+  }
+
+  host_set_micros(0);
+  ANTCaptureReplay replay;
+  if (!replay.begin(source, speed))
+  {
+    fprintf(stderr, "%s is not a version %d capture\n", path, ANT_CAPTURE_VERSION);
+    return 2;
+  }
+  ANTPlus antplus(REPLAY_RTS_PIN, REPLAY_SUSPEND_PIN, REPLAY_SLEEP_PIN, REPLAY_RESET_PIN);
+  replay.setRtsCallback(replay_rts, &antplus);
+  antplus.begin(replay);
+  setup_channels(antplus);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (!replay.finished())
+  {
+    loop_once(antplus, (speed == 0) ? loop_us : (loop_us / speed), &replay);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int differences = 0;
+  ANT_ReadCounts recorded = replay.recordedOutcomes();
+  if (speed == 0)
+  {
+    //Which good frames were expected depends on timing -- only compare the total
+    recorded.outcome[MESSAGE_READ_OTHER] += recorded.outcome[MESSAGE_READ_EXPECTED];
+    recorded.outcome[MESSAGE_READ_EXPECTED] = 0;
+    outcomes.outcome[MESSAGE_READ_OTHER] += outcomes.outcome[MESSAGE_READ_EXPECTED];
+    outcomes.outcome[MESSAGE_READ_EXPECTED] = 0;
+  }
+  printf("%-10s %10s %10s\n", "outcome", "recorded", "replayed");
+  for (int i = 0; i < MESSAGE_READ_COUNT; i++)
+  {
+    if ((recorded.outcome[i] == 0) && (outcomes.outcome[i] == 0))
+    {
+      continue;
+    }
+    boolean same = (recorded.outcome[i] == outcomes.outcome[i]);
+    printf("%-10d %10u %10u%s\n", i, recorded.outcome[i], outcomes.outcome[i], same ? "" : "  DIFFERENT");
+    differences += same ? 0 : 1;
+  }
+  if (speed != 0)
+  {
+    printf("TX: %lu frames recorded, %s\n", replay.txFrames(), replay.txMatches() ? "same on replay" : "DIFFERENT on replay");
+    differences += replay.txMatches() ? 0 : 1;
+  }
+  printf("Replayed %.1f s of capture in %.3f s\n", micros() / 1e6, seconds);
+  FilePrint console(stdout);
+#if defined(ANTPLUS_STATISTICS)
+  antplus.printStatistics(console);
+#endif /*defined(ANTPLUS_STATISTICS)*/
+  antplus.traceRing().dump(console);
+  return ((speed == 1) && (differences > 0)) ? 1 : 0;
+}
+
+int main(int argc, char ** argv)
+{
+  const char * record_path = NULL;
+  const char * replay_path = NULL;
+  unsigned long seconds = 60;
+  unsigned long loop_us = 10000;
+  unsigned int speed = 1;
+  double drop = 0;
+  double ber = 0;
+  unsigned long seed = 1;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "--record") == 0) && (i + 1 < argc))
+    {
+      record_path = argv[++i];
+    }
+    else if ((strcmp(argv[i], "--seconds") == 0) && (i + 1 < argc))
+    {
+      seconds = strtoul(argv[++i], NULL, 10);
+    }
+    else if ((strcmp(argv[i], "--drop") == 0) && (i + 1 < argc))
+    {
+      drop = atof(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "--ber") == 0) && (i + 1 < argc))
+    {
+      ber = atof(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc))
+    {
+      seed = strtoul(argv[++i], NULL, 10);
+    }
+    else if ((strcmp(argv[i], "--loop-us") == 0) && (i + 1 < argc))
+    {
+      loop_us = strtoul(argv[++i], NULL, 10);
+    }
+    else if ((strcmp(argv[i], "--speed") == 0) && (i + 1 < argc))
+    {
+      speed = atoi(argv[++i]);
+    }
+    else if ((argv[i][0] != '-') && (replay_path == NULL))
+    {
+      replay_path = argv[i];
+    }
+    else
+    {
+      replay_path = NULL;
+      record_path = NULL;
+      break;
+    }
+  }
+
+  if (record_path != NULL)
+  {
+    return record(record_path, seconds, drop, ber, seed, loop_us);
+  }
+  if (replay_path != NULL)
+  {
+    return replay(replay_path, speed, loop_us);
+  }
+  fprintf(stderr, "Usage: %s --record FILE [--seconds N] [--drop P] [--ber R] [--seed N] [--loop-us N]\n", argv[0]);
+  fprintf(stderr, "       %s FILE [--speed N] [--loop-us N]\n", argv[0]);
+  return 2;
+}